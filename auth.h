@@ -0,0 +1,219 @@
+#ifndef AUTH_H_INCLUDE
+#define AUTH_H_INCLUDE
+
+#include <stdint.h>
+#include <string.h>
+
+#include "packets.h"
+#include "speck.h"
+#include "storage.h"
+#include "types.h"
+
+/**
+ * Frame authentication
+ * Every frame gets a trailer with a MAC, a CBC-MAC under Speck64/128 with the network key, over a first block of
+ * the sender's frame counter, its radio ID and the frame length, then the packets. A frame only counts if its
+ * counter is past the last one we took from that sender, so an old frame can't be played back.
+ * The counter goes out whole with a 32 bit tag when the frame has room, or as its low byte with a 24 bit tag
+ * when it doesn't, and the receiver fills in the rest from the last counter it took from that sender. That
+ * short form is all a full frame has room for, see FRAME_TRAILER_SIZE. A sender we have nothing from yet, or
+ * whose counter has moved on more than 255 since the last frame we took, has to be heard in the long form first.
+ * The top half of the counter is an epoch kept in EEPROM and moved on at every boot, so a restart never
+ * reuses a counter.
+ * What we took from each sender is kept for as long as we're up, a sender going quiet doesn't clear it, or jamming
+ * a box for a while would be enough to replay its old frames. A box that joins onto a radio ID another box had
+ * moves its own epoch past the other one's instead, see passEpoch()
+ * @param TPeers number of radio IDs a frame can come from
+ */
+template <uint8_t TPeers>
+class FrameAuth
+{
+public:
+  static const uint8_t LONG_TRAILER = 8; // the whole counter and a 32 bit tag
+  static const uint8_t SHORT_TRAILER = 4; // the low byte of the counter and a 24 bit tag
+  static_assert(SHORT_TRAILER == FRAME_TRAILER_SIZE, "FRAME_TRAILER_SIZE has to leave room for the short form");
+  // set on the sender's radio ID in the frame header when the trailer's the long form
+  static const uint8_t LONG_FORM = 0x80;
+
+  /**
+   * @param k the network key, four words, see speck::encrypt()
+   */
+  FrameAuth(const uint32_t* k) : key(k), address(0), counter(0), rejected(0)
+  {
+    forget();
+  }
+
+  /**
+   * Starts a new epoch of our counter
+   * @param epochAddress where in EEPROM the epoch lives
+   */
+  void init(const uint16_t epochAddress)
+  {
+    address = epochAddress;
+    nextEpoch();
+  }
+
+  /**
+   * Forgets every sender's counter
+   */
+  void forget()
+  {
+    for (uint8_t i = 0; i < TPeers; ++i)
+      last[i] = 0;
+  }
+
+  /**
+   * Moves our counter on past an epoch another box used with our radio ID, so whoever took its frames takes ours
+   * @param epoch the other box's, see lastEpoch()
+   */
+  void passEpoch(const uint16_t epoch)
+  {
+    if (static_cast<uint16_t>(counter >> 16) <= epoch)
+      startEpoch(epoch + 1);
+  }
+
+  /**
+   * Gets the epoch of the last counter we took from a sender
+   * @param peer radio ID
+   * @return the epoch, 0 if we have nothing from them
+   */
+  inline uint16_t lastEpoch(const radio_id peer) const { return peer < TPeers ? last[peer] >> 16 : 0; }
+
+  /**
+   * Adds the trailer to a frame
+   * @param frame frame with room for MAX_FRAME_SIZE bytes
+   * @param length bytes in the frame, no more than MAX_FRAME_SIZE - FRAME_TRAILER_SIZE
+   * @return bytes in the frame with the trailer
+   */
+  uint8_t seal(uint8_t* frame, const uint8_t length)
+  {
+    ++counter;
+    if (static_cast<uint16_t>(counter) == 0)
+      nextEpoch();
+
+    const bool full = length + LONG_TRAILER <= MAX_FRAME_SIZE;
+    const uint32_t t = tag(frame, length, counter);
+    uint8_t* trailer = frame + length;
+    if (full)
+    {
+      frame[0] |= LONG_FORM;
+      memcpy(trailer, &counter, sizeof(counter));
+      memcpy(trailer + sizeof(counter), &t, sizeof(t));
+      return length + LONG_TRAILER;
+    }
+    frame[0] &= ~LONG_FORM;
+    trailer[0] = static_cast<uint8_t>(counter);
+    memcpy(trailer + 1, &t, SHORT_TRAILER - 1);
+    return length + SHORT_TRAILER;
+  }
+
+  /**
+   * Checks a received frame and takes the trailer off
+   * @param frame the frame, the long form flag is cleared from its header
+   * @param length bytes received
+   * @return bytes in the frame without the trailer, 0 if it doesn't check out
+   */
+  uint8_t open(uint8_t* frame, const uint8_t length)
+  {
+    const bool full = frame[0] & LONG_FORM;
+    const radio_id source = frame[0] & ~LONG_FORM;
+    const uint8_t trailerSize = full ? LONG_TRAILER : SHORT_TRAILER;
+    if (source >= TPeers || length < FRAME_HEADER_SIZE + trailerSize)
+      return reject();
+
+    const uint8_t size = length - trailerSize;
+    const uint8_t* trailer = frame + size;
+    uint32_t c;
+    uint32_t t = 0;
+    if (full)
+    {
+      memcpy(&c, trailer, sizeof(c));
+      memcpy(&t, trailer + sizeof(c), sizeof(t));
+    }
+    else
+    {
+      if (last[source] == 0)
+        return reject();
+      c = (last[source] & ~static_cast<uint32_t>(0xFF)) | trailer[0];
+      if (c <= last[source])
+        c += 0x100;
+      memcpy(&t, trailer + 1, SHORT_TRAILER - 1);
+    }
+    if (c <= last[source])
+      return reject();
+
+    frame[0] = source;
+    uint32_t expected = tag(frame, size, c);
+    if (!full)
+      expected &= 0xFFFFFF;
+    if (expected != t)
+      return reject();
+
+    last[source] = c;
+    return size;
+  }
+
+  inline uint16_t getRejected() const { return rejected; }
+
+private:
+  /**
+   * Moves the counter on to the start of the next epoch, and saves that so the next boot starts past it
+   */
+  void nextEpoch()
+  {
+    uint16_t epoch;
+    storage::read(address, reinterpret_cast<uint8_t*>(&epoch), sizeof(epoch));
+    // a blank EEPROM reads as all ones, and a counter of 0 means we've never heard from someone
+    startEpoch(epoch == UINT16_MAX ? 1 : epoch + 1);
+  }
+
+  /**
+   * Saves an epoch and starts the counter at it
+   * @param epoch the epoch
+   */
+  void startEpoch(uint16_t epoch)
+  {
+    storage::write(address, reinterpret_cast<uint8_t*>(&epoch), sizeof(epoch));
+    counter = static_cast<uint32_t>(epoch) << 16;
+  }
+
+  /**
+   * Works out the CBC-MAC of a frame
+   * The length goes in the first block, so frames of different lengths can't be made to share a MAC
+   * @param frame the frame, without the long form flag
+   * @param length bytes in the frame, without the trailer
+   * @param c the sender's counter for it
+   * @return the tag
+   */
+  uint32_t tag(const uint8_t* frame, const uint8_t length, const uint32_t c) const
+  {
+    uint32_t x = c;
+    uint32_t y = static_cast<uint32_t>(frame[0] & ~LONG_FORM) | static_cast<uint32_t>(length) << 8;
+    speck::encrypt(key, x, y);
+    for (uint8_t i = FRAME_HEADER_SIZE; i < length; i += speck::BLOCK_SIZE)
+    {
+      uint32_t block[2] = {0, 0};
+      const uint8_t n = length - i < speck::BLOCK_SIZE ? length - i : speck::BLOCK_SIZE;
+      memcpy(block, frame + i, n);
+      x ^= block[0];
+      y ^= block[1];
+      speck::encrypt(key, x, y);
+    }
+    return x;
+  }
+
+  inline uint8_t reject()
+  {
+    if (rejected < UINT16_MAX)
+      ++rejected;
+    return 0;
+  }
+
+  const uint32_t* key;
+  uint16_t address;
+  uint32_t counter; // the last one we used
+  uint32_t last[TPeers]; // the last counter we took from each sender, 0 for none
+  uint16_t rejected;
+};
+
+#endif
@@ -0,0 +1,126 @@
+#ifndef BITSET_H_INCLUDE
+#define BITSET_H_INCLUDE
+
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __AVR__
+typedef uint8_t bitset_word_t; // the AVR only has 8 bit registers, anything wider is several instructions anyway
+#else
+typedef uint32_t bitset_word_t;
+#endif
+
+/**
+ * Fixed size set of small numbers, one bit each
+ * Set operations work a word at a time, so checking every node is a handful of instructions rather than a loop
+ * over the node table
+ * @param TBits how many bits
+ */
+template <uint8_t TBits>
+class Bitset
+{
+public:
+  static const uint8_t WORD_BITS = sizeof(bitset_word_t) * 8;
+  static const uint8_t WORDS = (TBits + WORD_BITS - 1) / WORD_BITS;
+
+  Bitset()
+  {
+    clear();
+  }
+
+  inline void clear()
+  {
+    memset(words, 0, sizeof(words));
+  }
+
+  inline void set(const uint8_t i)
+  {
+    words[i / WORD_BITS] |= mask(i);
+  }
+
+  inline void reset(const uint8_t i)
+  {
+    words[i / WORD_BITS] &= ~mask(i);
+  }
+
+  inline void assign(const uint8_t i, const bool value)
+  {
+    if (value)
+      set(i);
+    else
+      reset(i);
+  }
+
+  inline bool test(const uint8_t i) const
+  {
+    return (words[i / WORD_BITS] & mask(i)) != 0;
+  }
+
+  /**
+   * @return how many bits are set
+   */
+  uint8_t count() const
+  {
+    uint8_t c = 0;
+    for (uint8_t w = 0; w < WORDS; ++w)
+      c += __builtin_popcountl(words[w]);
+    return c;
+  }
+
+  bool any() const
+  {
+    for (uint8_t w = 0; w < WORDS; ++w)
+    {
+      if (words[w])
+        return true;
+    }
+    return false;
+  }
+
+  /**
+   * @return true if every bit set here is set in other too
+   */
+  bool subsetOf(const Bitset& other) const
+  {
+    for (uint8_t w = 0; w < WORDS; ++w)
+    {
+      if (words[w] & ~other.words[w])
+        return false;
+    }
+    return true;
+  }
+
+  Bitset& operator|=(const Bitset& other)
+  {
+    for (uint8_t w = 0; w < WORDS; ++w)
+      words[w] |= other.words[w];
+    return *this;
+  }
+
+  Bitset& operator&=(const Bitset& other)
+  {
+    for (uint8_t w = 0; w < WORDS; ++w)
+      words[w] &= other.words[w];
+    return *this;
+  }
+
+  /**
+   * Takes out every bit set in other
+   */
+  Bitset& operator-=(const Bitset& other)
+  {
+    for (uint8_t w = 0; w < WORDS; ++w)
+      words[w] &= ~other.words[w];
+    return *this;
+  }
+
+private:
+  static inline bitset_word_t mask(const uint8_t i)
+  {
+    return static_cast<bitset_word_t>(1) << (i % WORD_BITS);
+  }
+
+  bitset_word_t words[WORDS];
+};
+
+#endif
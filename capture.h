@@ -0,0 +1,332 @@
+#ifndef CAPTURE_H_INCLUDE
+#define CAPTURE_H_INCLUDE
+
+#include <stdint.h>
+#include <string.h>
+
+#include <Arduino.h>
+
+#include "packets.h"
+#include "types.h"
+
+/**
+ * Radio capture format
+ * A capture is a run of records, each a header byte with the kind in the top two bits and a count in the rest,
+ * then how many microseconds of micros() have gone by since the record before as a varint, seven bits a byte
+ * starting with the lowest and the top bit set on all but the last. A record's time is when the loop() it was made
+ * in started, so everything one loop did has the same time and a replay can run that loop when the box did:
+ * - RX, a frame as it came off the radio, before it's authenticated. The count is its length, then the frame
+ * - TX, a frame handed to the radio. The count is its length, then the radio ID it's going to and the frame
+ * - DONE, how a send went. The count is 1 if it was acknowledged and 0 if it wasn't, then the radio ID
+ * - LOCAL, something done to the box itself that changes what it sends, so a replay can do it too. The count is
+ *   its length, then an Input and what goes with it
+ * - SYNC, a LOCAL header with the count all ones, the first byte of MAGIC. It carries the rest of MAGIC, VERSION,
+ *   our radio ID, channel, radio profile, FLAG_* for the sketch options that change what's on the air, the seed
+ *   random() was given as a little endian uint32, micros() as a little endian uint32 that the next record's time
+ *   counts from, and how many bytes of records follow as a little endian uint16, or OPEN_ENDED
+ * Anything reading a capture can find its way in at MAGIC, a SYNC is written whenever the radio is set up and
+ * ahead of any text we send over Serial, see dump().
+ * The radio being set up reseeds random() with the seed in its SYNC, so everything the node picks at random from
+ * then on, ping jitter and gossip partners, follows from the capture. A SYNC from dump() has a seed of 0, since
+ * random() has moved on since
+ */
+namespace capture
+{
+  enum class Kind : uint8_t
+  {
+    RX,
+    TX,
+    DONE,
+    LOCAL
+  };
+
+  enum class Input : uint8_t
+  {
+    TAG, // a player's tag read in the game, the team and the player
+    PLAY // a game started from here, the node and team counts
+  };
+
+  const uint8_t SYNC_HEADER = 0xFF;
+  const uint8_t MAGIC[4] = {SYNC_HEADER, 'c', 'a', 'p'};
+  const uint8_t VERSION = 4; // bumped with the wire format too, the frames in a capture are decoded with packets.h
+  const uint8_t SYNC_SEED = sizeof(MAGIC) + 5; // where the seed is in a SYNC
+  const uint8_t SYNC_TIME = SYNC_SEED + sizeof(uint32_t); // and the time
+  const uint8_t SYNC_SIZE = SYNC_TIME + sizeof(uint32_t) + sizeof(uint16_t);
+  const uint16_t OPEN_ENDED = UINT16_MAX;
+
+  const uint8_t FLAG_AUTH = 1; // frames carry a trailer, see auth.h
+  const uint8_t FLAG_TDMA = 2;
+  const uint8_t FLAG_DUTY_CYCLE = 4;
+
+  const uint8_t COUNT_BITS = 6;
+  const uint8_t COUNT_MASK = (1 << COUNT_BITS) - 1;
+  static_assert(SYNC_HEADER == (static_cast<uint8_t>(Kind::LOCAL) << COUNT_BITS | COUNT_MASK), "a SYNC is a LOCAL header with the count all ones");
+  // header, a five byte varint covers the longest gap micros() can have, radio ID and frame
+  const uint8_t MAX_RECORD = 1 + 5 + 1 + MAX_FRAME_SIZE;
+
+  /**
+   * What goes in a SYNC besides the time
+   */
+  struct Sync
+  {
+    radio_id id;
+    channel_t channel;
+    uint8_t profile;
+    uint8_t flags;
+    uint32_t seed; // what random() was seeded with, 0 if it wasn't just now
+  };
+
+  /**
+   * Writes a SYNC record
+   * @param out buffer with room for SYNC_SIZE bytes
+   * @param sync who we are
+   * @param base micros() the next record's time counts from
+   * @param following bytes of records after it, or OPEN_ENDED
+   * @return SYNC_SIZE
+   */
+  inline uint8_t encode_sync(uint8_t* out, const Sync& sync, const uint32_t base, const uint16_t following)
+  {
+    memcpy(out, MAGIC, sizeof(MAGIC));
+    uint8_t* p = out + sizeof(MAGIC);
+    *p++ = VERSION;
+    *p++ = sync.id;
+    *p++ = sync.channel;
+    *p++ = sync.profile;
+    *p++ = sync.flags;
+    memcpy(out + SYNC_SEED, &sync.seed, sizeof(sync.seed));
+    memcpy(out + SYNC_TIME, &base, sizeof(base));
+    memcpy(out + SYNC_TIME + sizeof(base), &following, sizeof(following));
+    return SYNC_SIZE;
+  }
+
+  /**
+   * Writes an RX, TX, DONE or LOCAL record
+   * @param out buffer with room for MAX_RECORD bytes
+   * @param kind what happened
+   * @param count the frame's length, for DONE whether it was acknowledged
+   * @param elapsed microseconds since the record before
+   * @param peer radio ID the frame was sent to, TX and DONE only
+   * @param frame count bytes of frame or input, all but DONE
+   * @return bytes written
+   */
+  inline uint8_t encode(uint8_t* out, const Kind kind, const uint8_t count, uint32_t elapsed, const radio_id peer,
+    const uint8_t* frame)
+  {
+    uint8_t size = 0;
+    out[size++] = static_cast<uint8_t>(kind) << COUNT_BITS | count;
+    while (elapsed >= 0x80)
+    {
+      out[size++] = static_cast<uint8_t>(elapsed) | 0x80;
+      elapsed >>= 7;
+    }
+    out[size++] = elapsed;
+    if (kind == Kind::TX || kind == Kind::DONE)
+      out[size++] = peer;
+    if (kind != Kind::DONE)
+    {
+      memcpy(out + size, frame, count);
+      size += count;
+    }
+    return size;
+  }
+};
+
+/**
+ * Records what goes over the radio, see the capture namespace for the format
+ * Either keeps the latest TBytes of records and writes them out on dump(), throwing the oldest away whole to
+ * make room, or with TBytes of 0 streams every record out as it happens. A record that won't fit in what's
+ * left of the Serial buffer is dropped rather than waiting for room, so capturing never holds up the radio
+ * @param TBytes bytes of records to keep, 0 to stream them
+ */
+template <uint16_t TBytes>
+class Capture
+{
+public:
+  /**
+   * @param o where records go, Serial
+   */
+  Capture(HardwareSerial& o) : out(o), looped(0), last(0), base(0), head(0), used(0), dropped(0)
+  {
+    memset(&sync, 0, sizeof(sync));
+  }
+
+  /**
+   * Marks a loop starting, everything recorded until the next one gets its time
+   * @param now micros()
+   */
+  inline void loop(const uint32_t now) { looped = now; }
+
+  /**
+   * Marks the radio being set up, which starts a capture
+   * @param now micros()
+   * @param s who we are now
+   */
+  void start(const uint32_t now, const capture::Sync& s)
+  {
+    // set up part way through a loop, what's left of it counts from here
+    looped = now;
+    sync = s;
+    uint8_t record[capture::SYNC_SIZE];
+    put(record, capture::encode_sync(record, sync, now, capture::OPEN_ENDED), now);
+  }
+
+  /**
+   * @param frame frame as it came off the radio
+   * @param length bytes in the frame
+   */
+  void received(const uint8_t* frame, const uint8_t length)
+  {
+    add(capture::Kind::RX, length, 0, frame);
+  }
+
+  /**
+   * @param target radio ID it's going to
+   * @param frame frame as it goes to the radio
+   * @param length bytes in the frame
+   */
+  void sent(const radio_id target, const uint8_t* frame, const uint8_t length)
+  {
+    add(capture::Kind::TX, length, target, frame);
+  }
+
+  /**
+   * @param target radio ID the send was to
+   * @param ok true if it was acknowledged
+   */
+  void done(const radio_id target, const bool ok)
+  {
+    add(capture::Kind::DONE, ok, target, nullptr);
+  }
+
+  /**
+   * @param what what was done to the box
+   * @param a the team for a TAG, the node count for PLAY
+   * @param b the player for a TAG, the team count for PLAY
+   */
+  void input(const capture::Input what, const uint8_t a, const uint8_t b)
+  {
+    const uint8_t data[3] = {static_cast<uint8_t>(what), a, b};
+    add(capture::Kind::LOCAL, sizeof(data), 0, data);
+  }
+
+  /**
+   * Writes out everything kept, behind a SYNC that says how much there is, and forgets it
+   * Streaming, it writes a SYNC so whatever reads the capture finds its way back in after any text that follows
+   */
+  void dump()
+  {
+    uint8_t record[capture::SYNC_SIZE];
+    sync.seed = 0;
+    if (TBytes == 0)
+    {
+      out.write(record, capture::encode_sync(record, sync, last, capture::OPEN_ENDED));
+      return;
+    }
+    out.write(record, capture::encode_sync(record, sync, base, used));
+    const uint16_t tail = (head + TBytes - used) % TBytes;
+    const uint16_t first = TBytes - tail < used ? TBytes - tail : used;
+    out.write(ring + tail, first);
+    out.write(ring, used - first);
+    used = 0;
+    base = last;
+  }
+
+  /**
+   * Gets how many records never made it, for want of room in the Serial buffer or pushed out of the ring
+   * @return dropped count
+   */
+  inline uint16_t getDropped() const { return dropped; }
+
+private:
+  void add(const capture::Kind kind, const uint8_t count, const radio_id peer, const uint8_t* frame)
+  {
+    uint8_t record[capture::MAX_RECORD];
+    put(record, capture::encode(record, kind, count, looped - last, peer, frame), looped);
+  }
+
+  void put(const uint8_t* record, const uint8_t size, const uint32_t now)
+  {
+    if (TBytes == 0)
+    {
+      if (out.availableForWrite() < size)
+      {
+        // the next one that goes counts its time from the last one that did
+        drop();
+        return;
+      }
+      out.write(record, size);
+      last = now;
+      return;
+    }
+
+    while (TBytes - used < size)
+      evict();
+    for (uint8_t i = 0; i < size; ++i)
+    {
+      ring[head] = record[i];
+      head = (head + 1) % TBytes;
+    }
+    used += size;
+    last = now;
+  }
+
+  /**
+   * Throws away the oldest record, moving the time the ones left count from on past it
+   */
+  void evict()
+  {
+    const uint16_t tail = (head + TBytes - used) % TBytes;
+    const uint8_t header = at(tail);
+    const capture::Kind kind = static_cast<capture::Kind>(header >> capture::COUNT_BITS);
+    uint16_t size;
+    if (header == capture::SYNC_HEADER)
+    {
+      uint8_t time[sizeof(uint32_t)];
+      for (uint8_t b = 0; b < sizeof(time); ++b)
+        time[b] = at(tail + capture::SYNC_TIME + b);
+      memcpy(&base, time, sizeof(base));
+      size = capture::SYNC_SIZE;
+    }
+    else
+    {
+      uint16_t i = tail + 1;
+      uint32_t elapsed = 0;
+      uint8_t shift = 0;
+      uint8_t b;
+      do
+      {
+        b = at(i++);
+        elapsed |= static_cast<uint32_t>(b & 0x7F) << shift;
+        shift += 7;
+      } while (b & 0x80);
+      base += elapsed;
+      size = i - tail;
+      if (kind == capture::Kind::TX || kind == capture::Kind::DONE)
+        ++size;
+      if (kind != capture::Kind::DONE)
+        size += header & capture::COUNT_MASK;
+    }
+    used -= size;
+    drop();
+  }
+
+  inline uint8_t at(const uint16_t i) const { return ring[i % TBytes]; }
+
+  inline void drop()
+  {
+    if (dropped < UINT16_MAX)
+      ++dropped;
+  }
+
+  HardwareSerial& out;
+  capture::Sync sync;
+  uint32_t looped; // micros() when the loop we're in started
+  uint32_t last; // time of the latest record kept or sent
+  uint32_t base; // time the oldest record in the ring counts from
+  uint8_t ring[TBytes ? TBytes : 1];
+  uint16_t head; // where the next byte goes
+  uint16_t used;
+  uint16_t dropped;
+};
+
+#endif
@@ -0,0 +1,117 @@
+#ifndef CHANNELS_H_INCLUDE
+#define CHANNELS_H_INCLUDE
+
+#include <stdint.h>
+
+#include <NRFLite.h>
+
+#include "types.h"
+
+/**
+ * Channel selection
+ * Interference shows up as sends to neighbours we know are there failing after all their retries. Once enough
+ * of them fail the network scans for a quieter channel and everyone moves over to it together at a set network
+ * time, see retune() in main.cpp
+ */
+namespace channels
+{
+  const channel_t MAX_CHANNEL = 125;
+  // carrier samples per channel when scanning, a full scan takes a few hundred milliseconds
+  const uint8_t SCAN_SAMPLES = 8;
+
+  /**
+   * Scans every channel and picks the quietest
+   * Activity on either side counts for half, a channel next to a busy one still gets its splatter
+   * The radio is left on whatever channel was scanned last, so it needs initialising again afterwards
+   * @param radio radio to scan with
+   * @param avoid channel to skip, the one we're moving away from
+   * @return the quietest channel
+   */
+  inline channel_t quietest(NRFLite& radio, const channel_t avoid)
+  {
+    channel_t best = avoid;
+    uint16_t bestScore = UINT16_MAX;
+
+    uint8_t previous = 0;
+    uint8_t current = radio.scanChannel(0, SCAN_SAMPLES);
+    for (channel_t ch = 0; ch <= MAX_CHANNEL; ++ch)
+    {
+      const uint8_t next = ch < MAX_CHANNEL ? radio.scanChannel(ch + 1, SCAN_SAMPLES) : 0;
+      const uint16_t score = 2 * current + previous + next;
+      if (ch != avoid && score < bestScore)
+      {
+        best = ch;
+        bestScore = score;
+      }
+      previous = current;
+      current = next;
+    }
+    return best;
+  }
+};
+
+/**
+ * Counts failed sends to our neighbours to spot interference
+ */
+class ChannelMonitor
+{
+public:
+  // sends to judge the channel on
+  static const uint8_t WINDOW = 32;
+  // failures in a window that mean the channel has gone bad, a little over a third
+  static const uint8_t MAX_FAILURES = 12;
+  // shortest time between moves, so one noisy afternoon doesn't have us hopping about
+  static const millis_t COOLDOWN = 60000;
+
+  ChannelMonitor()
+  {
+    moved(0);
+  }
+
+  /**
+   * Starts afresh on a new channel
+   * @param now current millis()
+   */
+  void moved(const millis_t now)
+  {
+    sends = 0;
+    failures = 0;
+    lastMove = now;
+  }
+
+  /**
+   * Records how a send to a known neighbour went
+   * @param ok true if it was acknowledged
+   */
+  void sent(const bool ok)
+  {
+    if (sends < UINT8_MAX)
+      ++sends;
+    if (!ok && failures < UINT8_MAX)
+      ++failures;
+  }
+
+  /**
+   * Judges the channel once there have been enough sends
+   * @param now current millis()
+   * @return true if it's bad enough to move, and we haven't moved too recently
+   */
+  bool interference(const millis_t now)
+  {
+    if (sends < WINDOW)
+      return false;
+    const bool bad = failures >= MAX_FAILURES;
+    sends = 0;
+    failures = 0;
+    return bad && settled(now);
+  }
+
+  inline bool settled(const millis_t now) const { return now - lastMove >= COOLDOWN; }
+
+private:
+  uint8_t sends;
+  uint8_t failures;
+  millis_t lastMove;
+};
+
+#endif
@@ -0,0 +1,250 @@
+#ifndef CLOCKSYNC_H_INCLUDE
+#define CLOCKSYNC_H_INCLUDE
+
+#include <stdint.h>
+
+#include <Arduino.h>
+
+#include "types.h"
+
+/**
+ * Network time
+ * One node is the reference (stratum 0) and its network time is simply its own clock. Everyone else follows
+ * the neighbour closest to the reference, estimating their offset from that neighbour's network time with
+ * PING/PONG exchanges. Drift is how fast the parent's network time runs against our millis(): the rate between
+ * the two crystals, measured off the parent's own millis() so none of its corrections get mistaken for one,
+ * plus the parent's drift, which it sends along
+ */
+class ClockSync
+{
+public:
+  static const uint8_t UNSYNCED = UINT8_MAX;
+  static const radio_id NO_PARENT = UINT8_MAX;
+
+  // how long we keep following a parent we've stopped getting samples from
+  static const millis_t PARENT_TIMEOUT = 10000;
+  // deeper than this and we're following each other round in a loop with the reference long gone, a path with
+  // no loop is never longer than the network
+  static const uint8_t MAX_STRATUM = MAX_NODES < 16 ? 15 : MAX_NODES - 1;
+
+  ClockSync()
+  {
+    init();
+  }
+
+  /**
+   * Forgets everything, network time restarts as our own clock
+   */
+  void init()
+  {
+    offset = 0;
+    drift = 0;
+    rate = 0;
+    anchor = 0;
+    stratum = UNSYNCED;
+    parent = NO_PARENT;
+    samples = 0;
+  }
+
+  /**
+   * Makes us the reference clock
+   * Whatever network time we had carries on from where it was, so nothing jumps when the reference changes
+   * @param local current millis()
+   */
+  void lead(const millis_t local)
+  {
+    if (stratum == 0)
+      return;
+    offset = time(local) - local;
+    drift = 0;
+    anchor = local;
+    stratum = 0;
+    parent = NO_PARENT;
+  }
+
+  /**
+   * Stops being the reference, someone with a lower ID has turned up
+   */
+  void resign()
+  {
+    if (stratum != 0)
+      return;
+    stratum = UNSYNCED;
+    samples = 0;
+  }
+
+  /**
+   * Stops following a parent we haven't heard from
+   * @param local current millis()
+   */
+  void expire(const millis_t local)
+  {
+    if (stratum == 0 || parent == NO_PARENT)
+      return;
+    if (local - last < PARENT_TIMEOUT)
+      return;
+
+    orphan(local);
+  }
+
+  /**
+   * Feeds in a completed PING/PONG exchange
+   * @param peer radio ID that answered
+   * @param peerStratum their stratum, from the PONG
+   * @param sent our millis() when the PING was made
+   * @param theirs their network time when the PONG was made
+   * @param theirsLocal their millis() at the same point
+   * @param theirDrift their drift, from the PONG
+   * @param received our millis() when the PONG arrived
+   */
+  void sample(const radio_id peer, const uint8_t peerStratum, const millis_t sent, const millis_t theirs,
+    const millis_t theirsLocal, const int32_t theirDrift, const millis_t received)
+  {
+    if (stratum == 0 || peerStratum == UNSYNCED || received - sent > MAX_RTT)
+      return;
+    if (peerStratum >= MAX_STRATUM)
+    {
+      if (peer == parent)
+        orphan(received);
+      return;
+    }
+
+    // stick with the parent we have unless this one is closer to the reference
+    if (peer != parent)
+    {
+      if (stratum != UNSYNCED && peerStratum + 1 >= stratum)
+        return;
+      parent = peer;
+      samples = 0;
+    }
+    // our parent has moved in the tree, most likely onto another reference, and its time may have jumped with
+    // it, which the drift estimate would take for a crystal running wildly fast or slow
+    else if (peerStratum + 1 != stratum)
+      samples = 0;
+    stratum = peerStratum + 1;
+    last = received;
+
+    // assume the PONG took half the round trip, anything slower than the best we've seen was held up somewhere
+    const millis_t rtt = received - sent;
+    if (samples > 0 && rtt > bestRtt + RTT_SLACK)
+    {
+      // the best we've seen might have been a fluke, so slowly let it go
+      ++bestRtt;
+      return;
+    }
+    const int32_t measured = static_cast<int32_t>(theirs + rtt / 2 - received);
+    const int32_t crystals = static_cast<int32_t>(theirsLocal + rtt / 2 - received);
+
+    if (samples == 0)
+    {
+      offset = measured;
+      rate = 0;
+      rated = false;
+      drift = clamp(theirDrift);
+      anchor = received;
+      baseCrystals = crystals;
+      baseTime = received;
+      bestRtt = rtt;
+      samples = 1;
+      return;
+    }
+    if (rtt < bestRtt)
+    {
+      bestRtt = rtt;
+      // the first sample could have been held up by anything, start the first baseline again from a better one
+      if (!rated)
+      {
+        baseCrystals = crystals;
+        baseTime = received;
+      }
+    }
+
+    // move half way towards the measurement from where the current estimate says we should be
+    const int32_t predicted = static_cast<int32_t>(time(received) - received);
+    offset = predicted + (measured - predicted) / 2;
+    anchor = received;
+    if (samples < UINT8_MAX)
+      ++samples;
+
+    // the rate needs a long baseline, a millisecond of jitter over a short one is a huge rate, so each baseline
+    // runs to MAX_BASELINE. The first one's rate is used as it grows, later ones are averaged with the last
+    const millis_t elapsed = received - baseTime;
+    if (elapsed >= DRIFT_BASELINE)
+    {
+      const int32_t measuredRate = static_cast<int32_t>(static_cast<int64_t>(crystals - baseCrystals) * 1000000 / static_cast<int32_t>(elapsed));
+      if (!rated)
+        rate = clamp(measuredRate);
+      if (elapsed >= MAX_BASELINE)
+      {
+        if (rated)
+          rate = clamp((rate + measuredRate) / 2);
+        rated = true;
+        baseCrystals = crystals;
+        baseTime = received;
+      }
+    }
+    drift = clamp(rate + theirDrift);
+  }
+
+  /**
+   * Converts one of our millis() values to network time
+   * @param local millis() value
+   * @return network time
+   */
+  millis_t time(const millis_t local) const
+  {
+    const int32_t elapsed = static_cast<int32_t>(local - anchor);
+    return local + offset + static_cast<int32_t>(static_cast<int64_t>(drift) * elapsed / 1000000);
+  }
+
+  inline millis_t now() const { return time(millis()); }
+  inline uint8_t getStratum() const { return stratum; }
+  inline radio_id getParent() const { return parent; }
+  inline int32_t getDrift() const { return drift; }
+
+private:
+  static inline int32_t clamp(const int32_t ppm)
+  {
+    return ppm > MAX_DRIFT ? MAX_DRIFT : ppm < -MAX_DRIFT ? -MAX_DRIFT : ppm;
+  }
+
+  /**
+   * Lets go of our parent, keeping running on the estimate we had until there's a new one
+   * @param local current millis()
+   */
+  void orphan(const millis_t local)
+  {
+    offset = time(local) - local;
+    anchor = local;
+    stratum = UNSYNCED;
+    parent = NO_PARENT;
+    samples = 0;
+  }
+
+  // round trips this much slower than the best one are thrown away
+  static const millis_t RTT_SLACK = 2;
+  // a PONG that sat in a queue this long says nothing useful, not even as a first sample
+  static const millis_t MAX_RTT = 50;
+  // shortest and longest baselines the rate is measured over
+  static const millis_t DRIFT_BASELINE = 10000;
+  static const millis_t MAX_BASELINE = 60000;
+  // ceramic resonators are good to about 0.5%, anything beyond double that is nonsense
+  static const int32_t MAX_DRIFT = 10000;
+
+  int32_t offset;  // network time - millis() at the anchor
+  int32_t drift;   // how fast the offset moves, in ppm
+  int32_t rate;    // how fast the parent's crystal runs against ours, in ppm
+  millis_t anchor; // millis() the offset was last estimated at
+
+  uint8_t stratum;
+  radio_id parent;
+  millis_t last; // millis() of the last sample from the parent
+
+  uint8_t samples;
+  millis_t bestRtt;
+  int32_t baseCrystals; // the parent's millis() - ours at the start of the rate baseline
+  bool rated; // there's been a whole baseline
+  millis_t baseTime;
+};
+
+#endif
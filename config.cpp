@@ -9,6 +9,7 @@ namespace config
     .channel = 0,
     .radioID = 0,
     .nodeCount = 5,
+    .profile = 0,
   };
   bool loaded = false;
 
@@ -76,4 +77,17 @@ namespace config
     configuration.nodeCount = count;
     save();
   }
+
+  uint8_t getProfile()
+  {
+    load();
+    return configuration.profile;
+  }
+
+  void setProfile(const uint8_t profile)
+  {
+    load();
+    configuration.profile = profile;
+    save();
+  }
 }
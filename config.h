@@ -10,6 +10,8 @@ namespace config
 {
   const uint16_t CRC_ADDRESS = 0;
   const uint16_t DATA_ADDRESS = 8;
+  // where the frame counter's epoch lives, see auth.h
+  const uint16_t EPOCH_ADDRESS = 32;
 
   // hard coded configuration stuff
 
@@ -21,6 +23,7 @@ namespace config
     channel_t channel;
     radio_id radioID;
     uint8_t nodeCount;
+    uint8_t profile; // radio profile, see linkmanager.h
   };
 
   channel_t getChannel();
@@ -31,6 +34,9 @@ namespace config
 
   uint8_t getNodeCount();
   void setNodeCount(const uint8_t count);
+
+  uint8_t getProfile();
+  void setProfile(const uint8_t profile);
 };
 
 
@@ -0,0 +1,264 @@
+#ifndef COORDINATOR_H_INCLUDE
+#define COORDINATOR_H_INCLUDE
+
+#include <stdint.h>
+
+#include "bitset.h"
+#include "routing.h"
+#include "types.h"
+
+/**
+ * Coordinator election and claim fan out
+ * Rather than every node sending each claim to everyone, claims go to one coordinator, which holds them for
+ * WINDOW and passes them on to everyone else together, so a burst of claims shares frames and a node claimed
+ * twice in a window goes out once.
+ * The coordinator is the lowest radio ID that's alive. It holds a lease, which it renews with everyone every
+ * RENEW, and a lease is good for LEASE from when it's heard. A renewal goes along with the next ping or pong to
+ * each node, see owes(), and only the ones that haven't gone that way by the next renewal are sent on their own.
+ * When the coordinator goes quiet everyone's lease on it runs out within LEASE, and they count it out until they
+ * hear another from it. The next lowest takes over at its next update() and tells everyone straight away, and
+ * anyone still holding the old lease then follows it from the renewal after, so everyone has moved on within
+ * LEASE + 2 * RENEW. A node that doesn't know of a coordinator broadcasts its claims itself, and a claim the
+ * coordinator never acknowledged is broadcast again, see orphaned(), so claims get through while the lease moves
+ * @param TNodes number of radio IDs in the network
+ */
+template <uint8_t TNodes>
+class Coordinator
+{
+public:
+  typedef Bitset<TNodes> Set;
+
+  // how long a lease is good for from when it's heard, every node needs the same setting
+  static const millis_t LEASE = 8000;
+  // how often the coordinator renews its lease, a node can go 2 * RENEW between renewals and lose one on the way
+  static const millis_t RENEW = 2000;
+  // how long the coordinator holds claims so the ones close together go out in the same frame
+  static const millis_t WINDOW = 30;
+
+  Coordinator()
+  {
+    init(0);
+  }
+
+  /**
+   * Forgets any lease and anything waiting to go out
+   * @param id our radio ID
+   */
+  void init(const radio_id id)
+  {
+    me = id;
+    holder = NO_ROUTE;
+    expires = 0;
+    renewed = 0;
+    lapsed.clear();
+    owed.clear();
+    pending.clear();
+    flushing = false;
+    flushAt = 0;
+    handedOff = false;
+    terms = 0;
+    failovers = 0;
+  }
+
+  /**
+   * Records a lease renewal
+   * @param from radio ID holding it
+   * @param now current millis()
+   */
+  void leased(const radio_id from, const millis_t now)
+  {
+    if (from >= TNodes)
+      return;
+    lapsed.reset(from);
+    // the lower radio ID wins, one of them hasn't heard the other yet
+    if (valid(now) && holder < from)
+      return;
+    holder = from;
+    expires = now + LEASE;
+  }
+
+  /**
+   * Gets who claims go to
+   * @param now current millis()
+   * @return radio ID of the coordinator, possibly us, or NO_ROUTE to broadcast them
+   */
+  inline radio_id current(const millis_t now) const { return valid(now) ? holder : NO_ROUTE; }
+
+  /**
+   * Runs the election, call this every loop
+   * @param now current millis()
+   * @param live who the failure detector hasn't given up on
+   * @param late filled in with who to send a renewal to on its own now
+   * @return true if there's anyone in late
+   */
+  bool update(const millis_t now, const Set& live, Set& late)
+  {
+    if (holder != NO_ROUTE && holder != me && !valid(now))
+    {
+      lapsed.set(holder);
+      holder = NO_ROUTE;
+      if (failovers < UINT16_MAX)
+        ++failovers;
+    }
+    if (valid(now) && holder < me)
+      return false;
+
+    // anyone lower that's still about and hasn't let a lease run out gets it before us
+    for (radio_id i = 0; i < me; ++i)
+    {
+      if (live.test(i) && !lapsed.test(i))
+      {
+        if (holder == me)
+          holder = NO_ROUTE;
+        return false;
+      }
+    }
+
+    if (holder == me && now - renewed < RENEW)
+      return false;
+    if (holder == me)
+    {
+      // whoever nothing went to since the last renewal
+      late = owed;
+    }
+    else
+    {
+      // just taken over, everyone needs to hear about it now
+      late.clear();
+      for (radio_id i = 0; i < TNodes; ++i)
+        late.set(i);
+      late.reset(me);
+      if (terms < UINT16_MAX)
+        ++terms;
+    }
+    for (radio_id i = 0; i < TNodes; ++i)
+      owed.set(i);
+    owed -= late;
+    owed.reset(me);
+    holder = me;
+    expires = now + LEASE;
+    renewed = now;
+    return late.any();
+  }
+
+  /**
+   * Gets whether a node is due a renewal we haven't sent yet, for sending it along with something else
+   * @param node radio ID we're sending to
+   * @return true if a LEASE should go with it, it's counted as sent
+   */
+  bool owes(const radio_id node)
+  {
+    if (node >= TNodes || !owed.test(node))
+      return false;
+    owed.reset(node);
+    return true;
+  }
+
+  /**
+   * Records a send that ran out of retries, if it was to the coordinator it's gone as far as we're concerned
+   * @param target radio ID the send was to
+   */
+  void lost(const radio_id target)
+  {
+    if (target != holder || target == me)
+      return;
+    lapsed.set(target);
+    holder = NO_ROUTE;
+    if (failovers < UINT16_MAX)
+      ++failovers;
+  }
+
+  /**
+   * Records that we've handed our own claim to the coordinator, it stays ours to deliver until it's acknowledged
+   */
+  inline void handOff() { handedOff = true; }
+
+  /**
+   * Records a send the radio acknowledged
+   * @param target radio ID the send was to
+   */
+  inline void delivered(const radio_id target)
+  {
+    if (target == holder)
+      handedOff = false;
+  }
+
+  /**
+   * Gets whether a claim we handed off was left with a coordinator that's gone, once
+   * @param now current millis()
+   * @return true if it needs broadcasting after all
+   */
+  bool orphaned(const millis_t now)
+  {
+    if (!handedOff || current(now) != NO_ROUTE)
+      return false;
+    handedOff = false;
+    return true;
+  }
+
+  /**
+   * Takes a node's latest claim to pass on, with anything else that turns up in the next WINDOW
+   * @param node radio ID the claim is about
+   * @param now current millis()
+   */
+  void changed(const radio_id node, const millis_t now)
+  {
+    if (node >= TNodes)
+      return;
+    pending.set(node);
+    if (!flushing)
+    {
+      flushing = true;
+      flushAt = now + WINDOW;
+    }
+  }
+
+  /**
+   * Hands over the claims to pass on once their window is up
+   * @param now current millis()
+   * @param out filled in with the radio IDs whose claims go out now
+   * @return true if there are any
+   */
+  bool flush(const millis_t now, Set& out)
+  {
+    if (!flushing || static_cast<int32_t>(now - flushAt) < 0)
+      return false;
+    out = pending;
+    pending.clear();
+    flushing = false;
+    return true;
+  }
+
+  /**
+   * Gets how many times we've taken the lease over
+   * @return term count
+   */
+  inline uint16_t getTerms() const { return terms; }
+
+  /**
+   * Gets how many coordinators we've given up on
+   * @return failover count
+   */
+  inline uint16_t getFailovers() const { return failovers; }
+
+private:
+  inline bool valid(const millis_t now) const
+  {
+    return holder != NO_ROUTE && static_cast<int32_t>(now - expires) < 0;
+  }
+
+  radio_id me;
+  radio_id holder; // whose lease we're following, NO_ROUTE for nobody's
+  millis_t expires;
+  millis_t renewed; // when we last renewed our own
+  Set lapsed; // let a lease run out, passed over until we hear from them again
+  Set owed; // the renewal hasn't gone to them yet
+  Set pending; // claims to pass on
+  bool flushing;
+  millis_t flushAt;
+  bool handedOff; // our latest claim went to the coordinator and it hasn't acknowledged it
+  uint16_t terms;
+  uint16_t failovers;
+};
+
+#endif
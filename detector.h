@@ -0,0 +1,153 @@
+#ifndef DETECTOR_H_INCLUDE
+#define DETECTOR_H_INCLUDE
+
+#include <stdint.h>
+
+#include "bitset.h"
+#include "types.h"
+
+enum class Liveness : uint8_t
+{
+  DEAD,      // never heard from, or gone quiet for far too long
+  SUSPECTED, // quieter than usual
+  ALIVE
+};
+
+/**
+ * Adaptive heartbeat failure detector
+ * Keeps a smoothed mean and mean deviation of the gaps between packets from each node, the same way TCP
+ * estimates round trips. A node is suspected once it's been quiet for longer than its usual gap plus a few
+ * deviations, and dead once it's been quiet for a multiple of that
+ * @param TNodes number of radio IDs in the network
+ */
+template <uint8_t TNodes>
+class FailureDetector
+{
+public:
+  // how many deviations past the mean gap before a node is suspected, more is slower but less jumpy
+  static const uint8_t SUSPECT_DEVIATIONS = 4;
+  // how many suspect timeouts before a node is dead
+  static const uint8_t DEAD_FACTOR = 3;
+  // slack on top, so a node with a perfectly regular heartbeat isn't suspected for one late packet
+  static const millis_t MARGIN = 250;
+  // gap assumed for a node we've only heard from once
+  static const millis_t INITIAL_GAP = 2000;
+
+  FailureDetector()
+  {
+    init();
+  }
+
+  /**
+   * Forgets everyone
+   */
+  void init()
+  {
+    for (uint8_t i = 0; i < TNodes; ++i)
+    {
+      History& h = history[i];
+      h.state = Liveness::DEAD;
+      h.last = 0;
+      h.mean = INITIAL_GAP;
+      h.deviation = INITIAL_GAP / 2;
+    }
+    live.clear();
+  }
+
+  /**
+   * Records a packet from a node
+   * @param node radio ID we heard from
+   * @param now current millis()
+   */
+  void heard(const radio_id node, const millis_t now)
+  {
+    if (node >= TNodes)
+      return;
+
+    History& h = history[node];
+    if (h.state != Liveness::DEAD)
+    {
+      // gaps from the same burst of packets would drag the mean down to nothing
+      const millis_t gap = now - h.last;
+      if (gap < MIN_GAP)
+        return;
+
+      const int32_t error = static_cast<int32_t>(gap) - static_cast<int32_t>(h.mean);
+      h.mean = clamp(h.mean + error / 8);
+      h.deviation = clamp(h.deviation + ((error < 0 ? -error : error) - static_cast<int32_t>(h.deviation)) / 4);
+    }
+    h.state = Liveness::ALIVE;
+    h.last = now;
+    live.set(node);
+  }
+
+  /**
+   * Moves quiet nodes along to suspected and dead
+   * @param now current millis()
+   * @return true if anyone changed state
+   */
+  bool update(const millis_t now)
+  {
+    bool changed = false;
+    for (uint8_t i = 0; i < TNodes; ++i)
+    {
+      History& h = history[i];
+      if (h.state == Liveness::DEAD)
+        continue;
+
+      const millis_t quiet = now - h.last;
+      const millis_t suspect = timeout(i);
+      Liveness state = Liveness::ALIVE;
+      if (quiet > suspect * DEAD_FACTOR)
+        state = Liveness::DEAD;
+      else if (quiet > suspect)
+        state = Liveness::SUSPECTED;
+
+      if (state == h.state)
+        continue;
+      if (state == Liveness::DEAD)
+      {
+        // start afresh if it comes back, it's probably been moved
+        h.mean = INITIAL_GAP;
+        h.deviation = INITIAL_GAP / 2;
+        live.reset(i);
+      }
+      h.state = state;
+      changed = true;
+    }
+    return changed;
+  }
+
+  /**
+   * Gets how long a node can be quiet before it's suspected
+   * @param node radio ID
+   * @return timeout in ms
+   */
+  inline millis_t timeout(const radio_id node) const
+  {
+    return history[node].mean + SUSPECT_DEVIATIONS * static_cast<millis_t>(history[node].deviation) + MARGIN;
+  }
+
+  inline Liveness state(const radio_id node) const { return history[node].state; }
+  // everyone who isn't dead, kept up to date as they change so it never needs working out
+  inline const Bitset<TNodes>& alive() const { return live; }
+
+private:
+  static const millis_t MIN_GAP = 20;
+
+  // gaps are kept to 16 bits, a node that goes over a minute between packets is as good as gone anyway
+  static inline uint16_t clamp(const int32_t ms) { return ms < 0 ? 0 : ms > UINT16_MAX ? UINT16_MAX : ms; }
+
+  struct History
+  {
+    Liveness state;
+    millis_t last; // millis() of the last packet
+    uint16_t mean; // ms
+    uint16_t deviation; // ms
+  };
+
+  History history[TNodes];
+  Bitset<TNodes> live;
+};
+
+#endif
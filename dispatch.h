@@ -0,0 +1,129 @@
+#ifndef DISPATCH_H_INCLUDE
+#define DISPATCH_H_INCLUDE
+
+#include <stdint.h>
+
+#include <Arduino.h>
+
+/**
+ * Timings for a dispatcher that doesn't keep any
+ */
+struct Untimed
+{
+  static const bool TIMED = false;
+
+  inline void record(const uint8_t index, const uint32_t elapsed) {}
+  inline void dump(Print& out) const {}
+};
+
+/**
+ * How long each handler takes, calls, mean and worst
+ * @param TCount number of entries in the table
+ */
+template <uint8_t TCount>
+class HandlerTimings
+{
+public:
+  static const bool TIMED = true;
+
+  HandlerTimings()
+  {
+    memset(timings, 0, sizeof(timings));
+  }
+
+  void record(const uint8_t index, const uint32_t elapsed)
+  {
+    Timing& t = timings[index];
+    if (t.calls < UINT16_MAX)
+    {
+      ++t.calls;
+      t.total += elapsed;
+    }
+    if (elapsed > t.worst)
+      t.worst = elapsed > UINT16_MAX ? UINT16_MAX : elapsed;
+  }
+
+  /**
+   * Writes how long each handler takes
+   * @param out where to write it, normally Serial
+   */
+  void dump(Print& out) const
+  {
+    out.println("op calls mean(us) worst(us)");
+    for (uint8_t i = 0; i < TCount; ++i)
+    {
+      const Timing& t = timings[i];
+      if (t.calls == 0)
+        continue;
+
+      char line[32];
+      snprintf(line, sizeof(line), "%u %u %lu %u", i, t.calls, static_cast<unsigned long>(t.total / t.calls), t.worst);
+      out.println(line);
+    }
+  }
+
+private:
+  struct Timing
+  {
+    uint16_t calls; // stops counting at UINT16_MAX so the mean stays right
+    uint16_t worst; // us
+    uint32_t total; // us
+  };
+
+  Timing timings[TCount];
+};
+
+/**
+ * Calls handlers out of a table by index
+ * The table is built at compile time by whoever owns the handlers and lives in PROGMEM, a null entry means that
+ * index is ignored
+ * @param TCount number of entries in the table
+ * @param TTimings HandlerTimings<TCount> to time each handler, or Untimed
+ * @param TArgs arguments every handler takes
+ */
+template <uint8_t TCount, typename TTimings, typename... TArgs>
+class Dispatcher
+{
+public:
+  typedef void(*handler_t)(TArgs...);
+
+  /**
+   * @param table handlers in PROGMEM, TCount of them
+   */
+  Dispatcher(const handler_t* table) : handlers(table)
+  {
+  }
+
+  /**
+   * Runs the handler for an index
+   * @param index index into the table
+   * @param args passed straight on
+   * @return true if there was a handler
+   */
+  bool dispatch(const uint8_t index, TArgs... args)
+  {
+    if (index >= TCount)
+      return false;
+    const handler_t handler = reinterpret_cast<handler_t>(pgm_read_ptr(&handlers[index]));
+    if (handler == nullptr)
+      return false;
+
+    const uint32_t start = TTimings::TIMED ? micros() : 0;
+    handler(args...);
+    if (TTimings::TIMED)
+      timings.record(index, micros() - start);
+    return true;
+  }
+
+  /**
+   * Writes how long each handler takes, if they're timed
+   * @param out where to write it, normally Serial
+   */
+  inline void dump(Print& out) const { timings.dump(out); }
+
+private:
+  const handler_t* handlers; // in PROGMEM
+  TTimings timings;
+};
+
+#endif
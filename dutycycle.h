@@ -0,0 +1,97 @@
+#ifndef DUTYCYCLE_H_INCLUDE
+#define DUTYCYCLE_H_INCLUDE
+
+#include <stdint.h>
+
+#include "types.h"
+#include "txqueue.h"
+
+/**
+ * Wake windows for running off batteries
+ * Network time is cut into periods and everyone listens for the first part of each one, with the radio powered
+ * down and the CPU idling the rest of the time. Anything sent outside a window waits in the queue for the next
+ * one, claims included, so a claim waits at most one period per hop. Relays go straight on in the same window.
+ * Every so often everyone stays up for a whole period, so two groups that came up apart, with their windows
+ * out of step, still get to hear each other and settle on one clock
+ * Everyone wakes with a queue full of what came up while they slept, so each node holds what isn't urgent back
+ * to its own random start in the window rather than all of it going at once and colliding
+ */
+namespace duty
+{
+  const millis_t PERIOD = 1000;
+  const millis_t WAKE = 100;
+  // no sends this close to either end of a window, clocks are only in sync to a few milliseconds and the
+  // retries need to finish before anyone goes back to sleep
+  const millis_t GUARD = 8;
+  // latest a node's start in a window can be, past the guard
+  const millis_t SPREAD = 60;
+  // every this many periods is spent awake
+  const uint8_t DISCOVERY = 30;
+  // how often through a discovery period we ping the IDs that aren't neighbours
+  const millis_t SWEEP = 200;
+  // longest the CPU stays idle between loops, the RFID reader still needs looking at a few times a second
+  const millis_t DOZE_STEP = 50;
+
+  /**
+   * @param time network time
+   * @return true if it's a period everyone spends awake
+   */
+  inline bool discovering(const millis_t time)
+  {
+    return time / PERIOD % DISCOVERY == 0;
+  }
+
+  /**
+   * @param time network time
+   * @return true if everyone should be listening
+   */
+  inline bool awake(const millis_t time)
+  {
+    return time % PERIOD < WAKE || discovering(time);
+  }
+
+  /**
+   * Gets what we're allowed to send at a point in time
+   * @param time network time
+   * @param start how far past the guard we start sending in this window, up to SPREAD
+   * @return the transmit window
+   */
+  inline TxWindow window(const millis_t time, const millis_t start)
+  {
+    // anything urgent, a PONG or a claim, goes straight away, the rest waits for our start
+    const millis_t into = time % PERIOD;
+    if (into >= GUARD && into < WAKE - GUARD)
+      return into >= GUARD + start ? TxWindow::OPEN : TxWindow::URGENT;
+    return discovering(time) ? TxWindow::OPEN : TxWindow::CLOSED;
+  }
+
+  // for the battery estimate, typical draws from the datasheets in uA
+  const uint16_t BATTERY = 2000; // mAh
+  const uint32_t RADIO_RX = 13500;
+  const uint32_t RADIO_POWER_DOWN = 1;
+  const uint32_t MCU_ACTIVE = 9000; // 16MHz at 5V
+  const uint32_t MCU_IDLE = 3000;
+  const uint32_t OTHERS = 25000; // the screen's backlight and the RFID reader, which never sleep
+
+  /**
+   * Estimates the average current draw
+   * @param awake share of the time spent awake, per mille
+   * @return uA
+   */
+  inline uint32_t current(const uint16_t awake)
+  {
+    return OTHERS + ((RADIO_RX + MCU_ACTIVE) * awake + (RADIO_POWER_DOWN + MCU_IDLE) * (1000 - awake)) / 1000;
+  }
+
+  /**
+   * Estimates how long a battery lasts
+   * @param awake share of the time spent awake, per mille
+   * @return hours
+   */
+  inline uint16_t runtime(const uint16_t awake)
+  {
+    return static_cast<uint32_t>(BATTERY) * 1000 / current(awake);
+  }
+};
+
+#endif
@@ -0,0 +1,140 @@
+#ifndef GOSSIP_H_INCLUDE
+#define GOSSIP_H_INCLUDE
+
+#include <stdint.h>
+
+#include <Arduino.h>
+
+#include "routing.h"
+#include "types.h"
+
+/**
+ * Anti-entropy between neighbours
+ * Every round a node swaps digests with one neighbour, picked at random from the ones it hasn't swapped with yet
+ * this cycle. So every neighbour is reached within degree rounds, and as a swap goes both ways (they push what
+ * we're missing, we push what they're missing) anything known anywhere reaches everyone within
+ * diameter * max degree rounds, however many broadcasts were lost on the way. Past 8 nodes a digest only carries
+ * part of the table, so each cycle is about a different part of it, see page()
+ * @param TNodes number of radio IDs in the network
+ */
+template <uint8_t TNodes>
+class Gossip
+{
+public:
+  // time between rounds
+  static const millis_t INTERVAL = 1000;
+
+  Gossip()
+  {
+    init();
+  }
+
+  void init()
+  {
+    contacted = 0;
+    cycles = 0;
+    rounds = 0;
+    adoptions = 0;
+    lastLag = 0;
+    worstLag = 0;
+    totalLag = 0;
+  }
+
+  /**
+   * Picks who to gossip with this round
+   * @param neighbours mask of radio IDs we can reach directly
+   * @return radio ID, or NO_ROUTE if we have no neighbours
+   */
+  radio_id next(const node_mask_t neighbours)
+  {
+    node_mask_t fresh = neighbours & ~contacted;
+    if (fresh == 0)
+    {
+      contacted = 0;
+      fresh = neighbours;
+      ++cycles;
+    }
+    if (fresh == 0)
+      return NO_ROUTE;
+
+    uint8_t count = 0;
+    for (radio_id i = 0; i < TNodes; ++i)
+    {
+      if (fresh & (static_cast<node_mask_t>(1) << i))
+        ++count;
+    }
+
+    uint8_t pick = random(count);
+    for (radio_id i = 0; i < TNodes; ++i)
+    {
+      const node_mask_t bit = static_cast<node_mask_t>(1) << i;
+      if (!(fresh & bit))
+        continue;
+      if (pick-- == 0)
+      {
+        contacted |= bit;
+        if (rounds < UINT16_MAX)
+          ++rounds;
+        return i;
+      }
+    }
+    return NO_ROUTE;
+  }
+
+  /**
+   * Gets which part of the table this cycle's digests are about
+   * Moving on once a cycle rather than every round means every neighbour gets every part in turn, whatever our
+   * degree
+   * @param pages how many parts the table is split into
+   * @return index of the part
+   */
+  inline uint8_t page(const uint8_t pages) const { return cycles % pages; }
+
+  /**
+   * Records how long a claim took to reach us
+   * @param claimed network time of the claim
+   * @param now current network time
+   */
+  void adopted(const millis_t claimed, const millis_t now)
+  {
+    // clocks that haven't synced yet can put the claim in our future, that says nothing about the gossip
+    if (static_cast<int32_t>(now - claimed) < 0)
+      return;
+
+    lastLag = now - claimed;
+    if (lastLag > worstLag)
+      worstLag = lastLag;
+    if (adoptions < UINT16_MAX)
+    {
+      ++adoptions;
+      totalLag += lastLag;
+    }
+  }
+
+  /**
+   * Writes the round count and how long claims took to converge
+   * @param out where to write it, normally Serial
+   */
+  void dump(Print& out) const
+  {
+    out.println("rounds adopted last(ms) mean(ms) worst(ms)");
+    char line[48];
+    snprintf(line, sizeof(line), "%u %u %lu %lu %lu", rounds, adoptions, static_cast<unsigned long>(lastLag),
+      static_cast<unsigned long>(adoptions ? totalLag / adoptions : 0), static_cast<unsigned long>(worstLag));
+    out.println(line);
+  }
+
+  inline uint16_t getRounds() const { return rounds; }
+  inline millis_t getWorstLag() const { return worstLag; }
+
+private:
+  node_mask_t contacted; // neighbours swapped with this cycle
+  uint8_t cycles;
+  uint16_t rounds;
+  uint16_t adoptions; // newer entries taken into our table
+  millis_t lastLag;
+  millis_t worstLag;
+  uint32_t totalLag;
+};
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef HLC_H_INCLUDE
+#define HLC_H_INCLUDE
+
+#include <stdint.h>
+
+#include "types.h"
+
+/**
+ * Hybrid logical clock for stamping claims
+ * Network time alone can't order two claims a few milliseconds apart, the clock sync error is bigger than that,
+ * and a node whose clock is behind could stamp a claim it made after seeing someone else's with an earlier time.
+ * A stamp is the network time, pushed past the last stamp we made or saw when that's later. So a claim made
+ * after hearing another always sorts after it, and stamps stay within the clock sync error of network time.
+ * The logical counter of a textbook HLC is folded into the low end of the millisecond count rather than sent
+ * separately, it only moves past network time when stamps come faster than one a millisecond.
+ * Stamps that compare equal are broken by radio ID, so every node puts every pair of claims in the same order
+ */
+class HybridClock
+{
+public:
+  HybridClock() : last(0)
+  {
+  }
+
+  /**
+   * Makes a stamp for something happening now
+   * @param physical current network time
+   * @return stamp, later than every stamp made or witnessed before
+   */
+  millis_t stamp(const millis_t physical)
+  {
+    last = static_cast<int32_t>(physical - last) > 0 ? physical : last + 1;
+    return last;
+  }
+
+  /**
+   * Takes in a stamp from someone else, so anything we stamp afterwards sorts after it
+   * @param remote the stamp
+   */
+  void witness(const millis_t remote)
+  {
+    if (static_cast<int32_t>(remote - last) > 0)
+      last = remote;
+  }
+
+  /**
+   * Puts two stamped events in order, the same way on every node
+   * @param a stamp of the first event
+   * @param aNode radio ID that stamped it
+   * @param b stamp of the second event
+   * @param bNode radio ID that stamped it
+   * @return true if a happened before b
+   */
+  static inline bool before(const millis_t a, const radio_id aNode, const millis_t b, const radio_id bNode)
+  {
+    const int32_t diff = static_cast<int32_t>(a - b);
+    return diff < 0 || (diff == 0 && aNode < bNode);
+  }
+
+private:
+  millis_t last;
+};
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef KEY_H_INCLUDE
+#define KEY_H_INCLUDE
+
+#include <stdint.h>
+
+namespace config
+{
+  // key for authenticating frames, see auth.h
+  // copy this file to key.h and put 128 random bits of your own in it, every box in a game needs the same key.
+  // key.h is git ignored so a real key never ends up in the repo
+  const uint32_t NETWORK_KEY[4] = {0x00000000, 0x00000000, 0x00000000, 0x00000000};
+};
+
+#endif
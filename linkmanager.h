@@ -0,0 +1,160 @@
+#ifndef LINKMANAGER_H_INCLUDE
+#define LINKMANAGER_H_INCLUDE
+
+#include <stdint.h>
+
+#include <NRFLite.h>
+
+#include "types.h"
+
+/**
+ * Radio profiles, fastest first
+ * Slower bitrates have better sensitivity, so they reach further and shrug off more noise, at the cost of airtime
+ */
+namespace profiles
+{
+  const uint8_t FAST = 0;
+  const uint8_t MEDIUM = 1;
+  const uint8_t LONG_RANGE = 2;
+  const uint8_t COUNT = 3;
+
+  inline NRFLite::Bitrates bitrate(const uint8_t profile)
+  {
+    switch (profile)
+    {
+      case MEDIUM:
+        return NRFLite::BITRATE1MBPS;
+      case LONG_RANGE:
+        return NRFLite::BITRATE250KBPS;
+      default:
+        return NRFLite::BITRATE2MBPS;
+    }
+  }
+};
+
+/**
+ * Picks the radio profile for the whole network
+ * Every node keeps a smoothed delivery ratio for each of its neighbours and reports the worst one to the
+ * reference, which steps everyone down a profile when the worst link in the network gets poor and back up
+ * once it has been good for a while. Stepping up needs a better link and a longer wait than stepping down, so
+ * a network on the edge doesn't flap between the two
+ * @param TNodes number of radio IDs in the network
+ */
+template <uint8_t TNodes>
+class LinkManager
+{
+public:
+  // delivery ratios are out of this
+  static const uint8_t PERFECT = UINT8_MAX;
+  // worst link below this steps down, about 70%
+  static const uint8_t STEP_DOWN = 180;
+  // worst link above this steps up, about 95%
+  static const uint8_t STEP_UP = 242;
+  // shortest time on a profile before stepping down, and before stepping up
+  static const millis_t HOLD_DOWN = 20000;
+  static const millis_t HOLD_UP = 120000;
+  // reports older than this are ignored, the node has probably gone
+  static const millis_t REPORT_TIMEOUT = 30000;
+
+  LinkManager()
+  {
+    init(0);
+  }
+
+  /**
+   * Starts afresh on a new profile, assuming every link is fine until it's shown otherwise
+   * @param now current millis()
+   */
+  void init(const millis_t now)
+  {
+    for (uint8_t i = 0; i < TNodes; ++i)
+    {
+      quality[i] = PERFECT;
+      reports[i] = PERFECT;
+      reportTimes[i] = seconds(now);
+    }
+    lastChange = now;
+  }
+
+  /**
+   * Records how a send to a neighbour went
+   * @param node radio ID it was sent to
+   * @param ok true if it was acknowledged
+   */
+  void sent(const radio_id node, const bool ok)
+  {
+    if (node >= TNodes)
+      return;
+    const int16_t target = ok ? PERFECT : 0;
+    quality[node] += (target - static_cast<int16_t>(quality[node])) / 8;
+  }
+
+  /**
+   * Records another node's worst link
+   * @param node radio ID that reported
+   * @param worst its worst delivery ratio
+   * @param now current millis()
+   */
+  void report(const radio_id node, const uint8_t worst, const millis_t now)
+  {
+    if (node >= TNodes)
+      return;
+    reports[node] = worst;
+    reportTimes[node] = seconds(now);
+  }
+
+  /**
+   * Gets our worst link
+   * @param neighbours mask of radio IDs in direct range
+   * @return delivery ratio out of PERFECT
+   */
+  uint8_t worst(const node_mask_t neighbours) const
+  {
+    uint8_t w = PERFECT;
+    for (uint8_t i = 0; i < TNodes; ++i)
+    {
+      if ((neighbours & (static_cast<node_mask_t>(1) << i)) && quality[i] < w)
+        w = quality[i];
+    }
+    return w;
+  }
+
+  /**
+   * Decides which profile the network should be on, only the reference should act on this
+   * @param profile profile we're on now
+   * @param neighbours mask of radio IDs in direct range
+   * @param now current millis()
+   * @return profile to move to, the same one to stay put
+   */
+  uint8_t choose(const uint8_t profile, const node_mask_t neighbours, const millis_t now) const
+  {
+    uint8_t w = worst(neighbours);
+    for (uint8_t i = 0; i < TNodes; ++i)
+    {
+      if (static_cast<uint16_t>(seconds(now) - reportTimes[i]) < seconds(REPORT_TIMEOUT) && reports[i] < w)
+        w = reports[i];
+    }
+
+    const millis_t held = now - lastChange;
+    if (w < STEP_DOWN && held >= HOLD_DOWN && profile + 1 < profiles::COUNT)
+      return profile + 1;
+    if (w > STEP_UP && held >= HOLD_UP && profile > 0)
+      return profile - 1;
+    return profile;
+  }
+
+  inline uint8_t getQuality(const radio_id node) const { return quality[node]; }
+
+private:
+  /**
+   * Report times only need to be good to a second or so, and 16 bits of them go round every 18 hours
+   */
+  static inline uint16_t seconds(const millis_t ms) { return ms >> 10; }
+
+  uint8_t quality[TNodes];
+  uint8_t reports[TNodes];
+  uint16_t reportTimes[TNodes]; // seconds()
+  millis_t lastChange;
+};
+
+#endif
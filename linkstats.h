@@ -0,0 +1,201 @@
+#ifndef LINKSTATS_H_INCLUDE
+#define LINKSTATS_H_INCLUDE
+
+#include <stdint.h>
+
+#include <Arduino.h>
+
+#include "types.h"
+
+/**
+ * Per peer radio counters
+ * Sends and failures come from the auto-ACKs, retries are reliable packets we had to send a peer again, and
+ * duplicates are reliable packets a peer sent us that we already had. Round trips from PONGs go in a histogram
+ * with power of two buckets, so one slow pong doesn't hide in an average.
+ * Only the peers we deal with most get a slot, in a big network that's the neighbours, and a new peer takes over
+ * the slot of whichever one has seen the least traffic
+ * @param TSlots number of peers kept
+ */
+template <uint8_t TSlots>
+class LinkStats
+{
+public:
+  // under 2ms, under 4ms, ... under 128ms, and everything slower
+  static const uint8_t RTT_BUCKETS = 8;
+  // id of a slot nobody has
+  static const radio_id NO_PEER = UINT8_MAX;
+
+  struct Peer
+  {
+    radio_id id;
+    uint16_t sends;
+    uint16_t failures;
+    uint16_t retries;
+    uint16_t duplicates;
+    uint16_t received; // frames
+    uint8_t rtt[RTT_BUCKETS];
+    uint16_t lastRtt; // ms, stops at UINT16_MAX
+  };
+
+  LinkStats()
+  {
+    init();
+  }
+
+  void init()
+  {
+    memset(peers, 0, sizeof(peers));
+    for (uint8_t i = 0; i < TSlots; ++i)
+      peers[i].id = NO_PEER;
+  }
+
+  void sent(const radio_id node, const bool ok)
+  {
+    Peer* p = slot(node);
+    if (p == nullptr)
+      return;
+    increment(p->sends);
+    if (!ok)
+      increment(p->failures);
+  }
+
+  void retried(const radio_id node)
+  {
+    Peer* p = slot(node);
+    if (p != nullptr)
+      increment(p->retries);
+  }
+
+  void duplicate(const radio_id node)
+  {
+    Peer* p = slot(node);
+    if (p != nullptr)
+      increment(p->duplicates);
+  }
+
+  void received(const radio_id node)
+  {
+    Peer* p = slot(node);
+    if (p != nullptr)
+      increment(p->received);
+  }
+
+  /**
+   * Records a round trip
+   * Buckets are bytes, so when one fills up they're all halved, which keeps the shape and favours recent pongs
+   * @param node radio ID that answered
+   * @param rtt round trip in ms
+   */
+  void roundTrip(const radio_id node, const millis_t rtt)
+  {
+    Peer* p = slot(node);
+    if (p == nullptr)
+      return;
+
+    p->lastRtt = rtt > UINT16_MAX ? UINT16_MAX : rtt;
+    uint8_t* buckets = p->rtt;
+    const uint8_t b = bucket(rtt);
+    if (buckets[b] == UINT8_MAX)
+    {
+      for (uint8_t i = 0; i < RTT_BUCKETS; ++i)
+        buckets[i] /= 2;
+    }
+    ++buckets[b];
+  }
+
+  /**
+   * Gets the histogram bucket for a round trip
+   * @param rtt round trip in ms
+   * @return bucket index, bucket i holds round trips under 2^(i+1) ms
+   */
+  static uint8_t bucket(millis_t rtt)
+  {
+    uint8_t b = 0;
+    for (rtt >>= 1; rtt && b < RTT_BUCKETS - 1; rtt >>= 1)
+      ++b;
+    return b;
+  }
+
+  /**
+   * Writes a table of every peer we've had anything to do with
+   * @param out where to write it, normally Serial
+   */
+  void dump(Print& out) const
+  {
+    out.println("id sends fail retry dup rx | rtt <2 <4 <8 <16 <32 <64 <128 more");
+    for (uint8_t i = 0; i < TSlots; ++i)
+    {
+      const Peer& p = peers[i];
+      if (p.id == NO_PEER)
+        continue;
+
+      char line[48];
+      snprintf(line, sizeof(line), "%u %u %u %u %u %u |", p.id, p.sends, p.failures, p.retries, p.duplicates,
+        p.received);
+      out.print(line);
+      for (uint8_t b = 0; b < RTT_BUCKETS; ++b)
+      {
+        out.print(' ');
+        out.print(p.rtt[b]);
+      }
+      out.println();
+    }
+  }
+
+  /**
+   * Gets a peer's counters
+   * @param node radio ID
+   * @return its slot, or all zeros if it doesn't have one
+   */
+  const Peer& peer(const radio_id node) const
+  {
+    static const Peer none = {NO_PEER};
+    for (uint8_t i = 0; i < TSlots; ++i)
+    {
+      if (peers[i].id == node)
+        return peers[i];
+    }
+    return none;
+  }
+
+private:
+  /**
+   * Finds a peer's slot, taking one over if it hasn't got one
+   * @param node radio ID
+   * @return the slot, or nullptr for radio IDs that aren't a peer
+   */
+  Peer* slot(const radio_id node)
+  {
+    if (node == NO_PEER)
+      return nullptr;
+    Peer* quietest = &peers[0];
+    for (uint8_t i = 0; i < TSlots; ++i)
+    {
+      Peer& p = peers[i];
+      if (p.id == node)
+        return &p;
+      if (activity(p) < activity(*quietest))
+        quietest = &p;
+    }
+    memset(quietest, 0, sizeof(Peer));
+    quietest->id = node;
+    return quietest;
+  }
+
+  // an empty slot has none, so it's always the first to go
+  static inline uint32_t activity(const Peer& p)
+  {
+    return p.id == NO_PEER ? 0 : static_cast<uint32_t>(p.sends) + p.received + 1;
+  }
+
+  // saturate rather than wrap, a counter that's gone back to 0 is worse than one that's stuck
+  static inline void increment(uint16_t& counter)
+  {
+    if (counter < UINT16_MAX)
+      ++counter;
+  }
+
+  Peer peers[TSlots];
+};
+
+#endif
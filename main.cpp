@@ -1,3 +1,4 @@
+#include <new.h>
 #include <SPI.h>
 #include <NRFLite.h>
 
@@ -16,10 +17,22 @@
 #include "storage.h"
 #include "types.h"
 #include "packets.h"
+#include "channels.h"
+#include "clocksync.h"
+#include "detector.h"
+#include "dispatch.h"
+#include "gossip.h"
+#include "hlc.h"
+#include "linkmanager.h"
+#include "nodetable.h"
+#include "pings.h"
+#include "reliable.h"
+#include "routing.h"
+#include "txqueue.h"
 
 // 0 - TX
 // 1 - RX
-// 2
+const uint8_t PIN_RADIO_IRQ = 2;
 const uint8_t PIN_SPEAKER = 3;
 const uint8_t PIN_PIXEL_SELECT = 4;
 // 5
@@ -49,6 +62,68 @@ const SPISettings settings(125000, MSBFIRST, SPI_MODE0);
 #include "beep.h"
 #endif
 
+// time slotted transmits, every node needs the same setting
+// #define TDMA
+#ifdef TDMA
+#include "tdma.h"
+#endif
+
+// sleep between wake windows on network time, for running off batteries, every node needs the same setting
+// #define DUTY_CYCLE
+#ifdef DUTY_CYCLE
+#include "dutycycle.h"
+#ifdef __AVR__
+#include <avr/sleep.h>
+#endif
+#endif
+
+// MAC and sequence counter on every frame, so only boxes with the network key can talk, every node needs the same setting
+// #define FRAME_AUTH
+#ifdef FRAME_AUTH
+#include "auth.h"
+// the network key, copy key.example.h to key.h and fill it in, see README.md
+#include "key.h"
+#endif
+
+// per peer link statistics and handler timings on a diagnostics screen under Configure, with a dump over Serial.
+// Takes about 450 bytes of RAM with the Serial buffers, which a 328 can't spare alongside everything else
+// #define DIAGNOSTICS
+
+// claims go to one coordinator, which passes them on to everyone in batches, instead of every node sending every
+// claim to everyone, see coordinator.h. Every node needs the same setting
+// it pays off where everyone hears everyone and claims come faster than a couple a second across the game, any
+// slower and the lease costs more than the batching saves, and over several hops the trip to the coordinator and
+// back costs more than a broadcast. Claims show up to a Coordinator::WINDOW later, see sim/coordbench.cpp
+// #define COORDINATOR
+#ifdef COORDINATOR
+#include "coordinator.h"
+#endif
+
+// record every frame sent and received, for working out afterwards what went on over the air, see capture.h
+// the latest few go out over Serial with the diagnostics dump, or with CAPTURE_STREAM every one as it happens
+// #define CAPTURE
+// #define CAPTURE_STREAM
+#ifdef CAPTURE_STREAM
+#define CAPTURE
+#endif
+#ifdef CAPTURE
+#include "capture.h"
+#ifndef DIAGNOSTICS
+#define DIAGNOSTICS
+#endif
+#endif
+
+#ifdef DIAGNOSTICS
+#include "linkstats.h"
+#endif
+
+// receive by interrupt, needs a wire from the radio's IRQ line to PIN_RADIO_IRQ, which the original boards don't
+// have, see README.md. Otherwise network() polls the radio
+// #define RADIO_IRQ
+#ifdef RADIO_IRQ
+#include "rxring.h"
+#endif
+
 const uint8_t RADIO_ID = 0;
 const uint8_t CHANNEL = 0;
 
@@ -70,208 +145,1631 @@ Debounce pinPrev(PIN_PREV);
 Debounce pinSelect(PIN_SELECT);
 
 
-const uint8_t MAX_NODES = 8;
-
-struct NodeState
-{
-  millis_t lastUpdate;
-  millis_t lastPing;
-  millis_t latency;
-
-  uint32_t lat;
-  uint32_t lng;
-
-  team_id team; // who owns this node
-};
-NodeState nodes[MAX_NODES];
-// radio_id graph[MAX_NODES][MAX_NODES];
+const uint8_t MAX_TEAMS = 2;
+// who owns each node, each entry's version is bumped by the node itself whenever its team changes
+NodeTable<MAX_NODES, MAX_TEAMS> nodes;
 
 struct Game
 {
-  millis_t start;
-  millis_t end;
+  millis_t start; // stamp of the setup
+  millis_t end; // stamp of the first win
+  radio_id endedBy; // who made that win, breaks ties between stamps
+  team_id winner;
   uint8_t nodes;
   uint8_t teams;
 };
 Game game = {
   .start = 0,
-  .end = 0
+  .end = 0,
+  .endedBy = 0,
+  .winner = NO_TEAM
 };
 
 
-colour_t teamColours[2] = {COLOUR_RED, COLOUR_BLUE};
+colour_t teamColours[MAX_TEAMS] = {COLOUR_RED, COLOUR_BLUE};
 
 // networking code
 
+void tx_complete(const radio_id target, const TxStatus status);
+void stamp_frame(uint8_t* frame, const uint8_t length);
+
+#ifdef FRAME_AUTH
+// joiners send as JOIN_ID, so that's a sender too
+FrameAuth<MAX_NODES + 1> auth(config::NETWORK_KEY);
+
+uint8_t seal_frame(uint8_t* frame, const uint8_t length)
+{
+  return auth.seal(frame, length);
+}
+#endif
+
+#ifdef CAPTURE
+#ifdef CAPTURE_STREAM
+Capture<0> recorder(Serial);
+#else
+// eight full frames, or twice that many with just a claim in
+Capture<320> recorder(Serial);
+#endif
+
+// the options that change what goes over the air, so whatever reads the capture can make sense of it
+const uint8_t CAPTURE_FLAGS = 0
+  #ifdef FRAME_AUTH
+  | capture::FLAG_AUTH
+  #endif
+  #ifdef TDMA
+  | capture::FLAG_TDMA
+  #endif
+  #ifdef DUTY_CYCLE
+  | capture::FLAG_DUTY_CYCLE
+  #endif
+  ;
+
+void capture_sent(const radio_id target, const uint8_t* frame, const uint8_t length)
+{
+  recorder.sent(target, frame, length);
+}
+
+/**
+ * Starts a capture for the radio being set up
+ * Reseeds random() and records the seed, so a replay can make the same random choices from here on
+ * @param id radio ID it's listening as
+ * @param channel channel it's on
+ * @param profile radio profile it's using
+ */
+void capture_start(const radio_id id, const channel_t channel, const uint8_t profile)
+{
+  const capture::Sync sync = {
+    .id = id,
+    .channel = channel,
+    .profile = profile,
+    .flags = CAPTURE_FLAGS,
+    .seed = static_cast<uint32_t>(random(1, INT32_MAX))
+  };
+  randomSeed(sync.seed);
+  recorder.start(micros(), sync);
+}
+#endif
+
+// six frames, with fewer a star's hub starts dropping the STATE and DIGEST packets it owes every spoke
+TxQueue<6, MAX_NODES> txqueue(radio, tx_complete, stamp_frame,
+  #ifdef FRAME_AUTH
+  seal_frame,
+  #else
+  nullptr,
+  #endif
+  #ifdef CAPTURE
+  capture_sent
+  #else
+  nullptr
+  #endif
+  );
+Routing<MAX_NODES> routing;
+ClockSync netclock;
+HybridClock hlc;
+FailureDetector<MAX_NODES> detector;
+ChannelMonitor monitor;
+LinkManager<MAX_NODES> links;
+#ifdef DIAGNOSTICS
+// counters for the busiest peers only, past 8 radio IDs they're the neighbours
+typedef LinkStats<(MAX_NODES < 8 ? MAX_NODES : 8)> PeerStats;
+PeerStats stats;
+#endif
+#ifdef RADIO_IRQ
+RxRing<4> rxring;
+// the ring filled up with frames still in the radio, network() moves them over once there's room
+volatile bool rxWaiting = false;
+#endif
+PingScheduler<MAX_NODES> pings;
+Gossip<MAX_NODES> gossip;
+// a GAME_SETUP and the WIN after it can both be in flight, plus a slot for a RETUNE
+ReliableBroadcast<3, MAX_NODES> reliable;
+#ifdef COORDINATOR
+Coordinator<MAX_NODES> coordinator;
+#endif
+uint8_t lastBroadcast = NO_MESSAGE; // our latest setup or win, never a retune, for the gameplay screen
+millis_t lastGraph = 0;
+radio_id graphWindow = 0; // rows of the matrix to ask about next
+millis_t lastDigest = 0;
+millis_t lastLink = 0;
+
+// our answer to a joining node, sent outside the queue since the joiner has no place in the node masks. Only what's
+// in the answer is kept, the packet is built as it goes
+struct JoinOffer
+{
+  uint16_t nonce;
+  radio_id id;
+  node_mask_t members;
+  uint16_t epoch;
+  millis_t due;
+  bool pending;
+};
+JoinOffer joinOffer = {};
+// the ID we last offered is held for that joiner for a while, so two joining at once don't get the same one
+uint16_t heldNonce = 0;
+radio_id heldID = NO_ROUTE;
+millis_t heldSince = 0;
+
+// how long housekeeping packets wait for others to share their frame, anything gameplay related goes straight away
+// pings never wait, time spent in the queue would throw off the clock sync
+const millis_t GRAPH_DELAY = 50;
+// time between asking the neighbours about a window of the matrix, so all of it every 5 s
+const millis_t GRAPH_INTERVAL = 5000 / GRAPH_WINDOWS;
+// how soon we ask again after a row comes back, there's likely more where it came from
+const millis_t GRAPH_CATCH_UP = 250;
+const millis_t DIGEST_DELAY = 50;
+const millis_t STATE_DELAY = 20;
+const millis_t ACK_DELAY = 20;
+const millis_t LINK_DELAY = 50;
+const millis_t LEASE_DELAY = 50;
+// gap between each node's offer to a joiner, so they don't all answer at once
+const millis_t OFFER_STAGGER = 2;
+const millis_t OFFER_HOLD = 5000;
+
+// a retune is announced this far ahead, long enough for every reliable retry
+const millis_t RETUNE_DELAY = 4000;
+// where the network is moving to, and the network time it goes
+channel_t nextChannel = 0;
+uint8_t nextProfile = 0;
+millis_t retuneAt = 0;
+bool retunePending = false;
+// the channel scan and restart wait for anything mid send, like a retune
+bool relocatePending = false;
+
+#ifdef DUTY_CYCLE
+bool radioAsleep = false;
+// neighbours whose last PONG put their network time close enough to ours to share the windows
+node_mask_t inStep = 0;
+// the period we're in and how far into its window we start sending, see duty::SPREAD
+millis_t wakePeriod = 0;
+uint8_t wakeStart = 0;
+// millis() of the last discovery sweep, see duty::SWEEP
+millis_t lastSweep = 0;
+// millis() spent with the radio on and off, for the battery estimate
+millis_t awakeTime = 0;
+millis_t dozeTime = 0;
+millis_t lastDoze = 0;
+#endif
+
+#ifdef RADIO_IRQ
+/**
+ * Radio interrupt, hands send results to the queue and moves received frames into the ring
+ */
+void radio_interrupt()
+{
+  uint8_t txOk, txFail, rxReady;
+  radio.whenInterrupts(txOk, txFail, rxReady);
+  if (txOk || txFail)
+  {
+    txqueue.interrupted(txOk, txFail);
+    radio.startRx();
+  }
+
+  uint8_t length;
+  while ((length = radio.hasData(1)) > 0)
+  {
+    uint8_t* slot = rxring.claim();
+    if (slot == nullptr)
+    {
+      rxWaiting = true;
+      break;
+    }
+    radio.readData(slot);
+    rxring.commit(length);
+  }
+}
+
+// blocking sends and reads wait on the same status bits the interrupt clears, so it has to be out of the way
+inline void radio_irq_pause()
+{
+  detachInterrupt(digitalPinToInterrupt(PIN_RADIO_IRQ));
+}
+
+inline void radio_irq_resume()
+{
+  attachInterrupt(digitalPinToInterrupt(PIN_RADIO_IRQ), radio_interrupt, FALLING);
+}
+#endif
+
+/**
+ * Brings the radio up from the config, the capture's left to whoever calls this
+ * @return true if the radio is there
+ */
+inline bool radio_up()
+{
+  #ifdef RADIO_IRQ
+  radio_irq_pause();
+  #endif
+  const bool ok = radio.init(config::getRadioID(), PIN_RADIO_CE, PIN_RADIO_SELECT, profiles::bitrate(config::getProfile()), config::getChannel());
+  #ifdef RADIO_IRQ
+  radio_irq_resume();
+  #endif
+  #ifdef DUTY_CYCLE
+  radioAsleep = false;
+  #endif
+  return ok;
+}
+
+/**
+ * Sets the radio up from the config without touching any network state
+ * @return true if the radio is there
+ */
+inline bool radio_start()
+{
+  #ifdef CAPTURE
+  capture_start(config::getRadioID(), config::getChannel(), config::getProfile());
+  #endif
+  return radio_up();
+}
+
 inline bool radio_init()
 {
-  return radio.init(config::getRadioID(), PIN_RADIO_CE, PIN_RADIO_SELECT, NRFLite::BITRATE2MBPS, config::getChannel());
+  #ifdef CAPTURE
+  // ahead of everything, a replay sets it all up again from the SYNC so it has to start from where we did
+  capture_start(config::getRadioID(), config::getChannel(), config::getProfile());
+  #endif
+  #ifdef RADIO_IRQ
+  txqueue.init(config::getRadioID(), true);
+  #else
+  txqueue.init(config::getRadioID());
+  #endif
+  routing.init(config::getRadioID());
+  netclock.init();
+  #ifdef DUTY_CYCLE
+  inStep = 0;
+  #endif
+  detector.init();
+  #ifdef COORDINATOR
+  coordinator.init(config::getRadioID());
+  #endif
+  pings.init(config::getRadioID(), millis());
+  monitor.moved(millis());
+  links.init(millis());
+  retunePending = false;
+  relocatePending = false;
+  return radio_up();
+}
+
+/**
+ * Keeps the neighbour table up to date from the auto-ACKs
+ * @param target radio the packet was sent to
+ * @param status how the send went
+ */
+void tx_complete(const radio_id target, const TxStatus status)
+{
+  #ifdef CAPTURE
+  recorder.done(target, status == TxStatus::SENT);
+  #endif
+  #ifdef DIAGNOSTICS
+  stats.sent(target, status == TxStatus::SENT);
+  #endif
+  #ifdef DUTY_CYCLE
+  // a send that failed while they could have been asleep, outside the windows or to a neighbour whose windows
+  // aren't ours, says nothing about the link or the channel
+  if (status != TxStatus::SENT &&
+    (!(inStep & (static_cast<node_mask_t>(1) << target)) || !duty::awake(netclock.now())))
+    return;
+  #endif
+
+  // only sends to radios we know are there say anything about the channel
+  if (routing.neighbour(target))
+  {
+    monitor.sent(status == TxStatus::SENT);
+    links.sent(target, status == TxStatus::SENT);
+  }
+
+  if (status == TxStatus::SENT)
+  {
+    routing.heard(target, millis());
+    detector.heard(target, millis());
+    #ifdef COORDINATOR
+    coordinator.delivered(target);
+    #endif
+  }
+  else if (status == TxStatus::FAILED)
+  {
+    routing.lost(target);
+    #ifdef COORDINATOR
+    coordinator.lost(target);
+    #endif
+  }
+}
+
+/**
+ * Stamps PINGs and PONGs with when they go rather than when they were queued, which under TDMA can be most of a
+ * superframe earlier and puts the round trip past anything the clock sync will take
+ * However long a PONG was held is added to its echo, so the pinger only counts the time on the air
+ * @param frame frame about to go
+ * @param length its length
+ */
+void stamp_frame(uint8_t* frame, const uint8_t length)
+{
+  uint8_t offset = FRAME_HEADER_SIZE;
+  while (offset < length)
+  {
+    uint8_t size;
+    Packet* packet = packet_decode(frame + offset, length - offset, size);
+    if (packet == nullptr)
+      break;
+    offset += size;
+
+    if (packet->opcode == OpCode::PING)
+    {
+      packet->echo = millis();
+    }
+    else if (packet->opcode == OpCode::PONG)
+    {
+      const millis_t local = millis();
+      packet->echo += local - packet->local;
+      packet->local = local;
+      packet->timestamp = netclock.time(local);
+    }
+  }
+}
+
+/**
+ * Sends a packet to a single node along its route
+ * This only queues the packet, network() does the sending
+ * @param packet packet to send, the addressing fields are filled in
+ * @param target radio ID of the final destination
+ * @param delay how long the packet can wait for others to share its frame
+ * @return true if there was a route to the target
+ */
+bool unicast(Packet& packet, const radio_id target, const millis_t delay = 0)
+{
+  packet.origin = config::getRadioID();
+  packet.target = target;
+  packet.ttl = MAX_TTL;
+
+  const radio_id hop = routing.nextHop(target);
+  if (hop == NO_ROUTE)
+    return false;
+  return txqueue.send(packet, hop, delay);
+}
+
+/**
+ * Resends a reliable packet to a peer that hasn't acknowledged it
+ * @param packet packet to resend
+ * @param target radio ID of the peer
+ * @return true if there was a route to the peer
+ */
+bool resend(Packet& packet, const radio_id target)
+{
+  #ifdef DIAGNOSTICS
+  stats.retried(target);
+  #endif
+  return unicast(packet, target);
+}
+
+/**
+ * Relays a packet one hop along the route to its target
+ * This only queues the packet, network() does the sending
+ * @param packet packet to relay
+ * @param source radio we got it from
+ */
+void relay(Packet& packet, const radio_id source)
+{
+  if (packet.ttl <= 1)
+    return;
+
+  // never hand it back to whoever gave it to us, our tables disagree and it would only bounce
+  const radio_id hop = routing.nextHop(packet.target);
+  if (hop == NO_ROUTE || hop == source)
+    return;
+
+  --packet.ttl;
+  txqueue.send(packet, hop);
 }
 
-/**
- * Relays packets to all nodes except the origin
- * @param packet packet to relay
- */
-void relay(Packet& packet)
-{
-  const radio_id me = config::getRadioID();
-  packet.source = me;
-  for (uint8_t i = 0; i < MAX_NODES; ++i)
+/**
+ * Sends a packet to all radios we have a route to, leaving its origin alone
+ * Neighbours share one copy, nodes further away get one each along their route
+ * This only queues the packet, network() does the sending
+ * @param packet packet to send
+ * @param except radio ID to leave out, or NO_ROUTE
+ * @param delay how long the packet can wait for others to share its frame
+ */
+void fan_out(Packet& packet, const radio_id except = NO_ROUTE, const millis_t delay = 0)
+{
+  const radio_id me = config::getRadioID();
+  packet.target = TARGET_NEIGHBOURS;
+  packet.ttl = MAX_TTL;
+  node_mask_t neighbours = routing.neighbours();
+  if (except != NO_ROUTE)
+    neighbours &= ~(static_cast<node_mask_t>(1) << except);
+  txqueue.multicast(packet, neighbours, delay);
+
+  for (uint8_t i = 0; i < MAX_NODES; ++i)
+  {
+    if (i == me || i == except || routing.neighbour(i))
+      continue;
+    const radio_id hop = routing.nextHop(i);
+    if (hop == NO_ROUTE)
+      continue;
+    packet.target = i;
+    txqueue.send(packet, hop, delay);
+  }
+}
+
+/**
+ * Passes a network-wide packet along the spanning tree, to every tree edge but the one it came in on
+ * Everyone forwards the first copy they get and no others, so with the same tree everywhere each node hears it
+ * once. While the trees still disagree after a link changes some nodes can be left out, the reliable retries
+ * reach them along their routes
+ * This only queues the packet, network() does the sending
+ * @param packet packet to flood, with its origin and seq set
+ * @param source radio we got it from, or NO_ROUTE if it's ours
+ */
+void flood(Packet& packet, const radio_id source = NO_ROUTE)
+{
+  node_mask_t edges = routing.tree();
+  if (source == NO_ROUTE)
+  {
+    // not in the tree, links only one way or not heard of yet, so everyone gets their own copy
+    if (edges == 0)
+    {
+      fan_out(packet);
+      return;
+    }
+    packet.ttl = MAX_TTL;
+  }
+  else
+  {
+    if (packet.ttl <= 1)
+      return;
+    --packet.ttl;
+    edges &= ~(static_cast<node_mask_t>(1) << source);
+  }
+  packet.target = TARGET_NEIGHBOURS;
+  txqueue.multicast(packet, edges);
+}
+
+// a copy per node takes a queue slot each, past 8 radio IDs that's more than the queue holds, so claims go along
+// the flooding tree instead and everyone passes on the first copy they hear, see handle_claim()
+const bool FLOOD_CLAIMS = MAX_NODES > 8;
+
+/**
+ * Broadcasts a packet to all radios we have a route to
+ * This only queues the packet, network() does the sending
+ * @param packet packet to broadcast
+ */
+void broadcast(Packet& packet)
+{
+  packet.origin = config::getRadioID();
+  if (FLOOD_CLAIMS)
+    flood(packet);
+  else
+    fan_out(packet);
+}
+
+
+/**
+ * Gets everyone we have a route to
+ * @return mask of radio IDs
+ */
+node_mask_t reachable()
+{
+  const radio_id me = config::getRadioID();
+  node_mask_t mask = 0;
+  for (uint8_t i = 0; i < MAX_NODES; ++i)
+  {
+    if (i != me && routing.nextHop(i) != NO_ROUTE)
+      mask |= static_cast<node_mask_t>(1) << i;
+  }
+  return mask;
+}
+
+/**
+ * Gets the reference clock, the lowest radio ID we can reach
+ * @return radio ID of the reference, possibly us
+ */
+radio_id reference()
+{
+  const radio_id me = config::getRadioID();
+  for (uint8_t i = 0; i < me; ++i)
+  {
+    if (routing.nextHop(i) != NO_ROUTE)
+      return i;
+  }
+  return me;
+}
+
+/**
+ * Floods a packet to everyone and keeps resending it to anyone that doesn't acknowledge it
+ * This only queues the packet, network() does the sending
+ * @param packet packet to broadcast
+ */
+void reliable_broadcast(Packet& packet)
+{
+  packet.origin = config::getRadioID();
+  lastBroadcast = reliable.add(packet, reachable(), millis());
+  flood(packet);
+}
+
+/**
+ * Gets our claim to everyone, through the coordinator if there is one
+ * This only queues the packet, network() does the sending
+ * @param packet claim to send
+ */
+void share_claim(Packet& packet)
+{
+  #ifdef COORDINATOR
+  const radio_id me = config::getRadioID();
+  const radio_id holder = coordinator.current(millis());
+  if (holder == me)
+  {
+    coordinator.changed(me, millis());
+    return;
+  }
+  if (holder != NO_ROUTE && unicast(packet, holder))
+  {
+    coordinator.handOff();
+    return;
+  }
+  #endif
+  broadcast(packet);
+}
+
+
+void cb_rerender_gameplay();
+
+/**
+ * Changes our own team, bumping our entry's version so everyone else picks it up
+ * @param team new owner of this node
+ * @return stamp of the change
+ */
+millis_t set_team(const team_id team)
+{
+  const radio_id me = config::getRadioID();
+  const millis_t stamp = hlc.stamp(netclock.now());
+  nodes.setTeam(me, team);
+  nodes.setClaimed(me, stamp);
+  nodes.setVersion(me, nodes.version(me) + 1);
+  return stamp;
+}
+
+/**
+ * Takes a node's ownership if it's newer than what we have
+ * @param node radio ID of the node the state is about
+ * @param team owner of the node
+ * @param version version of the node's entry
+ * @param claimed stamp of the team change
+ * @return true if our table changed
+ */
+bool merge_state(const radio_id node, const team_id team, const version_t version, const millis_t claimed)
+{
+  if (node >= MAX_NODES)
+    return false;
+  hlc.witness(claimed);
+
+  if (!newer(version, nodes.version(node)))
+    return false;
+
+  // someone remembers our entry from before a reset, jump past it so our current team wins
+  if (node == config::getRadioID())
+  {
+    nodes.setVersion(node, version + 1);
+    return false;
+  }
+
+  nodes.setVersion(node, version);
+  nodes.setClaimed(node, claimed);
+  gossip.adopted(claimed, netclock.now());
+  // a claim from before the setup we have belongs to an old game, the node hasn't heard of this one yet
+  const team_id current = nodes.current(node) ? team : NO_TEAM;
+  if (nodes.team(node) == current)
+    return false;
+  nodes.setTeam(node, current);
+  cb_rerender_gameplay();
+  return true;
+}
+
+/**
+ * Catches up with someone else's game
+ * A later setup means a new game, and a win under the setup we have ends ours unless we know of an earlier one.
+ * Everything is compared by stamp, so every node ends up with the same game and the same winner whatever order
+ * the packets turn up in
+ * @param start stamp of their game setup
+ * @param end stamp of their first win
+ * @param endedBy radio ID that made that win
+ * @param winner team that won
+ * @return true if we changed anything
+ */
+bool merge_game(const millis_t start, const millis_t end, const radio_id endedBy, const team_id winner)
+{
+  hlc.witness(start);
+  hlc.witness(end);
+
+  bool changed = false;
+  if (start != 0 && (game.start == 0 || static_cast<int32_t>(start - game.start) > 0))
+  {
+    game.start = start;
+    game.end = 0;
+    game.winner = NO_TEAM;
+    // claims stamped after the setup are part of the new game, they can get here before it does
+    nodes.rebase(start);
+    if (!nodes.current(config::getRadioID()))
+      set_team(NO_TEAM);
+    changed = true;
+  }
+  if (game.start != 0 && start == game.start && end != 0 && static_cast<int32_t>(end - start) > 0 &&
+    (game.end == 0 || HybridClock::before(end, endedBy, game.end, game.endedBy)))
+  {
+    game.end = end;
+    game.endedBy = endedBy;
+    game.winner = winner;
+    changed = true;
+  }
+  if (changed)
+    cb_rerender_gameplay();
+  return changed;
+}
+
+/**
+ * Gets whether our game is further on than someone else's
+ * @param start stamp of their game setup
+ * @param end stamp of their first win
+ * @param endedBy radio ID that made that win
+ * @return true if they should hear from us
+ */
+bool game_ahead(const millis_t start, const millis_t end, const radio_id endedBy)
+{
+  if (game.start == 0)
+    return false;
+  if (start == 0 || static_cast<int32_t>(game.start - start) > 0)
+    return true;
+  return game.start == start && game.end != 0 && (end == 0 || HybridClock::before(game.end, game.endedBy, end, endedBy));
+}
+
+/**
+ * Sends a digest of part of our node table and our game
+ * @param targets mask of radio IDs to send it to
+ * @param from radio ID of the first entry, DIGEST_SPAN of them go in
+ */
+void send_digest(const node_mask_t targets, const radio_id from)
+{
+  Packet digest = {
+    .opcode = OpCode::DIGEST,
+    .origin = config::getRadioID(),
+    .target = TARGET_NEIGHBOURS,
+    .ttl = 1,
+    .timestamp = netclock.now()
+  };
+  digest.from = from;
+  for (uint8_t i = 0; i < DIGEST_SPAN; ++i)
+    digest.digest[i] = from + i < MAX_NODES ? nodes.version(from + i) : 0;
+  digest.started = game.start;
+  digest.ended = game.end;
+  digest.endedBy = game.endedBy;
+  digest.winner = game.winner;
+  txqueue.multicast(digest, targets, DIGEST_DELAY);
+}
+
+#ifdef COORDINATOR
+/**
+ * Makes a claim out of a node's entry in our table, for passing it on
+ * @param node radio ID
+ * @return CLAIM from the node, stamped with the claim to the nearest tick
+ */
+Packet table_claim(const radio_id node)
+{
+  Packet claim = {
+    .opcode = OpCode::CLAIM,
+    .origin = node,
+    .target = TARGET_NEIGHBOURS,
+    .ttl = MAX_TTL,
+    .seq = 0,
+    .timestamp = nodes.claimed(node)
+  };
+  claim.team = nodes.team(node);
+  claim.player = 0; // only the tag screen shows it, nobody keeps it
+  claim.version = nodes.version(node);
+  return claim;
+}
+
+/**
+ * Adds our lease renewal to a frame that's going to a neighbour anyway, if they're due one
+ * @param target radio ID of the neighbour, with a packet just queued for them
+ */
+void lease_along(const radio_id target)
+{
+  if (!coordinator.owes(target))
+    return;
+  Packet lease = {
+    .opcode = OpCode::LEASE,
+    .origin = config::getRadioID(),
+    .target = target,
+    .ttl = 1,
+    .seq = 0,
+    .timestamp = netclock.now()
+  };
+  txqueue.send(lease, target);
+}
+#endif
+
+bool node_online(const radio_id node);
+void cb_channel_changed();
+
+/**
+ * Moves the whole network to another channel or radio profile
+ * Everyone switches at the same network time, far enough ahead for the announcement to reach them all
+ * @param channel channel to move to
+ * @param profile radio profile to move to
+ */
+void retune(const channel_t channel, const uint8_t profile)
+{
+  Packet packet = {
+    .opcode = OpCode::RETUNE,
+    .origin = config::getRadioID(),
+    .target = TARGET_NEIGHBOURS,
+    .ttl = MAX_TTL,
+    .seq = 0,
+    .timestamp = netclock.now()
+  };
+  packet.channel = channel;
+  packet.profile = profile;
+  packet.at = packet.timestamp + RETUNE_DELAY;
+
+  // not through reliable_broadcast, the gameplay screen only cares about game packets
+  reliable.add(packet, reachable(), millis(), true);
+  flood(packet);
+
+  nextChannel = channel;
+  nextProfile = profile;
+  retuneAt = packet.at;
+  retunePending = true;
+}
+
+/**
+ * Finds a quieter channel and moves everyone to it
+ * Only the reference does this, so two nodes seeing the same interference don't send everyone different ways
+ */
+void relocate()
+{
+  const channel_t channel = channels::quietest(radio, config::getChannel());
+  // the scan leaves the radio tuned wherever it finished
+  radio_start();
+  monitor.moved(millis());
+  if (channel != config::getChannel())
+    retune(channel, config::getProfile());
+}
+
+/**
+ * Answers a joining node with the lowest free radio ID and who's online
+ * @param nonce the joiner's nonce, from its JOIN
+ */
+void offer_id(const uint16_t nonce)
+{
+  const radio_id me = config::getRadioID();
+  const bool held = heldNonce != 0 && millis() - heldSince < OFFER_HOLD;
+
+  radio_id offer = NO_ROUTE;
+  node_mask_t members = 0;
+  for (uint8_t i = 0; i < MAX_NODES; ++i)
+  {
+    if (node_online(i))
+      members |= static_cast<node_mask_t>(1) << i;
+    // skip the one held for someone else
+    else if (offer == NO_ROUTE && !(held && heldNonce != nonce && heldID == i))
+      offer = i;
+  }
+  if (offer == NO_ROUTE)
+    return;
+
+  joinOffer.nonce = nonce;
+  joinOffer.id = offer;
+  joinOffer.members = members;
+  #ifdef FRAME_AUTH
+  // whoever takes it has to start past the counters the last box with it used
+  joinOffer.epoch = auth.lastEpoch(offer);
+  #else
+  joinOffer.epoch = 0;
+  #endif
+  joinOffer.due = millis() + me * OFFER_STAGGER;
+  joinOffer.pending = true;
+  if (!held)
+  {
+    heldNonce = nonce;
+    heldID = offer;
+    heldSince = millis();
+  }
+}
+
+// packet handlers, one per opcode, see handlers[] below
+// packets are views straight into the received frame, only the fields for their opcode are there
+
+void handle_ping(Packet& packet, const radio_id source)
+{
+  // craft a pong packet back, stamp_frame() brings it up to date as it goes
+  const millis_t local = millis();
+  Packet pong = {
+    .opcode = OpCode::PONG,
+    .origin = config::getRadioID(),
+    .target = source,
+    .ttl = 1,
+    .timestamp = netclock.time(local)
+  };
+  pong.echo = packet.echo;
+  pong.stratum = netclock.getStratum();
+  pong.local = local;
+  pong.drift = netclock.getDrift();
+  txqueue.send(pong, source);
+  #ifdef COORDINATOR
+  lease_along(source);
+  #endif
+}
+
+void handle_pong(Packet& packet, const radio_id source)
+{
+  const millis_t now = millis();
+  #ifdef DIAGNOSTICS
+  stats.roundTrip(source, now - packet.echo);
+  #endif
+  pings.answered(source, now);
+  #ifdef DUTY_CYCLE
+  const millis_t was = netclock.time(now);
+  #endif
+  netclock.sample(source, packet.stratum, packet.echo, packet.timestamp, packet.local, packet.drift, now);
+  #ifdef DUTY_CYCLE
+  // if that moved our windows, onto another reference's time say, nobody is in step with them until they show it
+  const int32_t moved = static_cast<int32_t>(netclock.time(now) - was);
+  if (moved > static_cast<int32_t>(duty::GUARD) || -moved > static_cast<int32_t>(duty::GUARD))
+    inStep = 0;
+  // their windows only line up with ours if they've got network time and it agrees with ours, to within the
+  // guard plus however much of the round trip might have been either way
+  const millis_t rtt = now - packet.echo;
+  const int32_t skew = static_cast<int32_t>(packet.timestamp + rtt / 2 - netclock.now());
+  const int32_t slack = duty::GUARD + rtt / 2;
+  if (packet.stratum != ClockSync::UNSYNCED && skew <= slack && -skew <= slack)
+    inStep |= static_cast<node_mask_t>(1) << source;
+  else
+    inStep &= ~(static_cast<node_mask_t>(1) << source);
+  #endif
+}
+
+void handle_graph_request(Packet& packet, const radio_id source)
+{
+  Packet graph = {
+    .opcode = OpCode::GRAPH,
+    .origin = config::getRadioID(),
+    .target = source,
+    .ttl = 1,
+    .timestamp = netclock.now()
+  };
+  // the first row we have newer than theirs, and whatever follows it in a page
+  for (uint8_t j = 0; j < GRAPH_SPAN && packet.window + j < MAX_NODES; ++j)
+  {
+    const radio_id first = packet.window + j;
+    if (!newer(routing.version(first), packet.known[j]))
+      continue;
+    graph.first = first;
+    routing.copy(first, GRAPH_ROWS, graph.versions, graph.rows);
+    txqueue.send(graph, source, GRAPH_DELAY);
+    return;
+  }
+}
+
+void handle_graph(Packet& packet, const radio_id source)
+{
+  routing.merge(packet.first, GRAPH_ROWS, packet.versions, packet.rows);
+  // they had something newer so there's likely more, ask about the rows after it again soon
+  graphWindow = packet.first + GRAPH_ROWS < MAX_NODES ? packet.first + GRAPH_ROWS : 0;
+  lastGraph = millis() - GRAPH_INTERVAL + GRAPH_CATCH_UP;
+}
+
+void handle_game_setup(Packet& packet, const radio_id source)
+{
+  if (merge_game(packet.timestamp, 0, 0, NO_TEAM))
+  {
+    game.nodes = packet.nodes;
+    game.teams = packet.teams;
+  }
+}
+
+void handle_claim(Packet& packet, const radio_id source)
+{
+  const bool fresh = packet.origin < MAX_NODES && newer(packet.version, nodes.version(packet.origin));
+  // a version we haven't seen is the first copy, reliable ones (wins) are passed on when they come in
+  const bool first = FLOOD_CLAIMS && packet.seq == 0 && packet.target == TARGET_NEIGHBOURS && fresh;
+  merge_state(packet.origin, packet.team, packet.version, packet.timestamp);
+  if (first)
+    flood(packet, source);
+  #ifdef COORDINATOR
+  // handed to us to pass on, a win goes to everyone itself
+  if (fresh && packet.opcode == OpCode::CLAIM && packet.target == config::getRadioID() &&
+    coordinator.current(millis()) == config::getRadioID())
+    coordinator.changed(packet.origin, millis());
+  #endif
+}
+
+void handle_win(Packet& packet, const radio_id source)
+{
+  handle_claim(packet, source);
+  merge_game(game.start, packet.timestamp, packet.origin, packet.team);
+}
+
+void handle_digest(Packet& packet, const radio_id source)
+{
+  // the game comes first, a new one resets the table we're about to compare
+  merge_game(packet.started, packet.ended, packet.endedBy, packet.winner);
+
+  // push them anything we have newer, and if they have anything newer let them know what we've got
+  bool behind = game_ahead(packet.started, packet.ended, packet.endedBy);
+  for (uint8_t j = 0; j < DIGEST_SPAN && packet.from + j < MAX_NODES; ++j)
+  {
+    const radio_id i = packet.from + j;
+    const version_t version = nodes.version(i);
+    if (newer(packet.digest[j], version))
+    {
+      behind = true;
+      continue;
+    }
+    if (!newer(version, packet.digest[j]))
+      continue;
+
+    Packet state = {
+      .opcode = OpCode::STATE,
+      .origin = config::getRadioID(),
+      .target = source,
+      .ttl = 1,
+      .timestamp = netclock.now()
+    };
+    state.team = nodes.team(i);
+    state.version = version;
+    state.node = i;
+    state.claimed = nodes.claimed(i);
+    txqueue.send(state, source, STATE_DELAY);
+  }
+  // about the same entries, so they push back what we're missing of them
+  if (behind)
+    send_digest(static_cast<node_mask_t>(1) << source, packet.from);
+}
+
+void handle_state(Packet& packet, const radio_id source)
+{
+  merge_state(packet.node, packet.team, packet.version, packet.claimed);
+}
+
+void handle_ack(Packet& packet, const radio_id source)
+{
+  reliable.ack(packet.origin, packet.seq);
+}
+
+void handle_join(Packet& packet, const radio_id source)
+{
+  offer_id(packet.nonce);
+}
+
+void handle_interference(Packet& packet, const radio_id source)
+{
+  if (reference() == config::getRadioID() && monitor.settled(millis()))
+    relocatePending = true;
+}
+
+void handle_retune(Packet& packet, const radio_id source)
+{
+  if (packet.channel > channels::MAX_CHANNEL || packet.profile >= profiles::COUNT)
+    return;
+  nextChannel = packet.channel;
+  nextProfile = packet.profile;
+  retuneAt = packet.at;
+  retunePending = true;
+}
+
+void handle_link(Packet& packet, const radio_id source)
+{
+  links.report(packet.origin, packet.quality, millis());
+}
+
+#ifdef COORDINATOR
+void handle_lease(Packet& packet, const radio_id source)
+{
+  coordinator.leased(packet.origin, millis());
+}
+#endif
+
+#ifdef DIAGNOSTICS
+typedef HandlerTimings<OPCODE_COUNT> PacketTimings;
+#else
+typedef Untimed PacketTimings;
+#endif
+typedef Dispatcher<OPCODE_COUNT, PacketTimings, Packet&, const radio_id> PacketDispatcher;
+const PacketDispatcher::handler_t handlers[] PROGMEM = {
+  handle_ping,          // PING
+  handle_pong,          // PONG
+  handle_graph_request, // GRAPH_REQUEST
+  handle_graph,         // GRAPH
+  handle_game_setup,    // GAME_SETUP
+  handle_claim,         // CLAIM
+  handle_win,           // WIN
+  handle_digest,        // DIGEST
+  handle_state,         // STATE
+  handle_ack,           // ACK
+  handle_join,          // JOIN
+  nullptr,              // OFFER, only a joining node listens for these, see join()
+  handle_interference,  // INTERFERENCE
+  handle_retune,        // RETUNE
+  handle_link,          // LINK
+  #ifdef COORDINATOR
+  handle_lease          // LEASE
+  #else
+  nullptr               // LEASE, nobody's coordinating
+  #endif
+};
+static_assert(sizeof(handlers) / sizeof(handlers[0]) == OPCODE_COUNT, "every opcode needs an entry in handlers");
+PacketDispatcher dispatcher(handlers);
+
+/**
+ * Handles a single packet out of a frame
+ * @param packet packet to handle
+ * @param source radio ID of the frame's sender
+ */
+void receive(Packet& packet, const radio_id source)
+{
+  const radio_id me = config::getRadioID();
+
+  // joining nodes don't have an ID yet, so nothing below applies to them
+  if (packet.opcode == OpCode::JOIN)
+  {
+    dispatcher.dispatch(static_cast<uint8_t>(packet.opcode), packet, source);
+    return;
+  }
+
+  // everything else is indexed by radio ID, anything out of range is noise or another network
+  if (source >= MAX_NODES || packet.origin >= MAX_NODES)
+    return;
+
+  // anything from a node, even passing through, shows it's still up
+  detector.heard(packet.origin, millis());
+
+  if (packet.target != me && packet.target != TARGET_NEIGHBOURS)
+  {
+    relay(packet, source);
+    return;
+  }
+
+  // acknowledge every copy of a reliable packet, our last ACK might have been lost, but only act on it once
+  if (packet.seq != 0 && packet.opcode != OpCode::ACK)
+  {
+    Packet ack = {
+      .opcode = OpCode::ACK,
+      .origin = me,
+      .target = packet.origin,
+      .ttl = MAX_TTL,
+      .seq = packet.seq,
+      .timestamp = netclock.now()
+    };
+    unicast(ack, packet.origin, ACK_DELAY);
+    if (!reliable.fresh(packet))
+    {
+      #ifdef DIAGNOSTICS
+      stats.duplicate(packet.origin);
+      #endif
+      return;
+    }
+    // reliable broadcasts are flooded, resends go along the route to the one that missed it
+    if (packet.target == TARGET_NEIGHBOURS)
+      flood(packet, source);
+  }
+
+  dispatcher.dispatch(static_cast<uint8_t>(packet.opcode), packet, source);
+}
+
+/**
+ * Sends a frame straight out without an ACK, past the queue, for the join handshake
+ * @param target radio ID to send it to
+ * @param frame frame with room for MAX_FRAME_SIZE bytes, sealed in place if frames are authenticated
+ * @param length bytes in the frame
+ */
+void send_unqueued(const radio_id target, uint8_t* frame, const uint8_t length)
+{
+  #ifdef FRAME_AUTH
+  const uint8_t size = auth.seal(frame, length);
+  #else
+  const uint8_t size = length;
+  #endif
+  #ifdef CAPTURE
+  recorder.sent(target, frame, size);
+  #endif
+  radio.send(target, frame, size, NRFLite::NO_ACK);
+}
+
+#ifdef DUTY_CYCLE
+/**
+ * Checks if we have to stay up whatever the time
+ * Until our clock is synced we've no idea when the windows are, and a neighbour whose clock doesn't agree with
+ * ours, still settling or following some other reference, won't find them, so we stay up until everyone around
+ * us is in step. On our own there's nobody to agree the windows with, and we have to hear whoever turns up
+ * whenever they do
+ * @return true to ignore the wake windows
+ */
+inline bool sleepless()
+{
+  const node_mask_t neighbours = routing.neighbours();
+  return neighbours == 0 || (neighbours & ~inStep) != 0 || netclock.getStratum() == ClockSync::UNSYNCED;
+}
+#endif
+
+void network()
+{
+  const radio_id me = config::getRadioID();
+
+  // push along anything waiting to go out
+  #ifdef TDMA
+  TxWindow window = tdma::window(netclock.now(), me);
+  #else
+  TxWindow window = TxWindow::OPEN;
+  #endif
+  #ifdef DUTY_CYCLE
+  // outside the wake window everything waits for the next one, claims included
+  // staying up for a neighbour whose clock is out, they're awake too, so answer their pings to bring them in
+  // shared is whether the others are up to hear us, whether or not we are
+  bool shared = !radioAsleep;
+  if (radioAsleep)
+    window = TxWindow::CLOSED;
+  else if (netclock.getStratum() != ClockSync::UNSYNCED)
+  {
+    const millis_t time = netclock.now();
+    #ifndef TDMA
+    // the slots already keep everyone apart under TDMA
+    if (time / duty::PERIOD != wakePeriod)
+    {
+      wakePeriod = time / duty::PERIOD;
+      wakeStart = random(duty::SPREAD + 1);
+    }
+    #endif
+    const TxWindow wake = duty::window(time, wakeStart);
+    shared = wake != TxWindow::CLOSED;
+    if (wake == TxWindow::CLOSED)
+      window = sleepless() ? TxWindow::URGENT : TxWindow::CLOSED;
+    else if (wake < window)
+      window = wake;
+  }
+  // a neighbour that went quiet has to show it's in step again when it's back
+  inStep &= routing.neighbours();
+  #endif
+  txqueue.update(window);
+
+  // handle any incoming
+  uint8_t length;
+  // packets are handled in place, the slack means even a whole Packet at the end of a frame stays in bounds
+  uint8_t frame[MAX_FRAME_SIZE + sizeof(Packet)];
+  #ifdef RADIO_IRQ
+  // an edge can go missing while the interrupt is detached, the line then stays low until someone reads the radio
+  // and frames left in the radio by a full ring don't raise another
+  if (rxWaiting || digitalRead(PIN_RADIO_IRQ) == LOW)
+  {
+    noInterrupts();
+    rxWaiting = false;
+    radio_interrupt();
+    interrupts();
+  }
+  while ((length = rxring.pop(frame)) > 0)
+  {
+  #else
+  // the radio can't listen while it's mid send
+  while (!txqueue.busy() && (length = radio.hasData()) > 0)
+  {
+    radio.readData(frame);
+  #endif
+
+    #ifdef CAPTURE
+    recorder.received(frame, length);
+    #endif
+
+    #ifdef FRAME_AUTH
+    // anything that doesn't check out never happened, not even as a sign of life
+    length = auth.open(frame, length);
+    if (length == 0)
+      continue;
+    #endif
+
+    // we heard it, so whoever sent it is in range
+    const radio_id source = frame[0];
+    routing.heard(source, millis());
+    detector.heard(source, millis());
+    #ifdef DIAGNOSTICS
+    // joiners and noise don't get to take a peer's slot
+    if (source < MAX_NODES)
+      stats.received(source);
+    #endif
+
+    // unpack the packets, stopping at anything we don't understand
+    uint8_t offset = FRAME_HEADER_SIZE;
+    while (offset < length)
+    {
+      uint8_t size;
+      Packet* packet = packet_decode(frame + offset, length - offset, size);
+      if (packet == nullptr)
+        break;
+
+      receive(*packet, source);
+      offset += size;
+    }
+  }
+
+  // no ACK, the joiner keeps probing until it hears an offer
+  if (joinOffer.pending && !txqueue.busy() && window != TxWindow::CLOSED && static_cast<int32_t>(millis() - joinOffer.due) >= 0)
+  {
+    Packet offer = {
+      .opcode = OpCode::OFFER,
+      .origin = me,
+      .target = JOIN_ID,
+      .ttl = 1,
+      .seq = 0,
+      .timestamp = netclock.now()
+    };
+    offer.nonce = joinOffer.nonce;
+    offer.offer = joinOffer.id;
+    offer.members = joinOffer.members;
+    offer.epoch = joinOffer.epoch;
+    frame[0] = me;
+    const uint8_t size = packet_encode(offer, frame + FRAME_HEADER_SIZE);
+    #ifdef RADIO_IRQ
+    radio_irq_pause();
+    #endif
+    send_unqueued(JOIN_ID, frame, FRAME_HEADER_SIZE + size);
+    #ifdef RADIO_IRQ
+    radio_irq_resume();
+    #endif
+    joinOffer.pending = false;
+  }
+
+  reliable.update(millis(), resend);
+
+  // retune with everyone else, once nothing is mid send
+  if (retunePending && !txqueue.busy() && static_cast<int32_t>(netclock.now() - retuneAt) >= 0)
+  {
+    retunePending = false;
+    if (nextChannel != config::getChannel())
+    {
+      config::setChannel(nextChannel);
+      cb_channel_changed();
+    }
+    if (nextProfile != config::getProfile())
+    {
+      config::setProfile(nextProfile);
+      links.init(millis());
+    }
+    radio_start();
+    monitor.moved(millis());
+  }
+
+  if (relocatePending && !txqueue.busy())
+  {
+    relocatePending = false;
+    relocate();
+  }
+
+  // too many sends failing, find somewhere quieter or tell the reference to
+  if (monitor.interference(millis()))
+  {
+    const radio_id ref = reference();
+    if (ref == me)
+      relocatePending = true;
+    else
+    {
+      Packet packet = {
+        .opcode = OpCode::INTERFERENCE,
+        .origin = me,
+        .target = ref,
+        .ttl = MAX_TTL,
+        .seq = 0,
+        .timestamp = netclock.now()
+      };
+      unicast(packet, ref);
+    }
+  }
+
+  // the lowest radio ID we can reach is the reference clock
+  if (reference() == me)
+    netclock.lead(millis());
+  else
+    netclock.resign();
+  netclock.expire(millis());
+
+  // see who's gone quiet
+  if (detector.update(millis()))
+    cb_rerender_gameplay();
+
+  // work out who we have direct access to, and ask them for anything newer in their view of the network
+  routing.expire(millis());
+  if (lastGraph == 0 || millis() - lastGraph > GRAPH_INTERVAL)
+  {
+    lastGraph = millis();
+    Packet packet = {
+      .opcode = OpCode::GRAPH_REQUEST,
+      .origin = me,
+      .target = TARGET_NEIGHBOURS,
+      .ttl = 1,
+      .timestamp = netclock.now()
+    };
+    packet.window = graphWindow;
+    for (uint8_t j = 0; j < GRAPH_SPAN; ++j)
+      packet.known[j] = graphWindow + j < MAX_NODES ? routing.version(graphWindow + j) : 0;
+    // the auto-ACKs fill in the neighbour table, the replies fill in the rest
+    // only to who we've heard or might, IDs that have stopped answering pings are left to the ping backoff, and
+    // past 8 nodes ones we've yet to hear only get asked once round the windows
+    const node_mask_t targets = graphWindow == 0 ? routing.neighbours() | pings.present() : routing.neighbours();
+    // in case nobody has anything newer
+    graphWindow = graphWindow + GRAPH_SPAN < MAX_NODES ? graphWindow + GRAPH_SPAN : 0;
+    txqueue.multicast(packet, targets, GRAPH_DELAY);
+  }
+
+  // swap digests with a neighbour so anyone who missed a claim or the game setup catches up, see gossip.h
+  if (millis() - lastDigest > Gossip<MAX_NODES>::INTERVAL)
+  {
+    lastDigest = millis();
+    const radio_id peer = gossip.next(routing.neighbours());
+    if (peer != NO_ROUTE)
+      send_digest(static_cast<node_mask_t>(1) << peer, gossip.page(DIGEST_PAGES) * DIGEST_SPAN);
+  }
+
+  #ifdef COORDINATOR
+  // hold on to the lease if it's ours, and pass on the claims that have come in
+  Coordinator<MAX_NODES>::Set late;
+  if (coordinator.update(millis(), detector.alive(), late))
+  {
+    Packet lease = {
+      .opcode = OpCode::LEASE,
+      .timestamp = netclock.now()
+    };
+    // one each, these are the ones no ping or pong has taken it to
+    for (radio_id i = 0; i < MAX_NODES; ++i)
+    {
+      if (late.test(i))
+        unicast(lease, i, LEASE_DELAY);
+    }
+  }
+  Coordinator<MAX_NODES>::Set claimed;
+  if (coordinator.flush(millis(), claimed))
+  {
+    // a claim on its own leaves out whoever made it, several go to everyone so they share frames
+    const bool alone = claimed.count() == 1;
+    for (radio_id i = 0; i < MAX_NODES; ++i)
+    {
+      if (!claimed.test(i))
+        continue;
+      Packet claim = table_claim(i);
+      // past 8 radio IDs they go along the tree like anyone's own, see broadcast()
+      if (FLOOD_CLAIMS)
+        flood(claim);
+      else
+        fan_out(claim, alone ? i : NO_ROUTE);
+    }
+  }
+  // the coordinator went before it acknowledged our claim, so it's up to us
+  if (coordinator.orphaned(millis()))
+  {
+    Packet claim = table_claim(me);
+    broadcast(claim);
+  }
+  #endif
+
+  // tell the reference how our worst link is doing, the reference decides the profile for everyone
+  const millis_t LINK_INTERVAL = 10000;
+  if (millis() - lastLink > LINK_INTERVAL)
+  {
+    lastLink = millis();
+    const radio_id ref = reference();
+    if (ref != me)
+    {
+      Packet packet = {
+        .opcode = OpCode::LINK,
+        .origin = me,
+        .target = ref,
+        .ttl = MAX_TTL,
+        .seq = 0,
+        .timestamp = netclock.now()
+      };
+      packet.quality = links.worst(routing.neighbours());
+      unicast(packet, ref, LINK_DELAY);
+    }
+    else if (!retunePending)
+    {
+      const uint8_t profile = links.choose(config::getProfile(), routing.neighbours(), millis());
+      if (profile != config::getProfile())
+        retune(config::getChannel(), profile);
+    }
+  }
+
+  // ping whoever is most overdue, at most one a pass so they never go out in a burst
+  // the pongs keep the clock in sync and tell us who's still about
+  #ifdef TDMA
+  // only ping in the contention slot, so the pong can come straight back in the same one
+  bool pinging = window == TxWindow::URGENT;
+  #else
+  bool pinging = window == TxWindow::OPEN;
+  #endif
+  #ifdef DUTY_CYCLE
+  // and only when whoever it's for is awake
+  pinging = pinging && shared;
+  #endif
+  const radio_id ping = pinging ? pings.due(millis()) : NO_PING;
+  if (ping != NO_PING)
+  {
+    Packet packet = {
+      .opcode = OpCode::PING,
+      .origin = me,
+      .target = ping,
+      .ttl = 1,
+      .timestamp = netclock.now()
+    };
+    packet.echo = millis();
+    txqueue.send(packet, ping);
+    #ifdef COORDINATOR
+    lease_along(ping);
+    #endif
+  }
+
+  #ifdef DUTY_CYCLE
+  // a group that came up with its windows out of step with ours only hears us in the discovery period, for
+  // however much of it overlaps theirs, and our backed off pings hardly ever land in it. So every so often
+  // through it we ping everyone who isn't a neighbour, without ACKs like join() does so empty IDs cost nothing
+  if (netclock.getStratum() != ClockSync::UNSYNCED && duty::discovering(netclock.now()) && !txqueue.busy() &&
+    millis() - lastSweep >= duty::SWEEP)
   {
-    if (i == me)
-      continue;
-    if (i == packet.source)
-      continue;
-    radio.send(i, &packet, sizeof(packet));
+    lastSweep = millis();
+    Packet packet = {
+      .opcode = OpCode::PING,
+      .origin = me,
+      .target = 0,
+      .ttl = 1,
+      .timestamp = netclock.now()
+    };
+    packet.echo = millis();
+    const node_mask_t neighbours = routing.neighbours();
+    uint8_t frame[MAX_FRAME_SIZE];
+    frame[0] = me;
+    #ifdef RADIO_IRQ
+    radio_irq_pause();
+    #endif
+    for (radio_id i = 0; i < MAX_NODES; ++i)
+    {
+      if (i == me || (neighbours & (static_cast<node_mask_t>(1) << i)))
+        continue;
+      packet.target = i;
+      send_unqueued(i, frame, FRAME_HEADER_SIZE + packet_encode(packet, frame + FRAME_HEADER_SIZE));
+    }
+    #ifdef RADIO_IRQ
+    radio_irq_resume();
+    #endif
   }
+  #endif
 }
 
 /**
- * Broadcasts a packet to all radios
- * @param packet packet to broadcast
+ * Finds a network on a channel and gets a free radio ID from it
+ * Probes every radio ID without waiting for ACKs, so a sweep takes a couple of milliseconds. Anyone that hears a
+ * probe answers with the lowest ID nobody is using and who's online
+ * The radio is left on JOIN_ID, radio_init() puts it back
+ * @param channel channel to look on
+ * @param profile radio profile to look with
+ * @param members filled in with who's online
+ * @param neighbour filled in with the radio ID that answered
+ * @return the radio ID we've been offered, or NO_ROUTE if nobody answered
  */
-void broadcast(Packet& packet)
+radio_id join(const channel_t channel, const uint8_t profile, node_mask_t& members, radio_id& neighbour)
 {
-  const radio_id me = config::getRadioID();
-  for (uint8_t i = 0; i < MAX_NODES; ++i)
-  {
-    if (i == me)
-      continue;
-    radio.send(i, &packet, sizeof(packet));
-  }
-}
+  const millis_t JOIN_TIMEOUT = 2000;
+  const millis_t PROBE_INTERVAL = 100;
 
+  #ifdef RADIO_IRQ
+  // this polls the radio itself, radio_init() brings the interrupt back
+  radio_irq_pause();
+  #endif
 
-void cb_rerender_gameplay();
-
-void network()
-{
-  // handle any incoming
-  while (radio.hasData())
-  {
-    Packet packet;
-    radio.readData(&packet);
+  if (!radio.init(JOIN_ID, PIN_RADIO_CE, PIN_RADIO_SELECT, profiles::bitrate(profile), channel))
+    return NO_ROUTE;
 
+  // boxes all boot with the same random sequence, when the button was pressed is a better seed
+  randomSeed(micros());
+  #ifdef CAPTURE
+  capture_start(JOIN_ID, channel, profile);
+  #endif
+  Packet probe = {
+    .opcode = OpCode::JOIN,
+    .origin = JOIN_ID,
+    .target = TARGET_NEIGHBOURS,
+    .ttl = 1,
+    .seq = 0,
+    .timestamp = 0
+  };
+  probe.nonce = random(1, UINT16_MAX);
 
-    // Serial.print("PACKET: opcode; ");
-    // Serial.print(static_cast<uint8_t>(packet.opcode));
-    // Serial.print(", source; ");
-    // Serial.println(packet.source);
-    // Serial.print(", target; ");
-    // Serial.println(packet.target);
+  uint8_t frame[MAX_FRAME_SIZE];
+  frame[0] = JOIN_ID;
+  const uint8_t size = packet_encode(probe, frame + FRAME_HEADER_SIZE);
 
-/*
-    const bool relay = packet.opcode != OpCode::PING || packet.opcode != OpCode::PONG;
-    if (relay && packet.target != config::getRadioID())
+  const millis_t start = millis();
+  millis_t lastProbe = start - PROBE_INTERVAL;
+  while (millis() - start < JOIN_TIMEOUT)
+  {
+    #ifdef CAPTURE
+    // this is a loop of its own as far as the capture goes
+    recorder.loop(micros());
+    #endif
+    if (millis() - lastProbe >= PROBE_INTERVAL)
     {
-      relay(packet);
-      continue;
+      lastProbe = millis();
+      for (radio_id i = 0; i < MAX_NODES; ++i)
+        send_unqueued(i, frame, FRAME_HEADER_SIZE + size);
     }
-*/
 
-    if (nodes[packet.source].lastUpdate < packet.timestamp)
-      nodes[packet.source].lastUpdate = packet.timestamp;
+    uint8_t length = radio.hasData();
+    if (length == 0)
+      continue;
 
-    switch (packet.opcode)
+    uint8_t reply[MAX_FRAME_SIZE + sizeof(Packet)];
+    radio.readData(reply);
+    #ifdef CAPTURE
+    recorder.received(reply, length);
+    #endif
+    #ifdef FRAME_AUTH
+    length = auth.open(reply, length);
+    if (length == 0)
+      continue;
+    #endif
+    uint8_t offset = FRAME_HEADER_SIZE;
+    while (offset < length)
     {
-      case OpCode::PING:
-      {
-        // craft a pong packet back
-        Packet pong = {
-          .opcode = OpCode::PONG,
-          .source = config::getRadioID(),
-          // .target = packet.source,
-          .timestamp = packet.timestamp
-        };
-        radio.send(packet.source, &pong, sizeof(pong));
-      }
-      break;
-      case OpCode::PONG:
-        nodes[packet.source].latency = millis() - packet.timestamp;
-      break;
-      case OpCode::GAME_SETUP:
-        game.start = millis() - nodes[packet.source].latency;
-        game.nodes = packet.nodes;
-        game.teams = packet.teams;
+      uint8_t packetSize;
+      const Packet* packet = packet_decode(reply + offset, length - offset, packetSize);
+      if (packet == nullptr)
+        break;
 
-        for (uint8_t i = 0; i < MAX_NODES; ++i)
-          nodes[i].team = NO_TEAM;
-      break;
-      case OpCode::WIN:
-        game.end = millis() - packet.timestamp;
-      // fallthrough
-      case OpCode::CLAIM:
-        nodes[packet.source].team = packet.team;
-        cb_rerender_gameplay();
-      break;
-      default:
-        // Serial.print("Unhandled packet type: ");
-        // Serial.println(static_cast<uint8_t>(packet.opcode));
-      break;
-    }
-  }
+      offset += packetSize;
+      if (packet->opcode != OpCode::OFFER || packet->nonce != probe.nonce || packet->offer >= MAX_NODES)
+        continue;
 
-  const millis_t PING_INTERVAL = 1000;
-  // ping any potential nodes
-  for (uint8_t i = 0; i < MAX_NODES; ++i)
-  {
-    if (i == config::getRadioID())
-      continue;
-    if (nodes[i].lastPing + PING_INTERVAL > millis())
-      continue;
-    nodes[i].lastPing = millis();
-    Packet packet = {
-      .opcode = OpCode::PING,
-      .source = config::getRadioID(),
-      // .target = i,
-      .timestamp = millis()
-    };
-    // Serial.print("PING: ");
-    // Serial.print(i);
-    // Serial.print(", ");
-    // Serial.println(radio.send(i, &packet, sizeof(packet)));
+      members = packet->members;
+      neighbour = reply[0];
+      #ifdef FRAME_AUTH
+      auth.passEpoch(packet->epoch);
+      #endif
+      return packet->offer;
+    }
   }
+  return NO_ROUTE;
 }
 
+/**
+ * Checks whether a node is still in the game
+ * Suspected nodes still count, a node shouldn't drop out over a few missed packets
+ * @param node radio ID
+ * @return true if it's us or we've heard from it recently enough
+ */
 bool node_online(const radio_id node)
 {
   if (node == config::getRadioID())
     return true;
 
-  return nodes[node].lastUpdate > 0;
+  return detector.state(node) != Liveness::DEAD;
+}
+
+/**
+ * Gets every node still in the game, us and everyone the detector hasn't given up on
+ * @return set of radio IDs
+ */
+NodeTable<MAX_NODES, MAX_TEAMS>::Set online()
+{
+  NodeTable<MAX_NODES, MAX_TEAMS>::Set set = detector.alive();
+  set.set(config::getRadioID());
+  return set;
 }
 
 uint8_t nodes_online()
 {
-  uint8_t c = 0;
-  for (uint8_t i = 0; i < MAX_NODES; ++i)
-  {
-    if (nodes[i].lastUpdate > 0)
-      ++c;
-  }
-  return c + 1;
+  return online().count();
 }
 
 
 /**
  * Returns the winning team if there is one, or NO_TEAM
- * @return winning team ID or NO_TEAM
+ * @return the team that owns every online node, or NO_TEAM
  */
 team_id win()
 {
-  team_id team = NO_TEAM;
-  for (uint8_t i = 0; i < MAX_NODES; ++i)
-  {
-    // offline node
-    if (!node_online(i))
-      continue;
-
-    if (team == NO_TEAM)
-      team = nodes[i].team;
-    else if (team != nodes[i].team)
-      return NO_TEAM;
-  }
-  return team;
+  return nodes.winner(online());
 }
 
 const uint8_t brightness = 31;
@@ -329,17 +1827,10 @@ protected:
   bool redraw;
 };
 
-void cb_go_screen(Screen* screen);
 class Button : public Component
 {
 public:
-  static inline Button gotoScreen(int8_t _x, int8_t _y, int8_t w, int8_t h, const char* str, Screen* _screen)
-  {
-    Button button = Button(_x, _y, w, h, str);
-    button.screen = _screen;
-    return button;
-  }
-  Button(int8_t _x, int8_t _y, int8_t w, int8_t h, const char* str, callback_t cb = nullptr) : Component(), x(_x), y(_y), width(w), height(h), label(str), callback(cb)
+  Button(int8_t _x, int8_t _y, int8_t w, int8_t h, const __FlashStringHelper* str, callback_t cb = nullptr) : Component(), x(_x), y(_y), width(w), height(h), label(str), callback(cb)
   {
   }
 
@@ -355,34 +1846,35 @@ public:
 
     tft.drawRect(x, y, width, height, focus ? FOCUS_COLOUR : BORDER_COLOUR);
     tft.fillRect(x+1, y+1, width-2, height-2, BACKGROUND_COLOUR);
-    tft.getTextBounds(const_cast<char*>(label), 0, 0, &x1, &y1, &x2, &y2);
+    char text[strlen_P(reinterpret_cast<PGM_P>(label)) + 1];
+    strcpy_P(text, reinterpret_cast<PGM_P>(label));
+    tft.getTextBounds(text, 0, 0, &x1, &y1, &x2, &y2);
     tft.setCursor(x + (width - x2) / 2, y + (height - y2) / 2);
     tft.setTextColor(LABEL_COLOUR);
     tft.setTextSize(1);
-    tft.print(label);
+    tft.print(text);
 
     redraw = false;
   }
 
-  inline virtual bool selectable() const { return screen || callback; }
+  inline virtual bool selectable() const { return callback != nullptr; }
 
   virtual void select()
   {
-    screen ? cb_go_screen(screen) : callback();
+    callback();
   }
 
 protected:
   uint8_t x, y, width, height;
-  const char* label;
+  const __FlashStringHelper* label; // in flash
   callback_t callback;
-  Screen* screen;
 };
 
 
 class Toggle : public Component
 {
 public:
-  Toggle(int8_t _x, int8_t _y, int8_t w, int8_t h, const char* str) : Component(), x(_x), y(_y), width(w), height(h), label(str), state(false)
+  Toggle(int8_t _x, int8_t _y, int8_t w, int8_t h, const __FlashStringHelper* str) : Component(), x(_x), y(_y), width(w), height(h), label(str), state(false)
   {
   }
 
@@ -399,11 +1891,13 @@ public:
 
     tft.drawRect(x, y, width, height, focus ? FOCUS_COLOUR : BORDER_COLOUR);
     tft.fillRect(x+1, y+1, width-2, height-2, state ? SELECT_COLOUR : BACKGROUND_COLOUR);
-    tft.getTextBounds(const_cast<char*>(label), 0, 0, &x1, &y1, &w, &h);
+    char text[strlen_P(reinterpret_cast<PGM_P>(label)) + 1];
+    strcpy_P(text, reinterpret_cast<PGM_P>(label));
+    tft.getTextBounds(text, 0, 0, &x1, &y1, &w, &h);
     tft.setCursor(x + (width - w) / 2, y + (height - h) / 2);
     tft.setTextColor(LABEL_COLOUR);
     tft.setTextSize(1);
-    tft.print(label);
+    tft.print(text);
 
     redraw = false;
   }
@@ -418,7 +1912,7 @@ public:
   }
 protected:
   uint8_t x, y, width, height;
-  const char* label;
+  const __FlashStringHelper* label; // in flash
   bool state;
 };
 
@@ -431,7 +1925,7 @@ public:
     LEFT
   };
 
-  Label(int8_t _x, int8_t _y, int8_t w, int8_t h, const char* str) : Component(), x(_x), y(_y), width(w), height(h),
+  Label(int8_t _x, int8_t _y, int8_t w, int8_t h, const __FlashStringHelper* str) : Component(), x(_x), y(_y), width(w), height(h),
   background(COLOUR_BLACK), border(colour(63, 127, 255)), textColour(COLOUR_WHITE), alignment(Alignment::CENTER), label(str)
   {
 
@@ -443,6 +1937,8 @@ public:
 
     int16_t x1, y1;
     uint16_t w, h;
+    char text[strlen_P(reinterpret_cast<PGM_P>(label)) + 1];
+    strcpy_P(text, reinterpret_cast<PGM_P>(label));
 
     tft.drawRect(x, y, width, height, border);
     tft.fillRect(x+1, y+1, width-2, height-2, background);
@@ -452,12 +1948,12 @@ public:
 
     if (alignment == Alignment::CENTER)
     {
-      tft.getTextBounds(const_cast<char*>(label), 160 - width, 0, &x1, &y1, &w, &h);
+      tft.getTextBounds(text, 160 - width, 0, &x1, &y1, &w, &h);
       tft.setCursor(x + (width - w) / 2, y + (height - h) / 2);
     }
     else
     {
-      tft.getTextBounds(const_cast<char*>(label), 160 - width, 0, &x1, &y1, &w, &h);
+      tft.getTextBounds(text, 160 - width, 0, &x1, &y1, &w, &h);
       tft.setCursor(x + 2, y + (height - h) / 2);
     }
 
@@ -469,25 +1965,25 @@ public:
       size_t offset = 0;
       uint8_t lines = 0;
 
-      while (pos < strlen(label))
+      while (pos < strlen(text))
       {
-        while (pos < strlen(label) && label[pos] != ' ')
+        while (pos < strlen(text) && text[pos] != ' ')
           ++pos;
         char line[pos - offset + 1];
-        strncpy(line, &(label[offset]), pos - offset + 1);
+        strncpy(line, &(text[offset]), pos - offset + 1);
 
         if (alignment == Alignment::CENTER)
           tft.getTextBounds(const_cast<char*>(line), 160-width, 0, &x1, &y1, &w, &h);
         else
           tft.getTextBounds(const_cast<char*>(line), 160-(width + 4), 0, &x1, &y1, &w, &h);
 
-        if (w >= width || pos == strlen(label))
+        if (w >= width || pos == strlen(text))
         {
           // if we're here, time to write some text
-          if (pos < strlen(label))
+          if (pos < strlen(text))
           {
             memset(line, 0, pos - offset + 1);
-            strncpy(line, &(label[offset]), prev - offset + 1);
+            strncpy(line, &(text[offset]), prev - offset + 1);
           }
 
           if (alignment == Alignment::CENTER)
@@ -497,7 +1993,7 @@ public:
           tft.print(line);
           ++lines;
           offset = prev + 1;
-          if (pos < strlen(label))
+          if (pos < strlen(text))
             pos = offset;
           continue;
         }
@@ -508,7 +2004,7 @@ public:
     else
     #endif
     {
-      tft.print(label);
+      tft.print(text);
     }
 
     redraw = false;
@@ -544,7 +2040,7 @@ private:
   colour_t border;
   colour_t textColour;
   Alignment alignment;
-  const char* label;
+  const __FlashStringHelper* label; // in flash
 };
 
 
@@ -557,11 +2053,12 @@ public:
   };
 
 
-  Text(int8_t _x, int8_t _y, int8_t w, int8_t h, uint8_t sz, const char* str = nullptr) : Component(), x(_x), y(_y), width(w), height(h),
+  // the owner gives it sz bytes for the label, rather than it taking them off the heap
+  Text(int8_t _x, int8_t _y, int8_t w, int8_t h, char* buffer, uint8_t sz, const char* str = nullptr) : Component(), x(_x), y(_y), width(w), height(h),
   background(COLOUR_BLACK), border(colour(63, 127, 255)), textColour(COLOUR_WHITE), alignment(Alignment::CENTER)
   {
     length = sz;
-    label = static_cast<char*>(malloc(length));
+    label = buffer;
     if (str)
       strncpy(label, str, length);
   }
@@ -667,6 +2164,12 @@ public:
     redraw = true;
   }
 
+  void setLabel(const __FlashStringHelper* txt)
+  {
+    strncpy_P(label, reinterpret_cast<PGM_P>(txt), length);
+    redraw = true;
+  }
+
   void setLabel(const uint8_t n)
   {
     snprintf(label, length, "%3d", n);
@@ -757,8 +2260,8 @@ public:
   virtual void idle() {};
 
 protected:
-  virtual uint8_t getComponentCount() const;
-  virtual Component* const* getComponents() const;
+  virtual uint8_t getComponentCount() const = 0;
+  virtual Component* const* getComponents() const = 0;
 
   bool redraw;
   uint8_t focusIndex;
@@ -778,6 +2281,64 @@ protected:
   Component* components[TComponentCount];
 };
 
+/**
+ * Room for one of a set of screens that are never up at the same time
+ * They take turns in the one buffer rather than each keeping its RAM for good, and each is built afresh from the
+ * configuration when it's shown
+ * @param TSize size of the largest of them
+ */
+template <size_t TSize>
+class ScreenSlot
+{
+public:
+  ScreenSlot() : maker(nullptr)
+  {
+  }
+
+  /**
+   * Builds a screen in the slot, replacing whatever was there
+   * @return the new screen
+   */
+  template <typename TScreen>
+  Screen* build()
+  {
+    static_assert(sizeof(TScreen) <= TSize, "the slot is too small for this screen");
+    maker = make<TScreen>;
+    return make<TScreen>(storage);
+  }
+
+  /**
+   * Gets the screen in the slot if it's the one on top and of the type asked for
+   * @param top screen on top of the stack
+   * @return the screen, or nullptr
+   */
+  template <typename TScreen>
+  TScreen* shown(const Screen* top)
+  {
+    if (maker != make<TScreen> || top != reinterpret_cast<Screen*>(storage))
+      return nullptr;
+    return reinterpret_cast<TScreen*>(storage);
+  }
+
+  /**
+   * Gets the screen in the slot, which the caller knows is a TScreen
+   */
+  template <typename TScreen>
+  inline TScreen& as() { return *reinterpret_cast<TScreen*>(storage); }
+
+private:
+  typedef Screen*(*maker_t)(uint8_t* storage);
+
+  // one for each type of screen, so it doubles as a note of which type is in the slot
+  template <typename TScreen>
+  static Screen* make(uint8_t* storage) { return new (storage) TScreen(); }
+
+  maker_t maker;
+  alignas(void*) uint8_t storage[TSize];
+};
+
+constexpr size_t larger(const size_t a, const size_t b) { return a > b ? a : b; }
+
 void cb_make_node();
 void cb_play_classic();
 void cb_go_back();
@@ -790,13 +2351,13 @@ class ScreenGameSetup : public ScreenCommon<6>
 {
 public:
   ScreenGameSetup() : ScreenCommon(),
-  nodesLabel(Label(16, 16, 64, 16, "Nodes")),
-  nodes(Text(80, 16, 32, 16, 4)),
-  nodesUp(Button(112, 16, 16, 16, "+", cb_nodes_up)),
-  nodesDown(Button(128, 16, 16, 16, "-", cb_nodes_down)),
+  nodesLabel(Label(16, 16, 64, 16, F("Nodes"))),
+  nodes(80, 16, 32, 16, nodesBuffer, sizeof(nodesBuffer)),
+  nodesUp(Button(112, 16, 16, 16, F("+"), cb_nodes_up)),
+  nodesDown(Button(128, 16, 16, 16, F("-"), cb_nodes_down)),
 
-  classic(Button(16, 40, 128, 20, "Classic", cb_play_classic)),
-  back(Button(16, 100, 128, 20, "Back", cb_go_back))
+  classic(Button(16, 40, 128, 20, F("Classic"), cb_play_classic)),
+  back(Button(16, 100, 128, 20, F("Back"), cb_go_back))
   {
     components[0] = &classic;
     components[1] = &nodesLabel;
@@ -827,6 +2388,7 @@ public:
 private:
   Label nodesLabel;
   Text nodes;
+  char nodesBuffer[4];
   Button nodesUp;
   Button nodesDown;
 
@@ -834,7 +2396,7 @@ private:
   Button back;
 };
 
-class ScreenGameplay : public ScreenCommon<2>
+class ScreenGameplay : public ScreenCommon<3>
 {
 public:
   enum class GameplayState
@@ -845,14 +2407,18 @@ public:
   };
 
   ScreenGameplay() : ScreenCommon(),
-  status(Text(8, 8, tft.height() - 16, 20, 20)),
-  nodeCount(Text(8, 36, tft.height() - 16, 20, 4))
+  status(8, 8, tft.height() - 16, 20, statusBuffer, sizeof(statusBuffer)),
+  nodeCount(8, 36, tft.height() - 16, 20, nodeCountBuffer, sizeof(nodeCountBuffer)),
+  delivery(8, 64, tft.height() - 16, 20, deliveryBuffer, sizeof(deliveryBuffer)),
+  // anything but WAITING, so setting it below puts the label up
+  state(GameplayState::GAME_OVER)
   {
     components[0] = &status;
     components[1] = &nodeCount;
+    components[2] = &delivery;
 
     setGameplayState(GameplayState::WAITING);
-    nodeCount.setLabel("0");
+    nodeCount.setLabel(F("0"));
   }
 
   virtual void idle()
@@ -865,9 +2431,29 @@ public:
     if (count != lastCount)
     {
       nodeCount.setLabel(count);
+      // the circles change size, so clear the big ones away
+      if ((count > ROW) != (lastCount > ROW))
+        markRerender();
       lastCount = count;
     }
 
+    // how far our last setup or win has got, counting ourselves
+    if (lastBroadcast != NO_MESSAGE)
+    {
+      static uint8_t lastDelivered = 255;
+      static uint8_t lastTargets = 255;
+      const uint8_t delivered = reliable.delivered(lastBroadcast) + 1;
+      const uint8_t targets = reliable.targets(lastBroadcast) + 1;
+      if (delivered != lastDelivered || targets != lastTargets)
+      {
+        char label[16];
+        snprintf(label, sizeof(label), "Reached %d/%d", delivered, targets);
+        delivery.setLabel(label);
+        lastDelivered = delivered;
+        lastTargets = targets;
+      }
+    }
+
     // game not started yet
     if (game.start == 0)
     {
@@ -886,7 +2472,13 @@ public:
 
   virtual void render()
   {
-    ScreenCommon<2>::render();
+    ScreenCommon<3>::render();
+
+    // a row of ROW circles fits across the screen, past that they're drawn smaller, in rows of COMPACT_ROW
+    const bool compact = nodes_online() > ROW;
+    const uint8_t perRow = compact ? COMPACT_ROW : ROW;
+    const uint8_t spacing = compact ? 9 : 16;
+    const uint8_t radius = compact ? 3 : 6;
 
     uint8_t count = 0;
     for (uint8_t i = 0; i < MAX_NODES; ++i)
@@ -894,16 +2486,22 @@ public:
       if (!node_online(i))
         continue;
 
-      const NodeState& node = nodes[i];
+      const team_id team = nodes.team(i);
+      // nodes that have gone quiet get a yellow ring
+      const bool suspected = i != config::getRadioID() && detector.state(i) == Liveness::SUSPECTED;
+      const int16_t x = (compact ? 12 : 32) + spacing * (count % perRow);
+      const int16_t y = (compact ? 92 : 96) + spacing * (count / perRow);
 
-      if (node.team != NO_TEAM)
+      if (team != NO_TEAM)
       {
-        tft.fillCircle(32 + 16*count, 96, 6, teamColours[node.team]);
+        tft.fillCircle(x, y, radius, teamColours[team]);
+        if (suspected)
+          tft.drawCircle(x, y, radius, COLOUR_YELLOW);
       }
       else
       {
-        tft.fillCircle(32 + 16*count, 96, 6, COLOUR_BLACK);
-        tft.drawCircle(32 + 16*count, 96, 6, COLOUR_WHITE);
+        tft.fillCircle(x, y, radius, COLOUR_BLACK);
+        tft.drawCircle(x, y, radius, suspected ? COLOUR_YELLOW : COLOUR_WHITE);
       }
       ++count;
     }
@@ -918,20 +2516,28 @@ public:
     switch(state)
     {
       case GameplayState::WAITING:
-        status.setLabel("Waiting");
+        status.setLabel(F("Waiting"));
       break;
       case GameplayState::IN_PROGRESS:
-        status.setLabel("In progress");
+        status.setLabel(F("In progress"));
       break;
       case GameplayState::GAME_OVER:
-        status.setLabel("Game over");
+        status.setLabel(F("Game over"));
       break;
     }
   }
 
 private:
+  // circles to a row, at full size and past that, four rows of COMPACT_ROW take 64 nodes
+  static const uint8_t ROW = 8;
+  static const uint8_t COMPACT_ROW = 16;
+
   Text status;
+  char statusBuffer[20];
   Text nodeCount;
+  char nodeCountBuffer[4];
+  Text delivery;
+  char deliveryBuffer[16];
   GameplayState state;
 };
 ScreenGameplay screenGameplay;
@@ -948,8 +2554,7 @@ class ScreenScanner : public ScreenCommon<1>
 {
 public:
   ScreenScanner() : ScreenCommon(),
-  back(Button(108, 4, 16, 16, "X", cb_exit_scanner)),
-  scan{0},
+  back(Button(108, 4, 16, 16, F("X"), cb_exit_scanner)),
   channel(0)
   {
     components[0] = &back;
@@ -968,13 +2573,11 @@ public:
 
   virtual void idle()
   {
-    const uint8_t old = scan[channel];
+    const uint8_t level = radio.scanChannel(channel, MEASUREMENTS);
 
-    scan[channel] = radio.scanChannel(channel, 10);
-
-    if (old > scan[channel])
-      tft.drawLine(channel + 1, GRAPH_BASE - scan[channel] - 1, channel + 1, GRAPH_BASE - old - 1, COLOUR_BLACK);
-    tft.drawLine(channel + 1, GRAPH_BASE - scan[channel] - 1, channel + 1, GRAPH_BASE - 1, COLOUR_YELLOW);
+    // no bar is taller than MEASUREMENTS, so clearing that high saves remembering each channel's last one
+    tft.drawLine(channel + 1, GRAPH_BASE - MEASUREMENTS - 1, channel + 1, GRAPH_BASE - level - 1, COLOUR_BLACK);
+    tft.drawLine(channel + 1, GRAPH_BASE - level - 1, channel + 1, GRAPH_BASE - 1, COLOUR_YELLOW);
 
     if (++channel > 125)
       channel = 0;
@@ -982,10 +2585,10 @@ public:
 
 private:
   Button back;
-  uint8_t scan[125];
   uint8_t channel;
 
   static const uint8_t GRAPH_BASE = 112;
+  static const uint8_t MEASUREMENTS = 10;
 };
 
 
@@ -994,21 +2597,22 @@ void cb_channel_down();
 void cb_radio_id_up();
 void cb_radio_id_down();
 void cb_radio_save();
-void cb_radio_cancel();
-class ScreenRadio : public ScreenCommon<10>
+void cb_radio_auto();
+class ScreenRadio : public ScreenCommon<11>
 {
 public:
   ScreenRadio() : ScreenCommon(),
-  back(Button(140, 4, 16, 16, "X", cb_radio_cancel)),
-  channelLabel(Label(16, 32, 64, 16, "Channel")),
-  channel(Text(80, 32, 32, 16, 4)),
-  channelUp(Button(112, 32, 16, 16, "+", cb_channel_up)),
-  channelDown(Button(128, 32, 16, 16, "-", cb_channel_down)),
-  radioLabel(Label(16, 64, 64, 16, "Radio ID")),
-  radioID(Text(80, 64, 32, 16, 4)),
-  radioIDUp(Button(112, 64, 16, 16, "+", cb_radio_id_up)),
-  radioIDDown(Button(128, 64, 16, 16, "-", cb_radio_id_down)),
-  save(Button(16, 100, 128, 20, "Save", cb_radio_save)),
+  back(Button(140, 4, 16, 16, F("X"), cb_go_back)),
+  channelLabel(Label(16, 32, 64, 16, F("Channel"))),
+  channel(80, 32, 32, 16, channelBuffer, sizeof(channelBuffer)),
+  channelUp(Button(112, 32, 16, 16, F("+"), cb_channel_up)),
+  channelDown(Button(128, 32, 16, 16, F("-"), cb_channel_down)),
+  radioLabel(Label(16, 64, 64, 16, F("Radio ID"))),
+  radioID(80, 64, 32, 16, radioIDBuffer, sizeof(radioIDBuffer)),
+  radioIDUp(Button(112, 64, 16, 16, F("+"), cb_radio_id_up)),
+  radioIDDown(Button(128, 64, 16, 16, F("-"), cb_radio_id_down)),
+  save(Button(16, 100, 60, 20, F("Save"), cb_radio_save)),
+  autoJoin(Button(84, 100, 60, 20, F("Auto"), cb_radio_auto)),
   newChannel(config::getChannel()),
   newRadioID(config::getRadioID())
   {
@@ -1022,6 +2626,7 @@ public:
     components[7] = &radioIDUp;
     components[8] = &radioIDDown;
     components[9] = &save;
+    components[10] = &autoJoin;
 
     channelLabel.setAlignment(Label::Alignment::LEFT);
     radioLabel.setAlignment(Label::Alignment::LEFT);
@@ -1048,13 +2653,16 @@ private:
   Button back;
   Label channelLabel;
   Text channel;
+  char channelBuffer[4];
   Button channelUp;
   Button channelDown;
   Label radioLabel;
   Text radioID;
+  char radioIDBuffer[4];
   Button radioIDUp;
   Button radioIDDown;
   Button save;
+  Button autoJoin;
   channel_t newChannel;
   radio_id newRadioID;
 };
@@ -1067,15 +2675,15 @@ class ScreenTags : public ScreenCommon<9>
 {
 public:
   ScreenTags() : ScreenCommon(),
-  back(Button(140, 4, 16, 16, "X", cb_radio_cancel)),
-  teamLabel(Label(16, 32, 64, 16, "Team")),
-  teamText(Text(80, 32, 32, 16, 4)),
-  teamUp(Button(112, 32, 16, 16, "+", cb_team_up)),
-  teamDown(Button(128, 32, 16, 16, "-", cb_team_down)),
-  playerLabel(Label(16, 64, 64, 16, "Player")),
-  playerText(Text(80, 64, 32, 16, 4)),
-  playerUp(Button(112, 64, 16, 16, "+", cb_player_up)),
-  playerDown(Button(128, 64, 16, 16, "-", cb_player_down)),
+  back(Button(140, 4, 16, 16, F("X"), cb_go_back)),
+  teamLabel(Label(16, 32, 64, 16, F("Team"))),
+  teamText(80, 32, 32, 16, teamTextBuffer, sizeof(teamTextBuffer)),
+  teamUp(Button(112, 32, 16, 16, F("+"), cb_team_up)),
+  teamDown(Button(128, 32, 16, 16, F("-"), cb_team_down)),
+  playerLabel(Label(16, 64, 64, 16, F("Player"))),
+  playerText(80, 64, 32, 16, playerTextBuffer, sizeof(playerTextBuffer)),
+  playerUp(Button(112, 64, 16, 16, F("+"), cb_player_up)),
+  playerDown(Button(128, 64, 16, 16, F("-"), cb_player_down)),
   team(0),
   player(0)
   {
@@ -1113,39 +2721,180 @@ private:
 
   Label teamLabel;
   Text teamText;
+  char teamTextBuffer[4];
   Button teamUp;
   Button teamDown;
   team_id team;
 
   Label playerLabel;
   Text playerText;
+  char playerTextBuffer[4];
   Button playerUp;
   Button playerDown;
   player_id player;
 };
 
 
-ScreenRadio screenRadio;
-ScreenTags screenTags;
-class ScreenConfig : public ScreenCommon<3>
+
+#ifdef DIAGNOSTICS
+void cb_diagnostics_prev();
+void cb_diagnostics_next();
+void cb_diagnostics_dump();
+class ScreenDiagnostics : public ScreenCommon<8>
+{
+public:
+  ScreenDiagnostics() : ScreenCommon(),
+  back(Button(140, 4, 16, 16, F("X"), cb_go_back)),
+  prev(Button(16, 4, 16, 16, F("<"), cb_diagnostics_prev)),
+  peerText(32, 4, 32, 16, peerTextBuffer, sizeof(peerTextBuffer)),
+  next(Button(64, 4, 16, 16, F(">"), cb_diagnostics_next)),
+  dump(Button(88, 4, 44, 16, F("Dump"), cb_diagnostics_dump)),
+  sends(16, 24, 128, 16, sendsBuffer, sizeof(sendsBuffer)),
+  reliability(16, 40, 128, 16, reliabilityBuffer, sizeof(reliabilityBuffer)),
+  received(16, 56, 128, 16, receivedBuffer, sizeof(receivedBuffer)),
+  peer(0),
+  lastRefresh(0)
+  {
+    components[0] = &back;
+    components[1] = &prev;
+    components[2] = &peerText;
+    components[3] = &next;
+    components[4] = &dump;
+    components[5] = &sends;
+    components[6] = &reliability;
+    components[7] = &received;
+
+    sends.setAlignment(Text::Alignment::LEFT);
+    reliability.setAlignment(Text::Alignment::LEFT);
+    received.setAlignment(Text::Alignment::LEFT);
+    setPeer(0);
+  }
+
+  virtual void render()
+  {
+    ScreenCommon<8>::render();
+    renderHistogram();
+  }
+
+  virtual void idle()
+  {
+    network();
+
+    const millis_t REFRESH_INTERVAL = 1000;
+    if (millis() - lastRefresh < REFRESH_INTERVAL)
+      return;
+    lastRefresh = millis();
+    refresh();
+    renderHistogram();
+  }
+
+  inline radio_id getPeer() const { return peer; }
+  void setPeer(const radio_id p)
+  {
+    peer = p;
+    peerText.setLabel(peer);
+    refresh();
+  }
+
+private:
+  static const uint8_t GRAPH_BASE = 120;
+  static const uint8_t GRAPH_HEIGHT = 40;
+
+  void refresh()
+  {
+    const PeerStats::Peer& p = stats.peer(peer);
+    char label[20];
+    snprintf(label, sizeof(label), "Sent %u Fail %u", p.sends, p.failures);
+    sends.setLabel(label);
+    snprintf(label, sizeof(label), "Retry %u Dup %u", p.retries, p.duplicates);
+    reliability.setLabel(label);
+    snprintf(label, sizeof(label), "RX %u RTT %ums", p.received, p.lastRtt);
+    received.setLabel(label);
+  }
+
+  /**
+   * One bar per round trip bucket, scaled to the biggest
+   */
+  void renderHistogram()
+  {
+    const PeerStats::Peer& p = stats.peer(peer);
+    uint8_t most = 1;
+    for (uint8_t i = 0; i < PeerStats::RTT_BUCKETS; ++i)
+    {
+      if (p.rtt[i] > most)
+        most = p.rtt[i];
+    }
+
+    for (uint8_t i = 0; i < PeerStats::RTT_BUCKETS; ++i)
+    {
+      const uint8_t height = static_cast<uint16_t>(p.rtt[i]) * GRAPH_HEIGHT / most;
+      const uint8_t x = 16 + i * 16;
+      tft.fillRect(x, GRAPH_BASE - GRAPH_HEIGHT, 12, GRAPH_HEIGHT - height, COLOUR_BLACK);
+      tft.fillRect(x, GRAPH_BASE - height, 12, height, COLOUR_YELLOW);
+    }
+    tft.drawLine(16, GRAPH_BASE, 16 + PeerStats::RTT_BUCKETS * 16 - 4, GRAPH_BASE, COLOUR_WHITE);
+  }
+
+  Button back;
+  Button prev;
+  Text peerText;
+  char peerTextBuffer[4];
+  Button next;
+  Button dump;
+  Text sends;
+  char sendsBuffer[20];
+  Text reliability;
+  char reliabilityBuffer[20];
+  Text received;
+  char receivedBuffer[20];
+  radio_id peer;
+  millis_t lastRefresh;
+};
+#endif
+
+// the screens under Configure
+#ifdef DIAGNOSTICS
+ScreenSlot<larger(larger(sizeof(ScreenRadio), sizeof(ScreenTags)), sizeof(ScreenDiagnostics))> configSlot;
+#else
+ScreenSlot<larger(sizeof(ScreenRadio), sizeof(ScreenTags))> configSlot;
+#endif
+
+void cb_config_radios();
+void cb_config_tags();
+void cb_config_diagnostics();
+#ifdef DIAGNOSTICS
+const uint8_t CONFIG_BUTTONS = 4;
+#else
+const uint8_t CONFIG_BUTTONS = 3;
+#endif
+class ScreenConfig : public ScreenCommon<CONFIG_BUTTONS>
 {
 public:
   ScreenConfig() : ScreenCommon(),
-  radios(Button::gotoScreen(16, 8, tft.height() - 32, 20, "Configure Radios", &screenRadio)),
-  tags(Button::gotoScreen(16, 36, tft.height() - 32, 20, "Configure Tags", &screenTags)),
-  // master(Button(16, 36, tft.height() - 32, 20, "Master Tag", cb_go_mastertag)),
-  back(Button(16, 100, tft.height() - 32, 20, "Back", cb_go_back))
+  radios(Button(16, 8, tft.height() - 32, 20, F("Configure Radios"), cb_config_radios)),
+  tags(Button(16, 36, tft.height() - 32, 20, F("Configure Tags"), cb_config_tags)),
+  // master(Button(16, 36, tft.height() - 32, 20, F("Master Tag"), cb_go_mastertag)),
+  #ifdef DIAGNOSTICS
+  diagnostics(Button(16, 64, tft.height() - 32, 20, F("Diagnostics"), cb_config_diagnostics)),
+  #endif
+  back(Button(16, 100, tft.height() - 32, 20, F("Back"), cb_go_back))
   {
     components[0] = &radios;
     components[1] = &tags;
     // components[1] = &master;
-    components[2] = &back;
+    #ifdef DIAGNOSTICS
+    components[2] = &diagnostics;
+    #endif
+    components[CONFIG_BUTTONS - 1] = &back;
   }
 
 private:
   Button radios;
   Button tags;
   // Button master;
+  #ifdef DIAGNOSTICS
+  Button diagnostics;
+  #endif
   Button back;
 };
 
@@ -1155,8 +2904,8 @@ class ScreenMaster : public ScreenCommon<2>
 {
 public:
   ScreenMaster() : ScreenCommon(),
-  back(Button(16, 100, tft.height() - 32, 20, "Back", cb_go_back)),
-  text(Label(16, 8, tft.height() - 32, 84, "Scan your tag to create a master tag. This can be used to authenticate with other nodes to perform master level operations."))
+  back(Button(16, 100, tft.height() - 32, 20, F("Back"), cb_go_back)),
+  text(Label(16, 8, tft.height() - 32, 84, F("Scan your tag to create a master tag. This can be used to authenticate with other nodes to perform master level operations.")))
   {
     text.setAlignment(Label::Alignment::LEFT);
     components[0] = &back;
@@ -1171,17 +2920,20 @@ private:
 // ScreenMaster screenMaster;
 
 
-ScreenGameSetup gamesetup;
-ScreenScanner scanner;
-ScreenConfig screenConfig;
+// the screens off the home screen, bar gameplay which the network keeps up to date
+ScreenSlot<larger(larger(sizeof(ScreenGameSetup), sizeof(ScreenScanner)), sizeof(ScreenConfig))> menuSlot;
+
+void cb_games();
+void cb_scanner();
+void cb_config();
 class ScreenHome : public ScreenCommon<4>
 {
 public:
   ScreenHome() : ScreenCommon(),
-  node(Button(16, 8, tft.height() - 32, 20, "Node", cb_make_node)),
-  games(Button::gotoScreen(16, 36, tft.height() - 32, 20, "Games", &gamesetup)),
-  channel(Button::gotoScreen(16, 64, tft.height() - 32, 20, "Channel Scanner", &scanner)),
-  radios(Button::gotoScreen(16, 92, tft.height() - 32, 20, "Configure", &screenConfig))
+  node(Button(16, 8, tft.height() - 32, 20, F("Node"), cb_make_node)),
+  games(Button(16, 36, tft.height() - 32, 20, F("Games"), cb_games)),
+  channel(Button(16, 64, tft.height() - 32, 20, F("Channel Scanner"), cb_scanner)),
+  radios(Button(16, 92, tft.height() - 32, 20, F("Configure"), cb_config))
   {
     components[0] = &node;
     components[1] = &games;
@@ -1208,6 +2960,38 @@ inline void cb_go_screen(Screen* screen)
   screenStack[screenIndex]->markRerender();
 }
 
+void cb_games()
+{
+  cb_go_screen(menuSlot.build<ScreenGameSetup>());
+}
+
+void cb_scanner()
+{
+  cb_go_screen(menuSlot.build<ScreenScanner>());
+}
+
+void cb_config()
+{
+  cb_go_screen(menuSlot.build<ScreenConfig>());
+}
+
+void cb_config_radios()
+{
+  cb_go_screen(configSlot.build<ScreenRadio>());
+}
+
+void cb_config_tags()
+{
+  cb_go_screen(configSlot.build<ScreenTags>());
+}
+
+#ifdef DIAGNOSTICS
+void cb_config_diagnostics()
+{
+  cb_go_screen(configSlot.build<ScreenDiagnostics>());
+}
+#endif
+
 void cb_make_node()
 {
   screenStack[++screenIndex] = &screenGameplay;
@@ -1216,15 +3000,14 @@ void cb_make_node()
 
 void cb_nodes_up()
 {
-  uint8_t count = config::getNodeCount();
-  count = (count + 1) % MAX_NODES;
-  gamesetup.setNodeCount(count);
+  // 1 to MAX_NODES, wrapping round
+  const uint8_t count = config::getNodeCount() % MAX_NODES + 1;
+  menuSlot.as<ScreenGameSetup>().setNodeCount(count);
 }
 void cb_nodes_down()
 {
-  uint8_t count = config::getNodeCount();
-  count = (count + MAX_NODES - 1) % MAX_NODES;
-  gamesetup.setNodeCount(count);
+  const uint8_t count = (config::getNodeCount() + MAX_NODES - 2) % MAX_NODES + 1;
+  menuSlot.as<ScreenGameSetup>().setNodeCount(count);
 }
 
 void cb_play_classic()
@@ -1232,19 +3015,19 @@ void cb_play_classic()
   // start the game
   Packet packet = {
     .opcode = OpCode::GAME_SETUP,
-    .source = config::getRadioID(),
-    .timestamp = millis(),
+    .timestamp = hlc.stamp(netclock.now()),
   };
   packet.nodes = config::getNodeCount();
   packet.teams = 2;
+  #ifdef CAPTURE
+  recorder.input(capture::Input::PLAY, packet.nodes, packet.teams);
+  #endif
 
-  game.start = millis();
+  merge_game(packet.timestamp, 0, 0, NO_TEAM);
   game.nodes = packet.nodes;
   game.teams = packet.teams;
-  for (uint8_t i = 0; i < MAX_NODES; ++i)
-    nodes[i].team = NO_TEAM;
 
-  broadcast(packet);
+  reliable_broadcast(packet);
 
   screenStack[++screenIndex] = &screenGameplay;
   screenStack[screenIndex]->markRerender();
@@ -1252,60 +3035,102 @@ void cb_play_classic()
 
 void cb_channel_up()
 {
-  screenRadio.setChannel((screenRadio.getChannel() + 1) % (NRFLite::MAX_NRF_CHANNEL + 1));
+  ScreenRadio& screen = configSlot.as<ScreenRadio>();
+  screen.setChannel((screen.getChannel() + 1) % (NRFLite::MAX_NRF_CHANNEL + 1));
 }
 
 void cb_channel_down()
 {
-  screenRadio.setChannel((screenRadio.getChannel() + NRFLite::MAX_NRF_CHANNEL - 1) % (NRFLite::MAX_NRF_CHANNEL));
+  ScreenRadio& screen = configSlot.as<ScreenRadio>();
+  screen.setChannel((screen.getChannel() + NRFLite::MAX_NRF_CHANNEL - 1) % (NRFLite::MAX_NRF_CHANNEL));
 }
 
 void cb_radio_id_up()
 {
-  screenRadio.setRadioID((screenRadio.getRadioID() + 1) % MAX_NODES);
+  ScreenRadio& screen = configSlot.as<ScreenRadio>();
+  screen.setRadioID((screen.getRadioID() + 1) % MAX_NODES);
 }
 
 void cb_radio_id_down()
 {
-  screenRadio.setRadioID((screenRadio.getRadioID() + MAX_NODES-1) % MAX_NODES);
+  ScreenRadio& screen = configSlot.as<ScreenRadio>();
+  screen.setRadioID((screen.getRadioID() + MAX_NODES-1) % MAX_NODES);
 }
 
 void cb_radio_save()
 {
-  config::setChannel(screenRadio.getChannel());
-  config::setRadioID(screenRadio.getRadioID());
+  const ScreenRadio& screen = configSlot.as<ScreenRadio>();
+  config::setChannel(screen.getChannel());
+  config::setRadioID(screen.getRadioID());
 
   radio_init();
 
   cb_go_back();
 }
 
-void cb_radio_cancel()
+/**
+ * Joins whatever network is on the selected channel, taking the radio ID it offers
+ */
+void cb_radio_auto()
 {
-  screenRadio.setChannel(config::getChannel());
-  screenRadio.setRadioID(config::getRadioID());
+  ScreenRadio& screen = configSlot.as<ScreenRadio>();
+  node_mask_t members = 0;
+  radio_id neighbour = NO_ROUTE;
+  radio_id id = NO_ROUTE;
+
+  // the network could be on any profile, try the one we were last on first
+  uint8_t profile = config::getProfile();
+  for (uint8_t i = 0; i < profiles::COUNT && id == NO_ROUTE; ++i)
+  {
+    if (i > 0)
+      profile = (profile + 1) % profiles::COUNT;
+    id = join(screen.getChannel(), profile, members, neighbour);
+  }
+  if (id == NO_ROUTE)
+  {
+    // nobody there, put the radio back how it was
+    radio_init();
+    return;
+  }
 
-  cb_go_back();
+  config::setProfile(profile);
+  screen.setRadioID(id);
+  cb_radio_save();
+
+  // start off knowing who's about rather than waiting to hear from everyone
+  for (uint8_t i = 0; i < MAX_NODES; ++i)
+  {
+    if (members & (static_cast<node_mask_t>(1) << i))
+      detector.heard(i, millis());
+  }
+  routing.heard(neighbour, millis());
+  // and ask for their view of the network and the game straight away
+  lastGraph = 0;
+  lastDigest = 0;
 }
 
 void cb_team_up()
 {
-  screenTags.setTeamID((screenTags.getTeamID() + 1) % (7 + 1));
+  ScreenTags& screen = configSlot.as<ScreenTags>();
+  screen.setTeamID((screen.getTeamID() + 1) % (7 + 1));
 }
 
 void cb_team_down()
 {
-  screenTags.setTeamID((screenTags.getTeamID() + 7 - 1) % (7 + 1));
+  ScreenTags& screen = configSlot.as<ScreenTags>();
+  screen.setTeamID((screen.getTeamID() + 7 - 1) % (7 + 1));
 }
 
 void cb_player_up()
 {
-  screenTags.setPlayerID((screenTags.getPlayerID() + 1) % 100);
+  ScreenTags& screen = configSlot.as<ScreenTags>();
+  screen.setPlayerID((screen.getPlayerID() + 1) % 100);
 }
 
 void cb_player_down()
 {
-  screenTags.setPlayerID((screenTags.getPlayerID() + 100-1) % 100);
+  ScreenTags& screen = configSlot.as<ScreenTags>();
+  screen.setPlayerID((screen.getPlayerID() + 100-1) % 100);
 }
 
 
@@ -1316,11 +3141,105 @@ void cb_go_back()
 }
 
 
+#ifdef DIAGNOSTICS
+void cb_diagnostics_prev()
+{
+  ScreenDiagnostics& screen = configSlot.as<ScreenDiagnostics>();
+  screen.setPeer((screen.getPeer() + MAX_NODES - 1) % MAX_NODES);
+}
+
+void cb_diagnostics_next()
+{
+  ScreenDiagnostics& screen = configSlot.as<ScreenDiagnostics>();
+  screen.setPeer((screen.getPeer() + 1) % MAX_NODES);
+}
+
+#ifdef __AVR__
+/**
+ * Gets the gap between the top of the heap and the stack, as deep as the stack is right now
+ * @return free bytes
+ */
+uint16_t free_ram()
+{
+  extern char __heap_start;
+  extern char* __brkval;
+  char top;
+  return &top - (__brkval != nullptr ? __brkval : &__heap_start);
+}
+#endif
+
+void cb_diagnostics_dump()
+{
+  #ifdef __AVR__
+  Serial.print("free ram ");
+  Serial.println(free_ram());
+  #endif
+  stats.dump(Serial);
+  dispatcher.dump(Serial);
+  gossip.dump(Serial);
+  #ifdef DUTY_CYCLE
+  const millis_t total = awakeTime + dozeTime;
+  const uint16_t awake = total ? static_cast<uint32_t>(awakeTime) * 1000 / total : 1000;
+  Serial.print("awake ");
+  Serial.print(awake / 10);
+  Serial.print("% draw ");
+  Serial.print(duty::current(awake) / 1000);
+  Serial.print("mA battery ");
+  Serial.print(duty::runtime(awake));
+  Serial.print("h, always on ");
+  Serial.print(duty::runtime(1000));
+  Serial.println("h");
+  #endif
+  #ifdef FRAME_AUTH
+  // time sealing a full frame, the most a packet waits for its MAC
+  // on a copy of its own, so the runs don't use up counters. Never started, so it doesn't touch the epoch either
+  FrameAuth<1> scratch(config::NETWORK_KEY);
+  uint8_t frame[MAX_FRAME_SIZE];
+  memset(frame, 0, sizeof(frame));
+  const uint8_t AUTH_RUNS = 16;
+  const uint32_t before = micros();
+  for (uint8_t i = 0; i < AUTH_RUNS; ++i)
+    scratch.seal(frame, MAX_FRAME_SIZE - FRAME_TRAILER_SIZE);
+  const uint32_t took = micros() - before;
+  Serial.print("auth rejected ");
+  Serial.print(auth.getRejected());
+  Serial.print(" seal ");
+  Serial.print(took / AUTH_RUNS);
+  Serial.println("us a frame");
+  #endif
+  #ifdef COORDINATOR
+  Serial.print("coordinator ");
+  Serial.print(coordinator.current(millis()));
+  Serial.print(" terms ");
+  Serial.print(coordinator.getTerms());
+  Serial.print(" failovers ");
+  Serial.println(coordinator.getFailovers());
+  #endif
+  #ifdef RADIO_IRQ
+  Serial.print("rx overflows ");
+  Serial.println(rxring.getOverflows());
+  #endif
+  #ifdef CAPTURE
+  Serial.print("capture dropped ");
+  Serial.println(recorder.getDropped());
+  // last, the text above would get in the middle of the records otherwise
+  recorder.dump();
+  #endif
+}
+#endif
+
 void cb_rerender_gameplay()
 {
   screenGameplay.markRerender();
 }
 
+void cb_channel_changed()
+{
+  // anywhere else, the radio screen picks the new channel up when it's next built
+  if (ScreenRadio* screen = configSlot.shown<ScreenRadio>(screenStack[screenIndex]))
+    screen->setChannel(config::getChannel());
+}
+
 // bool nfcEnabled()
 // {
 //   if (screenStack[screenIndex] == &screenRadio)
@@ -1373,12 +3292,12 @@ void gui_update()
       mfrc522.PCD_Authenticate(MFRC522::PICC_CMD_MF_AUTH_KEY_A, TRAILER, &key, &(mfrc522.uid)) == MFRC522::STATUS_OK &&
       mfrc522.PCD_Authenticate(MFRC522::PICC_CMD_MF_AUTH_KEY_B, TRAILER, &key, &(mfrc522.uid)) == MFRC522::STATUS_OK)
     {
-      if (screenStack[screenIndex] == &screenRadio)
+      if (const ScreenRadio* screenRadio = configSlot.shown<ScreenRadio>(screen))
       {
         // copy the pre shared key
         uint8_t data[16] = {0};
         memcpy(data, PSK, 8);
-        data[9] = screenRadio.getChannel();
+        data[9] = screenRadio->getChannel();
         data[10] = 0;
         MFRC522::StatusCode status = mfrc522.MIFARE_Write(BLOCK, data, 16);
         if (status == MFRC522::STATUS_OK)
@@ -1386,17 +3305,17 @@ void gui_update()
           cb_go_back();
         }
       }
-      else if (screenStack[screenIndex] == &screenTags)
+      else if (ScreenTags* screenTags = configSlot.shown<ScreenTags>(screen))
       {
         uint8_t data[16] = {0};
         memcpy(data, PSK, 8);
         data[8] = TokenType::PLAYER;
-        data[9] = screenTags.getTeamID();
-        data[10] = screenTags.getPlayerID();
+        data[9] = screenTags->getTeamID();
+        data[10] = screenTags->getPlayerID();
 
         MFRC522::StatusCode status = mfrc522.MIFARE_Write(BLOCK, data, 16);
         if (status == MFRC522::STATUS_OK)
-          screenTags.setPlayerID(screenTags.getPlayerID() + 1);
+          screenTags->setPlayerID(screenTags->getPlayerID() + 1);
       }
       else if (screenStack[screenIndex] == &screenGameplay)
       {
@@ -1411,18 +3330,30 @@ void gui_update()
             const team_id team = buffer[9];
             const player_id player = buffer[10];
 
-            nodes[config::getRadioID()].team = team;
+            const millis_t stamp = set_team(team);
             const bool won = win() != NO_TEAM;
+            #ifdef CAPTURE
+            recorder.input(capture::Input::TAG, team, player);
+            #endif
 
             led(teamColours[team]);
+            // stamped with the claim itself, so everyone orders it the same way we do
             Packet packet = {
               .opcode = won ? OpCode::WIN : OpCode::CLAIM,
-              .source = config::getRadioID(),
-              .timestamp = millis()
+              .timestamp = stamp
             };
             packet.team = team;
             packet.player = player;
-            broadcast(packet);
+            packet.version = nodes.version(config::getRadioID());
+            if (won)
+            {
+              merge_game(game.start, packet.timestamp, config::getRadioID(), team);
+              reliable_broadcast(packet);
+            }
+            else
+            {
+              share_claim(packet);
+            }
           }
         }
       }
@@ -1467,16 +3398,7 @@ void reset()
   // turn the led off
   led(COLOUR_BLACK);
 
-  for (uint8_t i = 0; i < MAX_NODES; ++i)
-  {
-    nodes[i].lastUpdate = 0;
-    nodes[i].lastPing = 0;
-    nodes[i].team = NO_TEAM;
-
-    // clear the graph
-    // for (uint8_t j = 0; j < MAX_NODES; ++j)
-    //   graph[i][j] = 0;
-  }
+  nodes.init();
 }
 
 
@@ -1490,6 +3412,11 @@ void setup()
   digitalWrite(PIN_PIXEL_SELECT, 1);
 
   SPI.begin();
+  #ifdef RADIO_IRQ
+  // keep the radio interrupt out of everyone else's SPI transactions
+  pinMode(PIN_RADIO_IRQ, INPUT_PULLUP);
+  SPI.usingInterrupt(digitalPinToInterrupt(PIN_RADIO_IRQ));
+  #endif
 
   led(COLOUR_RED);
   delay(100);
@@ -1509,13 +3436,19 @@ void setup()
   tft.setRotation(1);
   tft.fillScreen(COLOUR_BLACK);
 
-  // Serial.begin(115200);
+  #ifdef DIAGNOSTICS
+  // for the dump on the diagnostics screen
+  Serial.begin(115200);
+  #endif
   // Serial.println(config::getChannel());
   // Serial.println(config::getRadioID());
 
+  #ifdef FRAME_AUTH
+  auth.init(config::EPOCH_ADDRESS);
+  #endif
   if (!radio_init())
   {
-    Label error(16, 54, tft.height() - 16, 20, "RADIO FAILED");
+    Label error(16, 54, tft.height() - 16, 20, F("RADIO FAILED"));
     error.setBackgroundColour(COLOUR_BLACK);
     error.setBorderColour(COLOUR_RED);
     error.setTextColour(COLOUR_RED);
@@ -1534,7 +3467,54 @@ void setup()
   reset();
 }
 
+#ifdef DUTY_CYCLE
+/**
+ * Powers the radio down outside the wake windows and idles the CPU for a while between loops
+ * Stays up while a frame is going out
+ */
+void doze()
+{
+  const millis_t now = millis();
+  if (radioAsleep)
+    dozeTime += now - lastDoze;
+  else
+    awakeTime += now - lastDoze;
+  lastDoze = now;
+
+  const millis_t time = netclock.now();
+  if (sleepless() || duty::awake(time) || txqueue.busy())
+  {
+    if (radioAsleep)
+    {
+      radio.startRx();
+      radioAsleep = false;
+    }
+    return;
+  }
+
+  if (!radioAsleep)
+  {
+    radio.powerDown();
+    radioAsleep = true;
+  }
+
+  #ifdef __AVR__
+  // idle keeps timer0 running, so millis() stays right and wakes us each millisecond to check the time
+  const millis_t step = min(duty::DOZE_STEP, duty::PERIOD - time % duty::PERIOD);
+  set_sleep_mode(SLEEP_MODE_IDLE);
+  while (millis() - now < step)
+    sleep_mode();
+  #endif
+}
+#endif
+
 void loop()
 {
+  #ifdef CAPTURE
+  recorder.loop(micros());
+  #endif
   gui_update();
+  #ifdef DUTY_CYCLE
+  doze();
+  #endif
 }
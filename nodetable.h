@@ -0,0 +1,131 @@
+#ifndef NODETABLE_H_INCLUDE
+#define NODETABLE_H_INCLUDE
+
+#include <stdint.h>
+#include <string.h>
+
+#include "bitset.h"
+#include "types.h"
+
+/**
+ * Who owns each node, packed for a lot of nodes
+ * Ownership is a set of nodes per team rather than a team per node, so the win check is a few set operations.
+ * Claim stamps are kept whole, they get passed on in STATE packets and compared against game setups, so they
+ * have to come back out exactly as they went in however long the game runs. Per node that's a couple of bits
+ * for the owner and whether the claim is from this game, a byte of version and four bytes of stamp, so 64 nodes
+ * take about 340 bytes rather than the 1.4KB the old table of structs needed
+ * @param TNodes number of radio IDs in the network
+ * @param TTeams most teams in a game
+ */
+template <uint8_t TNodes, uint8_t TTeams>
+class NodeTable
+{
+public:
+  typedef Bitset<TNodes> Set;
+
+  NodeTable()
+  {
+    init();
+  }
+
+  /**
+   * Forgets everything, nobody owns anything and every version is 0
+   */
+  void init()
+  {
+    for (uint8_t t = 0; t < TTeams; ++t)
+      owned[t].clear();
+    fresh.clear();
+    memset(versions, 0, sizeof(versions));
+    memset(claims, 0, sizeof(claims));
+    base = 0;
+  }
+
+  team_id team(const radio_id node) const
+  {
+    for (uint8_t t = 0; t < TTeams; ++t)
+    {
+      if (owned[t].test(node))
+        return t;
+    }
+    return NO_TEAM;
+  }
+
+  void setTeam(const radio_id node, const team_id team)
+  {
+    for (uint8_t t = 0; t < TTeams; ++t)
+      owned[t].assign(node, t == team);
+  }
+
+  inline version_t version(const radio_id node) const { return versions[node]; }
+  inline void setVersion(const radio_id node, const version_t version) { versions[node] = version; }
+
+  /**
+   * Gets when a node was claimed
+   * @param node radio ID
+   * @return stamp, 0 if it's never been claimed
+   */
+  inline millis_t claimed(const radio_id node) const { return claims[node]; }
+
+  void setClaimed(const radio_id node, const millis_t stamp)
+  {
+    claims[node] = stamp;
+    fresh.assign(node, !before(stamp, base));
+  }
+
+  /**
+   * Gets whether a node's entry is from the current game
+   * @param node radio ID
+   * @return true if it was claimed since the game started
+   */
+  inline bool current(const radio_id node) const { return fresh.test(node); }
+
+  /**
+   * Moves on to a new game
+   * Entries claimed before it lose their team, later ones were for this game and just got here first
+   * @param start stamp of the game setup
+   */
+  void rebase(const millis_t start)
+  {
+    for (radio_id i = 0; i < TNodes; ++i)
+    {
+      if (!fresh.test(i) || before(claims[i], start))
+      {
+        setTeam(i, NO_TEAM);
+        fresh.reset(i);
+      }
+    }
+    base = start;
+  }
+
+  /**
+   * Gets the team that owns every node in a set
+   * @param online nodes still in the game
+   * @return the team, or NO_TEAM if there isn't one or the set is empty
+   */
+  team_id winner(const Set& online) const
+  {
+    if (!online.any())
+      return NO_TEAM;
+    for (uint8_t t = 0; t < TTeams; ++t)
+    {
+      if (online.subsetOf(owned[t]))
+        return t;
+    }
+    return NO_TEAM;
+  }
+
+  inline const Set& ownedBy(const team_id team) const { return owned[team]; }
+
+private:
+  // stamps wrap, so compare them as a window
+  static inline bool before(const millis_t a, const millis_t b) { return static_cast<int32_t>(a - b) < 0; }
+
+  Set owned[TTeams];
+  Set fresh; // claimed since base
+  version_t versions[TNodes];
+  millis_t claims[TNodes]; // stamps
+  millis_t base; // stamp of the game setup
+};
+
+#endif
@@ -1,54 +1,133 @@
 #ifndef PACKETS_H_INCLUDE
 #define PACKETS_H_INCLUDE
 
+#include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "types.h"
 #include "config.h"
-
-/**
- * packet type enums to prepend to messages
- */
-enum class PacketType : uint8_t
-{
-  PingPacket,
-  PongPacket,
-  GameTypePacket,
-  GameStartPacket,
-  NodeStatePacket
-};
+#include "schema.h"
 
 /**
  * different packet types
- * max packet size is 32 bytes
+ * packets travel inside frames, see below
  * `origin` is always the radio ID of the initial sender
- * `source` is always the radio ID of the sender of the packet
  * `target` is always the radio ID of the target node, not necessarily the node that will receive the packet
- * `timestamp` is always the sender's millis() value
+ * `seq` is non zero for reliable packets, the target answers each one with an ACK carrying the same `seq`
+ * `timestamp` is always the sender's network time, see ClockSync
+ * the radio ID of the sender of the frame (`source`) is in the frame header
  */
 
 enum class OpCode : uint8_t
 {
   PING,
   PONG,
-  // GRAPH,
+  GRAPH_REQUEST,
+  GRAPH,
   // LOCATION,
   GAME_SETUP,
   CLAIM,
-  WIN
+  WIN,
+  DIGEST,
+  STATE,
+  ACK,
+  JOIN,
+  OFFER,
+  INTERFERENCE,
+  RETUNE,
+  LINK,
+  LEASE
 };
+const uint8_t OPCODE_COUNT = static_cast<uint8_t>(OpCode::LEASE) + 1;
+
+/**
+ * `target` for packets meant for whichever node receives them, these are never forwarded
+ */
+static const radio_id TARGET_NEIGHBOURS = UINT8_MAX;
+
+/**
+ * hops a packet can take before it's dropped
+ */
+static const uint8_t MAX_TTL = MAX_NODES - 1;
+
+/**
+ * radio ID a new node listens on until it's been offered a real one
+ */
+static const radio_id JOIN_ID = MAX_NODES;
+
+/**
+ * frames are what actually go over the air
+ * max frame size is 32 bytes, the radio ID of the sender followed by as many packets as fit
+ */
+const uint8_t MAX_FRAME_SIZE = 32;
+const uint8_t FRAME_HEADER_SIZE = 1;
+// room every packet leaves for the shortest MAC trailer, so authenticating frames never stops one fitting, see auth.h
+const uint8_t FRAME_TRAILER_SIZE = 4;
+
+// what's left of a frame past the packet header, checked against PacketHeader below
+const uint8_t PAYLOAD_SIZE = MAX_FRAME_SIZE - FRAME_HEADER_SIZE - FRAME_TRAILER_SIZE - 9;
+
+// rows of the adjacency matrix a GRAPH packet carries, the whole matrix up to 8 nodes
+const uint8_t GRAPH_ROWS_FIT = (PAYLOAD_SIZE - sizeof(radio_id)) / (sizeof(version_t) + sizeof(node_mask_t));
+const uint8_t GRAPH_ROWS = MAX_NODES < GRAPH_ROWS_FIT ? MAX_NODES : GRAPH_ROWS_FIT;
 
+// row versions a GRAPH_REQUEST carries, so only rows newer than the asker's come back
+const uint8_t GRAPH_SPAN_FIT = PAYLOAD_SIZE - sizeof(radio_id);
+const uint8_t GRAPH_SPAN = MAX_NODES < GRAPH_SPAN_FIT ? MAX_NODES : GRAPH_SPAN_FIT;
+const uint8_t GRAPH_WINDOWS = (MAX_NODES + GRAPH_SPAN - 1) / GRAPH_SPAN;
+
+// node table versions a DIGEST packet carries, after the game
+const uint8_t DIGEST_SPAN_FIT = PAYLOAD_SIZE - sizeof(radio_id) - 2 * sizeof(millis_t) - sizeof(radio_id) -
+  sizeof(team_id);
+const uint8_t DIGEST_SPAN = MAX_NODES < DIGEST_SPAN_FIT ? MAX_NODES : DIGEST_SPAN_FIT;
+const uint8_t DIGEST_PAGES = (MAX_NODES + DIGEST_SPAN - 1) / DIGEST_SPAN;
+
+// packed, payload structs included, so the struct is the wire format on any compiler, see schema.h
+#pragma pack(push, 1)
 struct Packet
 {
   OpCode opcode;
-  // radio_id origin;
-  radio_id source;
-  // radio_id target;
+  radio_id origin;
+  radio_id target;
+  uint8_t ttl;
+  uint8_t seq;
 
   millis_t timestamp;
 
-  // 26 bytes left
+  // only as much of this as the opcode needs goes over the air
   union {
+    // ping / pong
+    struct {
+      millis_t echo; // the pinger's millis(), handed straight back in the pong
+      uint8_t stratum; // pong only, how far the responder is from the reference clock
+      millis_t local; // pong only, the responder's own millis() as of `timestamp`
+      int16_t drift; // pong only, how fast the responder's network time runs against its millis(), ppm
+    };
+
+    // graph request, the versions the sender has of a run of rows of the adjacency matrix
+    struct {
+      radio_id window; // radio ID known[0] is for
+      version_t known[GRAPH_SPAN];
+    };
+
+    // graph, a page of the sender's adjacency matrix
+    struct {
+      radio_id first; // radio ID of the first row
+      version_t versions[GRAPH_ROWS];
+      node_mask_t rows[GRAPH_ROWS];
+    };
+
+    // digest, the versions of a run of entries in the sender's node table and the game it's playing
+    struct {
+      radio_id from; // radio ID digest[0] is for
+      version_t digest[DIGEST_SPAN];
+      millis_t started; // stamp of the game setup, 0 if there hasn't been one
+      millis_t ended; // stamp of the first win, 0 while the game's running
+      radio_id endedBy; // who made that win
+      team_id winner;
+    };
+
     // struct
     // {
     //   float latitude;
@@ -61,73 +140,147 @@ struct Packet
       uint8_t teams;
     };
 
-    // claim / win
+    // claim / win / state
     struct {
       team_id team;
       player_id player;
+      version_t version;
+      radio_id node; // state only, claims are always about their origin
+      millis_t claimed; // state only, stamp of the claim, a claim's own is its timestamp, see hlc.h
     };
-  };
-};
 
+    // join / offer
+    struct {
+      uint16_t nonce; // picked by the joining node, so it can tell which offers are for it
+      radio_id offer; // offer only, a radio ID nobody is using
+      node_mask_t members; // offer only, who the sender thinks is online
+      uint16_t epoch; // offer only, of the last frame counter the sender took from the offered radio ID, see auth.h
+    };
+
+    // retune, a move of the whole network to another channel or radio profile
+    struct {
+      channel_t channel;
+      uint8_t profile;
+      millis_t at; // network time everyone switches
+    };
 
+    // link, the sender's worst delivery ratio to any neighbour, for the reference
+    struct {
+      uint8_t quality;
+    };
+  };
+};
+#pragma pack(pop)
 
 /**
- * Packet for pinging, if we include GPS, then it should include lat and lng
+ * Gets whether a packet should jump ahead of housekeeping traffic
+ * Pings and pongs count too, time they spend waiting would throw off the clock sync
+ * @param opcode opcode of the packet
+ * @return true if it's urgent
  */
-struct PingPacket
+inline bool packet_urgent(const OpCode opcode)
 {
-  const PacketType type = PacketType::PingPacket;
-  radio_id origin;
-  radio_id source;
-  radio_id target;
-  millis_t timestamp;
+  switch (opcode)
+  {
+    case OpCode::PING:
+    case OpCode::PONG:
+    case OpCode::CLAIM:
+    case OpCode::WIN:
+      return true;
+    default:
+      return false;
+  }
+}
 
-  // float lat;
-  // float lng;
-};
+#define PACKET_FIELD(name) Field<offsetof(Packet, name), sizeof(Packet::name)>
 
+/**
+ * The header every packet starts with
+ */
+typedef Schema<0,
+  PACKET_FIELD(opcode),
+  PACKET_FIELD(origin),
+  PACKET_FIELD(target),
+  PACKET_FIELD(ttl),
+  PACKET_FIELD(seq),
+  PACKET_FIELD(timestamp)
+> PacketHeader;
+const uint8_t PACKET_HEADER_SIZE = PacketHeader::end;
+static_assert(PACKET_HEADER_SIZE + PAYLOAD_SIZE + FRAME_HEADER_SIZE + FRAME_TRAILER_SIZE == MAX_FRAME_SIZE,
+  "PAYLOAD_SIZE is out of step with the header");
 
 /**
- * Ping response packet
- * requester is the source from PingPacket
+ * What goes over the air for an opcode, the header and then the fields of the union it uses
+ * @param TOpCode opcode of the packet
+ * @param TFields PACKET_FIELD()s of the payload, in struct order
  */
-struct PongPacket
+template <OpCode TOpCode, typename... TFields>
+struct Message
 {
-  const PacketType type = PacketType::PongPacket;
-  radio_id source;
-  millis_t timestamp;
-  radio_id requester;
+  static const OpCode id = TOpCode;
+  static const uint8_t size = Schema<PACKET_HEADER_SIZE, TFields...>::end;
+  static_assert(FRAME_HEADER_SIZE + size + FRAME_TRAILER_SIZE <= MAX_FRAME_SIZE, "packet doesn't fit in a frame");
 };
 
+typedef Codec<
+  Message<OpCode::PING, PACKET_FIELD(echo)>,
+  Message<OpCode::PONG, PACKET_FIELD(echo), PACKET_FIELD(stratum), PACKET_FIELD(local), PACKET_FIELD(drift)>,
+  Message<OpCode::GRAPH_REQUEST, PACKET_FIELD(window), PACKET_FIELD(known)>,
+  Message<OpCode::GRAPH, PACKET_FIELD(first), PACKET_FIELD(versions), PACKET_FIELD(rows)>,
+  Message<OpCode::GAME_SETUP, PACKET_FIELD(nodes), PACKET_FIELD(teams)>,
+  Message<OpCode::CLAIM, PACKET_FIELD(team), PACKET_FIELD(player), PACKET_FIELD(version)>,
+  Message<OpCode::WIN, PACKET_FIELD(team), PACKET_FIELD(player), PACKET_FIELD(version)>,
+  Message<OpCode::DIGEST, PACKET_FIELD(from), PACKET_FIELD(digest), PACKET_FIELD(started), PACKET_FIELD(ended),
+    PACKET_FIELD(endedBy), PACKET_FIELD(winner)>,
+  Message<OpCode::STATE, PACKET_FIELD(team), PACKET_FIELD(player), PACKET_FIELD(version), PACKET_FIELD(node), PACKET_FIELD(claimed)>,
+  Message<OpCode::ACK>,
+  Message<OpCode::JOIN, PACKET_FIELD(nonce)>,
+  Message<OpCode::OFFER, PACKET_FIELD(nonce), PACKET_FIELD(offer), PACKET_FIELD(members), PACKET_FIELD(epoch)>,
+  Message<OpCode::INTERFERENCE>,
+  Message<OpCode::RETUNE, PACKET_FIELD(channel), PACKET_FIELD(profile), PACKET_FIELD(at)>,
+  Message<OpCode::LINK, PACKET_FIELD(quality)>,
+  Message<OpCode::LEASE>
+> Messages;
+static_assert(Messages::count == OPCODE_COUNT, "every opcode needs a Message");
 
-// gameplay packets
 /**
- * A packet to describe what the game is
+ * Gets how many bytes of a packet go over the air
+ * @param opcode opcode of the packet
+ * @return header plus however much of the union the opcode uses, or 0 for an unknown opcode
  */
-struct GameTypePacket
+inline uint8_t packet_size(const OpCode opcode)
 {
-  radio_id source;
-  millis_t timestamp;
-};
-
+  return Messages::size(opcode);
+}
 
 /**
- * A packet to notify the start of a game
+ * Writes a packet out as it goes over the air
+ * @param packet packet to write
+ * @param out buffer with room for packet_size() bytes
+ * @return bytes written, 0 for an unknown opcode
  */
-struct GameStartPacket
+inline uint8_t packet_encode(const Packet& packet, uint8_t* out)
 {
-  radio_id source;
-  millis_t timestamp;
-};
+  const uint8_t size = packet_size(packet.opcode);
+  memcpy(out, &packet, size);
+  return size;
+}
 
 /**
- * A packet to provide updates of the node's state
+ * Gets a packet out of a received frame without copying it
+ * Only the fields its opcode uses are valid, and the buffer has to have sizeof(Packet) bytes of slack past the
+ * frame in case anything copies the whole struct
+ * @param in start of the packet in the frame
+ * @param remaining bytes left in the frame
+ * @param size filled in with the packet's size
+ * @return the packet, or nullptr if the opcode is unknown or the packet is cut short
  */
-struct NodeStatePacket
+inline Packet* packet_decode(uint8_t* in, const uint8_t remaining, uint8_t& size)
 {
-  radio_id source;
-  millis_t timestamp;
-  uint8_t teamID;
-};
+  size = packet_size(static_cast<OpCode>(in[0]));
+  if (size == 0 || size > remaining)
+    return nullptr;
+  return reinterpret_cast<Packet*>(in);
+}
 
 #endif
@@ -0,0 +1,160 @@
+#ifndef PINGS_H_INCLUDE
+#define PINGS_H_INCLUDE
+
+#include <stdint.h>
+
+#include <Arduino.h>
+
+#include "bitset.h"
+#include "types.h"
+
+static const radio_id NO_PING = UINT8_MAX;
+
+/**
+ * Decides who to ping next
+ * Nodes that keep answering get pinged less and less often, a missed pong brings the rate straight back up to
+ * confirm whether they've gone. Once a node has missed a few it's treated as absent and backs off exponentially,
+ * so empty radio IDs cost next to nothing. Only one node is ever due at a time, the most overdue one
+ * @param TNodes number of radio IDs in the network
+ */
+template <uint8_t TNodes>
+class PingScheduler
+{
+public:
+  // fastest rate, for nodes we've just found or just lost a pong from
+  static const millis_t MIN_INTERVAL = 500;
+  // slowest rate for a node that's answering everything
+  static const millis_t MAX_INTERVAL = 4000;
+  // slowest rate for a node that isn't there
+  static const millis_t MAX_BACKOFF = 32000;
+  static_assert(MAX_BACKOFF * 2 <= UINT16_MAX, "intervals are 16 bits and get doubled before they're capped");
+  // missed pongs in a row before a node counts as absent
+  static const uint8_t ABSENT_MISSES = 3;
+
+  PingScheduler()
+  {
+    init(0, 0);
+  }
+
+  /**
+   * Resets the schedule, staggering everyone's first ping
+   * @param id our radio ID
+   * @param now current millis()
+   */
+  void init(const radio_id id, const millis_t now)
+  {
+    me = id;
+    for (uint8_t i = 0; i < TNodes; ++i)
+    {
+      Schedule& s = schedule[i];
+      s.interval = MIN_INTERVAL;
+      s.next = now + i * (MIN_INTERVAL / TNodes);
+      s.misses = 0;
+    }
+    outstanding.clear();
+  }
+
+  /**
+   * Gets the node to ping now, if any, and schedules its next one
+   * @param now current millis()
+   * @return radio ID to ping, or NO_PING
+   */
+  radio_id due(const millis_t now)
+  {
+    radio_id node = NO_PING;
+    for (uint8_t i = 0; i < TNodes; ++i)
+    {
+      if (i == me || before(now, schedule[i].next))
+        continue;
+      if (node == NO_PING || before(schedule[i].next, schedule[node].next))
+        node = i;
+    }
+    if (node == NO_PING)
+      return NO_PING;
+
+    Schedule& s = schedule[node];
+    if (outstanding.test(node))
+      miss(s);
+    outstanding.set(node);
+
+    // a little jitter keeps nodes that booted together from pinging in lock step
+    s.next = now + s.interval + random(s.interval / 8 + 1);
+    return node;
+  }
+
+  /**
+   * Records a pong
+   * @param node radio ID that answered
+   * @param now current millis()
+   */
+  void answered(const radio_id node, const millis_t now)
+  {
+    if (node >= TNodes)
+      return;
+
+    Schedule& s = schedule[node];
+    outstanding.reset(node);
+    if (s.misses > 0)
+    {
+      // it's back, or it was only a blip, either way keep a close eye on it for a bit
+      s.misses = 0;
+      s.interval = MIN_INTERVAL;
+      s.next = now + s.interval;
+      return;
+    }
+    s.interval += s.interval / 2;
+    if (s.interval > MAX_INTERVAL)
+      s.interval = MAX_INTERVAL;
+  }
+
+  inline bool absent(const radio_id node) const { return schedule[node].misses >= ABSENT_MISSES; }
+
+  /**
+   * Gets everyone that isn't absent, the IDs worth sending to directly, the rest only get their backed off pings
+   * @return mask of radio IDs, without us
+   */
+  node_mask_t present() const
+  {
+    node_mask_t mask = 0;
+    for (uint8_t i = 0; i < TNodes; ++i)
+    {
+      if (i != me && !absent(i))
+        mask |= static_cast<node_mask_t>(1) << i;
+    }
+    return mask;
+  }
+  inline millis_t interval(const radio_id node) const { return schedule[node].interval; }
+
+private:
+  /**
+   * Deadlines wrap with millis(), so compare them as a window
+   */
+  static inline bool before(const millis_t a, const millis_t b) { return static_cast<int32_t>(a - b) < 0; }
+
+  struct Schedule
+  {
+    millis_t next;
+    uint16_t interval; // ms, never more than MAX_BACKOFF
+    uint8_t misses;
+  };
+
+  void miss(Schedule& s)
+  {
+    if (s.misses < UINT8_MAX)
+      ++s.misses;
+    if (s.misses < ABSENT_MISSES)
+    {
+      s.interval = MIN_INTERVAL;
+      return;
+    }
+    s.interval *= 2;
+    if (s.interval > MAX_BACKOFF)
+      s.interval = MAX_BACKOFF;
+  }
+
+  radio_id me;
+  Schedule schedule[TNodes];
+  Bitset<TNodes> outstanding; // pinged, no pong yet
+};
+
+#endif
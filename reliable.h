@@ -0,0 +1,198 @@
+#ifndef RELIABLE_H_INCLUDE
+#define RELIABLE_H_INCLUDE
+
+#include <stdint.h>
+
+#include "types.h"
+#include "packets.h"
+
+static const uint8_t NO_MESSAGE = UINT8_MAX;
+
+/**
+ * Reliable broadcast
+ * Each message gets a sequence number and a mask of the peers it has to reach. Peers ACK every copy they get
+ * and missing peers are sent it again, on their own, until they ACK or we run out of retries
+ * Also remembers recent reliable packets we've received, so a retransmission is only acted on once
+ * The last slot is kept for control messages, so one never pushes a game message out or the other way round
+ * @param TMessages number of messages that can be in flight, one of them control
+ * @param TNodes number of radio IDs in the network
+ */
+template <uint8_t TMessages, uint8_t TNodes>
+class ReliableBroadcast
+{
+public:
+  static_assert(TNodes <= sizeof(node_mask_t) * 8, "node_mask_t is too small for TNodes");
+  static_assert(TMessages >= 2, "needs a slot for game messages and one for control");
+
+  typedef bool(*send_t)(Packet& packet, const radio_id target);
+
+  // first retry goes after this long, each one after that waits a little longer
+  static const millis_t RETRY_INTERVAL = 250;
+  static const uint8_t MAX_RETRIES = 5;
+
+  ReliableBroadcast() : seq(0), nextSeen(0)
+  {
+    for (uint8_t i = 0; i < TMessages; ++i)
+      messages[i].active = false;
+    for (uint8_t i = 0; i < SEEN_SIZE; ++i)
+      seen[i].seq = 0;
+  }
+
+  /**
+   * Starts tracking a message, the caller sends the first copy
+   * @param packet packet to send, its sequence number is filled in
+   * @param targets mask of radio IDs it has to reach
+   * @param now current millis()
+   * @param control true for network control, false for game messages
+   * @return handle for the message
+   */
+  uint8_t add(Packet& packet, const node_mask_t targets, const millis_t now, const bool control = false)
+  {
+    if (++seq == 0)
+      ++seq;
+    packet.seq = seq;
+
+    // a control message replaces the last one, a game message takes a free slot, otherwise the oldest goes
+    uint8_t slot = control ? CONTROL : 0;
+    for (uint8_t i = 0; i < CONTROL && !control; ++i)
+    {
+      if (!messages[i].active)
+      {
+        slot = i;
+        break;
+      }
+      if (static_cast<uint8_t>(seq - messages[i].packet.seq) > static_cast<uint8_t>(seq - messages[slot].packet.seq))
+        slot = i;
+    }
+
+    Message& message = messages[slot];
+    message.packet = packet;
+    message.targets = targets;
+    message.acked = 0;
+    message.retries = 0;
+    message.next = now + RETRY_INTERVAL;
+    message.active = targets != 0;
+    return slot;
+  }
+
+  /**
+   * Records an ACK
+   * @param from radio ID that acknowledged
+   * @param ackSeq sequence number it acknowledged
+   */
+  void ack(const radio_id from, const uint8_t ackSeq)
+  {
+    if (from >= TNodes)
+      return;
+
+    for (uint8_t i = 0; i < TMessages; ++i)
+    {
+      Message& message = messages[i];
+      if (message.packet.seq != ackSeq)
+        continue;
+      message.acked |= message.targets & bit(from);
+      if (message.acked == message.targets)
+        message.active = false;
+    }
+  }
+
+  /**
+   * Resends anything overdue to the peers that haven't acknowledged it
+   * @param now current millis()
+   * @param send function to send a packet to a single peer
+   */
+  void update(const millis_t now, send_t send)
+  {
+    for (uint8_t i = 0; i < TMessages; ++i)
+    {
+      Message& message = messages[i];
+      if (!message.active || static_cast<int32_t>(now - message.next) < 0)
+        continue;
+
+      if (message.retries == MAX_RETRIES)
+      {
+        message.active = false;
+        continue;
+      }
+      ++message.retries;
+      message.next = now + RETRY_INTERVAL * (message.retries + 1);
+
+      const node_mask_t missing = message.targets & ~message.acked;
+      for (uint8_t j = 0; j < TNodes; ++j)
+      {
+        if (missing & bit(j))
+        {
+          Packet copy = message.packet;
+          send(copy, j);
+        }
+      }
+    }
+  }
+
+  /**
+   * Checks whether a reliable packet is new to us
+   * Retransmissions are identical copies, so origin, sequence number and timestamp together spot them even when
+   * the origin has rebooted and started its numbering again. The low half of the timestamp is plenty for that
+   * @param packet received packet
+   * @return true the first time it's seen
+   */
+  bool fresh(const Packet& packet)
+  {
+    for (uint8_t i = 0; i < SEEN_SIZE; ++i)
+    {
+      const Seen& s = seen[i];
+      if (s.seq == packet.seq && s.origin == packet.origin && s.stamp == static_cast<uint16_t>(packet.timestamp))
+        return false;
+    }
+
+    Seen& s = seen[nextSeen];
+    s.origin = packet.origin;
+    s.seq = packet.seq;
+    s.stamp = static_cast<uint16_t>(packet.timestamp);
+    nextSeen = (nextSeen + 1) % SEEN_SIZE;
+    return true;
+  }
+
+  inline bool pending(const uint8_t handle) const { return messages[handle].active; }
+  inline uint8_t delivered(const uint8_t handle) const { return count(messages[handle].acked); }
+  inline uint8_t targets(const uint8_t handle) const { return count(messages[handle].targets); }
+
+private:
+  static const uint8_t SEEN_SIZE = 8;
+  static const uint8_t CONTROL = TMessages - 1;
+
+  static inline node_mask_t bit(const radio_id node) { return static_cast<node_mask_t>(1) << node; }
+
+  static uint8_t count(node_mask_t mask)
+  {
+    uint8_t c = 0;
+    for (; mask; mask &= mask - 1)
+      ++c;
+    return c;
+  }
+
+  struct Message
+  {
+    Packet packet;
+    node_mask_t targets;
+    node_mask_t acked;
+    uint8_t retries;
+    millis_t next;
+    bool active;
+  };
+
+  struct Seen
+  {
+    radio_id origin;
+    uint8_t seq; // 0 for an unused entry
+    uint16_t stamp; // low half of the timestamp
+  };
+
+  uint8_t seq;
+  Message messages[TMessages];
+
+  Seen seen[SEEN_SIZE];
+  uint8_t nextSeen;
+};
+
+#endif
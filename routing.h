@@ -0,0 +1,266 @@
+#ifndef ROUTING_H_INCLUDE
+#define ROUTING_H_INCLUDE
+
+#include <stdint.h>
+
+#include "types.h"
+
+static const radio_id NO_ROUTE = UINT8_MAX;
+
+/**
+ * Link state routing table
+ * Every node owns one row of the adjacency matrix, the mask of radios it can hear directly, along with a
+ * version it bumps whenever that row changes. Rows are swapped with GRAPH packets and the newest version of
+ * each wins, next hops are the first step of a breadth first search over the matrix.
+ * The same matrix gives a spanning tree for flooding, see tree()
+ * @param TNodes number of radio IDs in the network
+ */
+template <uint8_t TNodes>
+class Routing
+{
+public:
+  static_assert(TNodes <= sizeof(node_mask_t) * 8, "node_mask_t is too small for TNodes");
+
+  // how long a neighbour stays in the table without us hearing from it
+  static const millis_t NEIGHBOUR_TIMEOUT = 15000;
+
+  Routing() : me(0), links(0), dirty(true)
+  {
+    init(0);
+  }
+
+  /**
+   * Resets the tables for a (possibly new) radio ID
+   * @param id our radio ID
+   */
+  void init(const radio_id id)
+  {
+    me = id;
+    for (uint8_t i = 0; i < TNodes; ++i)
+    {
+      rows[i] = 0;
+      versions[i] = 0;
+      lastHeard[i] = 0;
+    }
+    dirty = true;
+  }
+
+  /**
+   * Records that a radio is in direct range, either we heard it or it acknowledged us
+   * @param node radio ID of the neighbour
+   * @param now current millis()
+   */
+  void heard(const radio_id node, const millis_t now)
+  {
+    if (node == me || node >= TNodes)
+      return;
+    lastHeard[node] = ticks(now);
+    setNeighbour(node, true);
+  }
+
+  /**
+   * Records that a radio failed to acknowledge us
+   * @param node radio ID of the neighbour
+   */
+  void lost(const radio_id node)
+  {
+    if (node == me || node >= TNodes)
+      return;
+    setNeighbour(node, false);
+  }
+
+  /**
+   * Drops neighbours we haven't heard from in a while
+   * @param now current millis()
+   */
+  void expire(const millis_t now)
+  {
+    for (uint8_t i = 0; i < TNodes; ++i)
+    {
+      if ((rows[me] & bit(i)) && static_cast<uint16_t>(ticks(now) - lastHeard[i]) > ticks(NEIGHBOUR_TIMEOUT))
+        setNeighbour(i, false);
+    }
+  }
+
+  /**
+   * Takes any rows from a page of another node's matrix that are newer than ours
+   * @param first radio ID of the first row
+   * @param count rows in the page
+   * @param theirVersions row versions as sent in a GRAPH packet
+   * @param theirRows adjacency rows as sent in a GRAPH packet
+   */
+  void merge(const radio_id first, const uint8_t count, const version_t* theirVersions, const node_mask_t* theirRows)
+  {
+    for (uint8_t j = 0; j < count && first + j < TNodes; ++j)
+    {
+      const uint8_t i = first + j;
+      if (!newer(theirVersions[j], versions[i]))
+        continue;
+
+      // someone remembers our row from before a reset, jump past it so our current row wins
+      if (i == me)
+      {
+        versions[me] = theirVersions[j] + 1;
+        continue;
+      }
+
+      versions[i] = theirVersions[j];
+      if (rows[i] != theirRows[j])
+      {
+        rows[i] = theirRows[j];
+        dirty = true;
+      }
+    }
+  }
+
+  /**
+   * Copies a page of the matrix out for a GRAPH packet, rows past the last radio ID come out empty
+   * @param first radio ID of the first row
+   * @param count rows in the page
+   * @param ourVersions buffer of count row versions
+   * @param ourRows buffer of count adjacency rows
+   */
+  void copy(const radio_id first, const uint8_t count, version_t* ourVersions, node_mask_t* ourRows) const
+  {
+    for (uint8_t j = 0; j < count; ++j)
+    {
+      const uint8_t i = first + j;
+      ourVersions[j] = i < TNodes ? versions[i] : 0;
+      ourRows[j] = i < TNodes ? rows[i] : 0;
+    }
+  }
+
+  /**
+   * Gets the radio to hand a packet to so it reaches the target along the shortest path
+   * @param target final destination
+   * @return radio ID of the next hop, or NO_ROUTE if it's unreachable
+   */
+  radio_id nextHop(const radio_id target)
+  {
+    if (target >= TNodes)
+      return NO_ROUTE;
+    if (dirty)
+      rebuild();
+    return hops[target];
+  }
+
+  /**
+   * Gets our edges in the flooding tree
+   * The tree is a breadth first search over the links both ends hear, from the lowest radio ID we can reach,
+   * with lower IDs expanded first, so every node with the same matrix builds the same tree and a packet passed
+   * along its edges reaches each of them once
+   * @return mask of radio IDs, our parent and children, none if we aren't in the tree
+   */
+  node_mask_t tree()
+  {
+    if (dirty)
+      rebuild();
+    return links;
+  }
+
+  inline node_mask_t neighbours() const { return rows[me]; }
+  inline version_t version(const radio_id node) const { return versions[node]; }
+  inline bool neighbour(const radio_id node) const { return rows[me] & bit(node); }
+
+private:
+  static inline node_mask_t bit(const radio_id node) { return static_cast<node_mask_t>(1) << node; }
+
+  /**
+   * When we last heard a neighbour only matters to the nearest quarter second or so, and only for the 15 s it
+   * stays a neighbour, so 16 bits of it never go round in time to matter
+   */
+  static inline uint16_t ticks(const millis_t ms) { return ms >> 8; }
+
+  void setNeighbour(const radio_id node, const bool up)
+  {
+    const node_mask_t row = up ? rows[me] | bit(node) : rows[me] & ~bit(node);
+    if (row == rows[me])
+      return;
+    rows[me] = row;
+    ++versions[me];
+    dirty = true;
+  }
+
+  /**
+   * Breadth first search from us, each node reached inherits the first hop of the node that reached it
+   * Lower IDs are expanded first so every node picks the same path for equal length routes
+   */
+  void rebuild()
+  {
+    for (uint8_t i = 0; i < TNodes; ++i)
+      hops[i] = NO_ROUTE;
+    hops[me] = me;
+
+    node_mask_t visited = bit(me);
+    node_mask_t frontier = bit(me);
+    while (frontier)
+    {
+      node_mask_t next = 0;
+      for (uint8_t u = 0; u < TNodes; ++u)
+      {
+        if ((frontier & bit(u)) == 0)
+          continue;
+        for (uint8_t v = 0; v < TNodes; ++v)
+        {
+          if ((rows[u] & bit(v)) == 0 || (visited & bit(v)))
+            continue;
+          hops[v] = u == me ? v : hops[u];
+          visited |= bit(v);
+          next |= bit(v);
+        }
+      }
+      frontier = next;
+    }
+    buildTree(visited);
+    dirty = false;
+  }
+
+  /**
+   * Breadth first search from the root over the links both ends agree on, keeping whoever reached us and whoever
+   * we reached
+   * @param reachable mask of radio IDs we have a route to, us included
+   */
+  void buildTree(const node_mask_t reachable)
+  {
+    uint8_t root = 0;
+    while ((reachable & bit(root)) == 0)
+      ++root;
+
+    links = 0;
+    node_mask_t visited = bit(root);
+    node_mask_t frontier = bit(root);
+    while (frontier)
+    {
+      node_mask_t next = 0;
+      for (uint8_t u = 0; u < TNodes; ++u)
+      {
+        if ((frontier & bit(u)) == 0)
+          continue;
+        for (uint8_t v = 0; v < TNodes; ++v)
+        {
+          if ((rows[u] & bit(v)) == 0 || (rows[v] & bit(u)) == 0 || (visited & bit(v)))
+            continue;
+          if (u == me)
+            links |= bit(v);
+          else if (v == me)
+            links |= bit(u);
+          visited |= bit(v);
+          next |= bit(v);
+        }
+      }
+      frontier = next;
+    }
+  }
+
+  radio_id me;
+
+  node_mask_t rows[TNodes];
+  version_t versions[TNodes];
+  uint16_t lastHeard[TNodes]; // ticks()
+
+  radio_id hops[TNodes];
+  node_mask_t links; // our edges in the flooding tree
+  bool dirty;
+};
+
+#endif
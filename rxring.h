@@ -0,0 +1,102 @@
+#ifndef RXRING_H_INCLUDE
+#define RXRING_H_INCLUDE
+
+#include <stdint.h>
+
+#include <Arduino.h>
+
+#include "packets.h"
+
+/**
+ * Received frames, filled by the radio interrupt and emptied by network()
+ * One producer and one consumer, each index only ever written by one side and both a single byte, so neither
+ * side needs to turn interrupts off. The radio's own FIFO is only three frames deep, this and the FIFO together
+ * let a burst wait out a TFT redraw or an RFID read, frames that don't fit here are left in the FIFO
+ * @param TCapacity number of frames, a power of two
+ */
+template <uint8_t TCapacity>
+class RxRing
+{
+public:
+  static_assert((TCapacity & (TCapacity - 1)) == 0, "TCapacity must be a power of two");
+
+  RxRing() : head(0), tail(0), overflows(0)
+  {
+  }
+
+  /**
+   * Gets the slot the next frame goes in, interrupt side
+   * @return buffer of MAX_FRAME_SIZE bytes, or nullptr if the ring is full
+   */
+  uint8_t* claim()
+  {
+    if (static_cast<uint8_t>(head - tail) == TCapacity)
+    {
+      if (overflows < UINT16_MAX)
+        ++overflows;
+      return nullptr;
+    }
+    return frames[head & (TCapacity - 1)].data;
+  }
+
+  /**
+   * Hands the claimed slot over to the consumer, interrupt side
+   * @param length bytes in the frame
+   */
+  void commit(const uint8_t length)
+  {
+    frames[head & (TCapacity - 1)].length = length;
+    barrier();
+    ++head;
+  }
+
+  /**
+   * Takes the oldest frame out, loop side
+   * @param data buffer of MAX_FRAME_SIZE bytes
+   * @return bytes in the frame, or 0 if there wasn't one
+   */
+  uint8_t pop(uint8_t* data)
+  {
+    if (head == tail)
+      return 0;
+    barrier();
+    const Frame& frame = frames[tail & (TCapacity - 1)];
+    const uint8_t length = frame.length;
+    memcpy(data, frame.data, length);
+    barrier();
+    ++tail;
+    return length;
+  }
+
+  /**
+   * Gets how many times a frame found the ring full and had to stay in the radio's FIFO
+   * @return overflow count
+   */
+  uint16_t getOverflows() const
+  {
+    // two bytes, so it could change half way through reading it
+    noInterrupts();
+    const uint16_t count = overflows;
+    interrupts();
+    return count;
+  }
+
+private:
+  /**
+   * Stops the compiler moving frame reads and writes past the index updates
+   */
+  static inline void barrier() { __asm__ __volatile__("" ::: "memory"); }
+
+  struct Frame
+  {
+    uint8_t data[MAX_FRAME_SIZE];
+    uint8_t length;
+  };
+
+  Frame frames[TCapacity];
+  volatile uint8_t head; // next slot to fill, only the interrupt writes it
+  volatile uint8_t tail; // next slot to empty, only the loop writes it
+  volatile uint16_t overflows;
+};
+
+#endif
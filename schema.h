@@ -0,0 +1,80 @@
+#ifndef SCHEMA_H_INCLUDE
+#define SCHEMA_H_INCLUDE
+
+#include <stdint.h>
+
+/**
+ * Compile time message layouts
+ * A message is a list of fields of a packed struct. The schema checks at compile time that the fields follow
+ * each other with no gaps from the start of the struct, so the wire format of a message is just the first `size`
+ * bytes of the struct. Encoding is one copy and a received message can be used where it lies
+ */
+
+/**
+ * One field of a message
+ * @param TOffset offsetof the field in its struct
+ * @param TSize sizeof the field
+ */
+template <uint8_t TOffset, uint8_t TSize>
+struct Field
+{
+  static const uint8_t offset = TOffset;
+  static const uint8_t size = TSize;
+};
+
+/**
+ * A run of fields, each one has to start where the one before it ends
+ * @param TStart where the first field should be
+ * @param TFields the fields, in wire order
+ */
+template <uint8_t TStart, typename... TFields>
+struct Schema;
+
+template <uint8_t TStart>
+struct Schema<TStart>
+{
+  static const uint8_t end = TStart;
+};
+
+template <uint8_t TStart, typename TField, typename... TRest>
+struct Schema<TStart, TField, TRest...>
+{
+  static_assert(TField::offset == TStart, "message fields have to be in struct order with nothing between them");
+  static const uint8_t end = Schema<TStart + TField::size, TRest...>::end;
+};
+
+/**
+ * Looks a message up by its ID at run time
+ * Each message type needs `id` and `size` members
+ * @param TMessages every message type
+ */
+template <typename... TMessages>
+struct Codec;
+
+template <>
+struct Codec<>
+{
+  static const uint8_t count = 0;
+
+  template <typename TId>
+  static inline uint8_t size(const TId) { return 0; }
+};
+
+template <typename TMessage, typename... TRest>
+struct Codec<TMessage, TRest...>
+{
+  static const uint8_t count = 1 + Codec<TRest...>::count;
+
+  /**
+   * Gets the wire size of a message
+   * @param id message ID
+   * @return size in bytes, or 0 for an unknown ID
+   */
+  template <typename TId>
+  static inline uint8_t size(const TId id)
+  {
+    return id == TMessage::id ? TMessage::size : Codec<TRest...>::size(id);
+  }
+};
+
+#endif
@@ -0,0 +1,338 @@
+#include "board.h"
+
+#include <Arduino.h>
+#include <EEPROM.h>
+#include <NRFLite.h>
+#include <SPI.h>
+
+/**
+ * The simulated box
+ * Time only moves when the host says so or the node uses some. A node runs a whole loop() at once, reading the
+ * clock and calling delay() push its CPU on past global time, and the host won't run it again until global
+ * time has caught up. Every clock read costs a little, so code spinning on millis() still gets somewhere
+ */
+
+HardwareSerial Serial;
+SPIClass SPI;
+EEPROMClass EEPROM;
+
+namespace
+{
+  const uint32_t CLOCK_READ_US = 2;
+  // the radio's IRQ line, wired like the boxes, see PIN_RADIO_IRQ in main.cpp
+  const uint8_t RADIO_IRQ_PIN = 2;
+  const uint8_t RX_FIFO_DEPTH = 3;
+  const uint8_t MAX_FRAME = 32;
+
+  const SimHost* host = nullptr;
+  SimNodeConfig config;
+  uint64_t cpu = 0; // global time the node's CPU has got to, us
+  uint32_t rng = 1;
+
+  // the radio
+  struct Frame
+  {
+    uint8_t data[MAX_FRAME];
+    uint8_t length;
+  };
+  Frame fifo[RX_FIFO_DEPTH];
+  uint8_t fifoHead = 0;
+  uint8_t fifoCount = 0;
+  bool txOk = false;
+  bool txFail = false;
+  void (*isr)() = nullptr;
+
+  /**
+   * Gets the node's own clock, its crystal runs a little fast or slow and it booted at some other time
+   */
+  uint64_t local()
+  {
+    cpu += CLOCK_READ_US;
+    const int64_t skew = static_cast<int64_t>(cpu) * config.drift / 1000000;
+    return cpu + skew + config.offset;
+  }
+
+  inline bool irqPending()
+  {
+    return fifoCount > 0 || txOk || txFail;
+  }
+
+  void raise()
+  {
+    if (isr != nullptr && irqPending())
+      isr();
+  }
+};
+
+namespace board
+{
+  void attach(const SimHost* h, const SimNodeConfig* c)
+  {
+    host = h;
+    config = *c;
+    rng = c->seed ? c->seed : 1;
+  }
+
+  void wake(const uint64_t now)
+  {
+    if (now > cpu)
+      cpu = now;
+  }
+
+  uint64_t clock()
+  {
+    return cpu;
+  }
+
+  uint32_t millisAt(const uint64_t now)
+  {
+    const int64_t skew = static_cast<int64_t>(now) * config.drift / 1000000;
+    return (now + skew + config.offset) / 1000;
+  }
+
+  void receive(const uint8_t* data, const uint8_t length)
+  {
+    // the radio drops anything that arrives with its FIFO full
+    if (fifoCount == RX_FIFO_DEPTH)
+      return;
+    Frame& frame = fifo[(fifoHead + fifoCount) % RX_FIFO_DEPTH];
+    memcpy(frame.data, data, length);
+    frame.length = length;
+    ++fifoCount;
+    raise();
+  }
+
+  uint8_t room()
+  {
+    return RX_FIFO_DEPTH - fifoCount;
+  }
+
+  void sent(const bool ok)
+  {
+    txOk = ok;
+    txFail = !ok;
+    raise();
+  }
+};
+
+// Arduino core
+
+uint32_t millis()
+{
+  return local() / 1000;
+}
+
+uint32_t micros()
+{
+  return local();
+}
+
+void delay(unsigned long ms)
+{
+  cpu += static_cast<uint64_t>(ms) * 1000;
+}
+
+void delayMicroseconds(unsigned int us)
+{
+  cpu += us;
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {}
+void digitalWrite(uint8_t pin, uint8_t value) {}
+
+int digitalRead(uint8_t pin)
+{
+  // the IRQ line is active low, and the buttons are never pressed
+  if (pin == RADIO_IRQ_PIN)
+    return irqPending() ? LOW : HIGH;
+  return LOW;
+}
+
+int analogRead(uint8_t pin)
+{
+  return 0;
+}
+
+void tone(uint8_t pin, unsigned int frequency, unsigned long duration) {}
+void noTone(uint8_t pin) {}
+
+// avr-libc's random() and the Arduino core's wrappers round it, so a replay makes the same choices a box did
+// from the same seed, see capture.h
+
+long random(long max)
+{
+  if (max == 0)
+    return 0;
+  // Park and Miller's minimal standard generator, worked out the way avr-libc does it
+  int32_t x = rng == 0 ? 123459876 : static_cast<int32_t>(rng);
+  const int32_t hi = x / 127773;
+  const int32_t lo = x % 127773;
+  x = 16807 * lo - 2836 * hi;
+  if (x < 0)
+    x += 0x7FFFFFFF;
+  rng = x;
+  return static_cast<uint32_t>(x) % max;
+}
+
+long random(long min, long max)
+{
+  return min >= max ? min : min + random(max - min);
+}
+
+void randomSeed(unsigned long seed)
+{
+  if (seed != 0)
+    rng = seed;
+}
+
+void attachInterrupt(uint8_t interrupt, void (*handler)(), int mode)
+{
+  isr = handler;
+}
+
+void detachInterrupt(uint8_t interrupt)
+{
+  isr = nullptr;
+}
+
+// the host only delivers between loops, so nothing can interrupt the sketch mid way
+void noInterrupts() {}
+void interrupts() {}
+
+// Print
+
+size_t Print::write(const uint8_t* buffer, size_t size)
+{
+  for (size_t i = 0; i < size; ++i)
+    write(buffer[i]);
+  return size;
+}
+
+size_t Print::print(const char* s)
+{
+  return write(reinterpret_cast<const uint8_t*>(s), strlen(s));
+}
+
+size_t Print::print(char c)
+{
+  return write(static_cast<uint8_t>(c));
+}
+
+size_t Print::print(int n, int base)
+{
+  return print(static_cast<long>(n), base);
+}
+
+size_t Print::print(unsigned n, int base)
+{
+  return print(static_cast<unsigned long>(n), base);
+}
+
+size_t Print::print(long n, int base)
+{
+  char s[24];
+  snprintf(s, sizeof(s), base == HEX ? "%lX" : "%ld", n);
+  return print(s);
+}
+
+size_t Print::print(unsigned long n, int base)
+{
+  char s[24];
+  snprintf(s, sizeof(s), base == HEX ? "%lX" : "%lu", n);
+  return print(s);
+}
+
+size_t Print::print(double n, int digits)
+{
+  char s[32];
+  snprintf(s, sizeof(s), "%.*f", digits, n);
+  return print(s);
+}
+
+size_t Print::println()
+{
+  return write('\r') + write('\n');
+}
+
+size_t Print::println(const char* s) { return print(s) + println(); }
+size_t Print::println(char c) { return print(c) + println(); }
+size_t Print::println(int n, int base) { return print(n, base) + println(); }
+size_t Print::println(unsigned n, int base) { return print(n, base) + println(); }
+size_t Print::println(long n, int base) { return print(n, base) + println(); }
+size_t Print::println(unsigned long n, int base) { return print(n, base) + println(); }
+size_t Print::println(double n, int digits) { return print(n, digits) + println(); }
+
+size_t HardwareSerial::write(uint8_t c)
+{
+  if (host != nullptr && host->serial != nullptr)
+    host->serial(host->context, config.index, c);
+  return 1;
+}
+
+// NRFLite
+
+uint8_t NRFLite::init(uint8_t radioId, uint8_t cePin, uint8_t csnPin, Bitrates bitrate, uint8_t channel,
+  uint8_t callSpiBegin)
+{
+  fifoCount = 0;
+  txOk = false;
+  txFail = false;
+  host->tune(host->context, config.index, radioId, channel, bitrate);
+  return 1;
+}
+
+uint8_t NRFLite::hasData(uint8_t usingInterrupts)
+{
+  return fifoCount > 0 ? fifo[fifoHead].length : 0;
+}
+
+void NRFLite::readData(void* data)
+{
+  if (fifoCount == 0)
+    return;
+  memcpy(data, fifo[fifoHead].data, fifo[fifoHead].length);
+  discardData(0);
+}
+
+void NRFLite::discardData(uint8_t unexpectedDataLength)
+{
+  if (fifoCount == 0)
+    return;
+  fifoHead = (fifoHead + 1) % RX_FIFO_DEPTH;
+  --fifoCount;
+}
+
+uint8_t NRFLite::send(uint8_t toRadioId, void* data, uint8_t length, SendType sendType)
+{
+  host->listen(host->context, config.index, true);
+  return host->transmit(host->context, config.index, toRadioId, static_cast<const uint8_t*>(data), length,
+    sendType == REQUIRE_ACK, cpu, false);
+}
+
+void NRFLite::startSend(uint8_t toRadioId, void* data, uint8_t length, SendType sendType)
+{
+  txOk = false;
+  txFail = false;
+  host->listen(host->context, config.index, true);
+  host->transmit(host->context, config.index, toRadioId, static_cast<const uint8_t*>(data), length,
+    sendType == REQUIRE_ACK, cpu, true);
+}
+
+void NRFLite::startRx()
+{
+  host->listen(host->context, config.index, true);
+}
+
+void NRFLite::powerDown()
+{
+  host->listen(host->context, config.index, false);
+}
+
+void NRFLite::whenInterrupts(uint8_t& ok, uint8_t& fail, uint8_t& rxReady)
+{
+  ok = txOk;
+  fail = txFail;
+  rxReady = fifoCount > 0;
+  txOk = false;
+  txFail = false;
+}
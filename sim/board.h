@@ -0,0 +1,42 @@
+#ifndef BOARD_H_INCLUDE
+#define BOARD_H_INCLUDE
+
+#include <stdint.h>
+
+#include "sim.h"
+
+/**
+ * The simulated box a node runs on, see board.cpp
+ */
+namespace board
+{
+  void attach(const SimHost* host, const SimNodeConfig* config);
+
+  /**
+   * Catches the node's clock up with global time, it may already be ahead if it was busy
+   * @param now global time, us
+   */
+  void wake(const uint64_t now);
+
+  /**
+   * @return where the node's CPU has got to in global time, us
+   */
+  uint64_t clock();
+
+  /**
+   * Reads what the node's millis() says at a global time, without using any of its CPU
+   * @param now global time, us
+   */
+  uint32_t millisAt(const uint64_t now);
+
+  void receive(const uint8_t* data, const uint8_t length);
+
+  /**
+   * @return frames the radio's RX FIFO can take before it starts dropping them
+   */
+  uint8_t room();
+
+  void sent(const bool ok);
+};
+
+#endif
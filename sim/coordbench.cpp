@@ -0,0 +1,291 @@
+/**
+ * Packets per claim with and without a coordinator, and how long failover takes
+ * The simulator runs the sketch itself but only up to MAX_NODES, so this runs the real Coordinator at 8 and 32
+ * nodes over a model of the network: every node hears every other, nothing is lost and every packet arrives the
+ * millisecond it's sent. Claims come from random nodes at random times, at a few rates for the whole game.
+ * - broadcast, every claim goes from its node to everyone else
+ * - coordinator, a claim goes to the coordinator, which passes on whatever has come in each WINDOW, with claims
+ *   sharing frames the way TxQueue packs them. The lease renewals are counted against the claims too, riding
+ *   along with the coordinator's pings and pongs, which go to each node every PING_INTERVAL each way, as they do
+ *   once the links have settled, or on their own for whoever none of those went to since the last renewal
+ * Packets are claims and leases as each destination gets them, frames are what goes on the air.
+ * Then it kills the coordinator and reports how long until everyone has moved on to the next one, with the dead
+ * one still looking alive to the failure detectors, which take far longer to give up on it. The dead node comes
+ * back later, and takes over again
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../types.h"
+#include "../packets.h"
+#include "../coordinator.h"
+
+namespace
+{
+  const uint32_t DURATION = 600000; // ms of game per rate
+  const double RATES[] = {0.2, 2, 20}; // claims a second, the simulator's default game is about 0.2
+  // CLAIMs a frame holds, as TxQueue packs them without a MAC trailer
+  const uint8_t PER_FRAME = (MAX_FRAME_SIZE - FRAME_HEADER_SIZE) / Messages::size(OpCode::CLAIM);
+
+  const uint32_t PING_INTERVAL = 4000; // PingScheduler's longest
+
+  const uint32_t KILL_AT = 60000; // when the coordinator dies in the failover run
+  const uint32_t REVIVE_AT = 120000; // and comes back
+  const uint32_t FAILOVER_RUN = 180000;
+
+  struct Count
+  {
+    uint64_t claims = 0;
+    uint64_t packets = 0;
+    uint64_t frames = 0;
+    uint64_t leaseFrames = 0;
+  };
+
+  double uniform()
+  {
+    return (rand() + 1.0) / (RAND_MAX + 2.0);
+  }
+
+  /**
+   * Model of the network of coordinators
+   * @param TNodes number of nodes
+   */
+  template <uint8_t TNodes>
+  class Network
+  {
+  public:
+    typedef Coordinator<TNodes> Node;
+
+    Network()
+    {
+      for (uint8_t i = 0; i < TNodes; ++i)
+      {
+        nodes[i].init(i);
+        up[i] = true;
+        live.set(i);
+        for (uint8_t j = 0; j < TNodes; ++j)
+          phase[i][j] = rand() % PING_INTERVAL;
+      }
+    }
+
+    /**
+     * Runs every node's update for a millisecond
+     */
+    void step(const millis_t now, Count& count)
+    {
+      for (radio_id i = 0; i < TNodes; ++i)
+      {
+        if (!up[i])
+          continue;
+        typename Node::Set late;
+        if (nodes[i].update(now, live, late))
+        {
+          for (radio_id j = 0; j < TNodes; ++j)
+          {
+            if (!late.test(j) || !up[j])
+              continue;
+            ++count.packets;
+            ++count.leaseFrames;
+            nodes[j].leased(i, now);
+          }
+        }
+
+        // our ping to them, or our pong to theirs
+        for (radio_id j = 0; j < TNodes; ++j)
+        {
+          if (j == i || !up[j])
+            continue;
+          const millis_t tick = now % PING_INTERVAL;
+          if ((tick == phase[i][j] || tick == phase[j][i]) && nodes[i].owes(j))
+          {
+            ++count.packets;
+            nodes[j].leased(i, now);
+          }
+        }
+
+        typename Node::Set claimed;
+        if (nodes[i].flush(now, claimed))
+        {
+          const uint8_t k = claimed.count();
+          // on its own it skips whoever made it, several go to everyone and share frames
+          const uint8_t destinations = k == 1 ? reached(i) - 1 : reached(i);
+          count.packets += k * destinations;
+          count.frames += (k + PER_FRAME - 1) / PER_FRAME * destinations;
+        }
+      }
+    }
+
+    /**
+     * A node's claim, sent the way share_claim() does
+     */
+    void claim(const radio_id node, const millis_t now, Count& count, const bool coordinated)
+    {
+      ++count.claims;
+      Node& n = nodes[node];
+      const radio_id holder = coordinated ? n.current(now) : NO_ROUTE;
+      if (holder == node)
+      {
+        n.changed(node, now);
+        return;
+      }
+      if (holder != NO_ROUTE)
+      {
+        ++count.packets;
+        ++count.frames;
+        n.handOff();
+        if (up[holder])
+        {
+          n.delivered(holder);
+          // handle_claim only passes on what's handed to it while it holds the lease
+          if (nodes[holder].current(now) == holder)
+            nodes[holder].changed(node, now);
+          return;
+        }
+        n.lost(holder);
+        if (!n.orphaned(now))
+          return;
+      }
+      count.packets += reached(node);
+      count.frames += reached(node);
+    }
+
+    void kill(const radio_id node)
+    {
+      up[node] = false;
+    }
+
+    void revive(const radio_id node)
+    {
+      up[node] = true;
+      nodes[node].init(node);
+    }
+
+    /**
+     * Gets who everyone that's up follows, if they agree
+     * @return radio ID, or NO_ROUTE if they don't all follow the same node
+     */
+    radio_id agreed(const millis_t now) const
+    {
+      radio_id holder = NO_ROUTE;
+      for (radio_id i = 0; i < TNodes; ++i)
+      {
+        if (!up[i])
+          continue;
+        const radio_id h = nodes[i].current(now);
+        if (h == NO_ROUTE || (holder != NO_ROUTE && h != holder))
+          return NO_ROUTE;
+        holder = h;
+      }
+      return holder;
+    }
+
+  private:
+    uint8_t reached(const radio_id from) const
+    {
+      uint8_t others = 0;
+      for (radio_id j = 0; j < TNodes; ++j)
+      {
+        if (j != from && up[j])
+          ++others;
+      }
+      return others;
+    }
+
+    Node nodes[TNodes];
+    bool up[TNodes];
+    millis_t phase[TNodes][TNodes]; // when in PING_INTERVAL each pings the other
+    typename Node::Set live; // what the failure detectors say, they haven't noticed anyone die in this run
+  };
+
+  /**
+   * Runs a game's worth of claims at a rate
+   * @return what it cost
+   */
+  template <uint8_t TNodes>
+  Count game(const double rate, const bool coordinated)
+  {
+    Network<TNodes> network;
+    Count count;
+    millis_t next = 1000 + static_cast<millis_t>(-log(uniform()) * 1000 / rate);
+    for (millis_t now = 1; now < DURATION; ++now)
+    {
+      if (coordinated)
+        network.step(now, count);
+      while (now == next)
+      {
+        network.claim(rand() % TNodes, now, count, coordinated);
+        next += 1 + static_cast<millis_t>(-log(uniform()) * 1000 / rate);
+      }
+    }
+    return count;
+  }
+
+  template <uint8_t TNodes>
+  void claims()
+  {
+    for (const double rate : RATES)
+    {
+      srand(1);
+      const Count broadcast = game<TNodes>(rate, false);
+      srand(1);
+      const Count coordinated = game<TNodes>(rate, true);
+      const double claims = coordinated.claims;
+      printf("%5u %8.1f %9.1f %10.1f %7.1f %7.1f\n", TNodes, rate,
+        static_cast<double>(broadcast.frames) / broadcast.claims,
+        coordinated.packets / claims,
+        (coordinated.frames + coordinated.leaseFrames) / claims,
+        coordinated.leaseFrames / claims);
+    }
+  }
+
+  template <uint8_t TNodes>
+  void failover()
+  {
+    Network<TNodes> network;
+    Count count;
+    radio_id following = NO_ROUTE;
+    millis_t killed = 0;
+    for (millis_t now = 1; now < FAILOVER_RUN; ++now)
+    {
+      if (now == KILL_AT)
+      {
+        network.kill(0);
+        killed = now;
+      }
+      if (now == REVIVE_AT)
+      {
+        network.revive(0);
+        killed = now;
+      }
+      network.step(now, count);
+
+      const radio_id agreed = network.agreed(now);
+      if (agreed == NO_ROUTE || agreed == following)
+        continue;
+      if (following == NO_ROUTE)
+        printf("%5u  everyone follows %u at %.1fs\n", TNodes, agreed, now / 1000.0);
+      else
+        printf("%5u  everyone follows %u %ums after %s\n", TNodes, agreed, now - killed,
+          killed == REVIVE_AT ? "0 came back" : "0 died");
+      following = agreed;
+    }
+    printf("%5u  bound %ums\n", TNodes, Coordinator<TNodes>::LEASE + 2 * Coordinator<TNodes>::RENEW);
+  }
+};
+
+int main()
+{
+  printf("per claim, lease renewals included, %us of game, a broadcast is a frame a packet\n", DURATION / 1000);
+  printf("               broadcast  coordinator\n");
+  printf("nodes claims/s   packets    packets  frames   lease\n");
+  claims<8>();
+  claims<32>();
+
+  printf("\nfailover, the coordinator dies at %us and comes back at %us\n", KILL_AT / 1000, REVIVE_AT / 1000);
+  failover<8>();
+  failover<32>();
+  return 0;
+}
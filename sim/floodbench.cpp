@@ -0,0 +1,269 @@
+/**
+ * Deliveries per network-wide message, sent the way broadcast() did and flooded along the spanning tree
+ * Runs the real Routing for 8 nodes over the simulator's topologies, random ones averaged over a few hundred
+ * draws, with every node's matrix settled. A delivery is a packet handed to a radio, one hop, and a message has
+ * to make at least one to every other node.
+ * - broadcast, one copy to each neighbour and one along the route to everyone further away
+ * - flood, from every node to its tree edges but the one it came in on, the first time it hears the message
+ * Then one link on the tree goes down in the random topologies, its two ends notice and nobody else has yet, and
+ * it floods again over the trees as they are. Anyone that leaves out gets the message from the reliable retries,
+ * along the route from whoever sent it, and those deliveries are counted too. ACKs cost the same either way and
+ * are left out
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../types.h"
+#include "../routing.h"
+
+namespace
+{
+  const uint8_t NODES = 8;
+  const uint16_t DRAWS = 500;
+  const double DENSITY = 0.5; // the simulator's default for random
+
+  typedef Routing<NODES> Table;
+
+  struct Count
+  {
+    uint32_t messages = 0;
+    uint32_t broadcast = 0;
+    uint32_t flood = 0;
+    uint32_t missed = 0;
+    uint32_t retries = 0;
+  };
+
+  inline node_mask_t bit(const radio_id node) { return static_cast<node_mask_t>(1) << node; }
+
+  uint8_t bits(node_mask_t mask)
+  {
+    uint8_t n = 0;
+    for (; mask; mask &= mask - 1)
+      ++n;
+    return n;
+  }
+
+  /**
+   * Links as the simulator lays them out
+   * @param topology full, line, ring, star or random
+   * @param links filled in with each node's neighbours
+   */
+  void layout(const char* topology, node_mask_t* links)
+  {
+    memset(links, 0, NODES * sizeof(node_mask_t));
+    for (uint8_t a = 0; a < NODES; ++a)
+    {
+      for (uint8_t b = a + 1; b < NODES; ++b)
+      {
+        bool link = false;
+        if (strcmp(topology, "full") == 0)
+          link = true;
+        else if (strcmp(topology, "line") == 0)
+          link = b == a + 1;
+        else if (strcmp(topology, "ring") == 0)
+          link = b == a + 1 || (a == 0 && b == NODES - 1);
+        else if (strcmp(topology, "star") == 0)
+          link = a == 0;
+        else
+          link = b == a + 1 || rand() < DENSITY * RAND_MAX;
+        if (link)
+        {
+          links[a] |= bit(b);
+          links[b] |= bit(a);
+        }
+      }
+    }
+  }
+
+  /**
+   * Hops between two nodes over the links that are up
+   * @return hop count, or NODES if there's no path
+   */
+  uint8_t distance(const node_mask_t* links, const radio_id from, const radio_id to)
+  {
+    node_mask_t visited = bit(from);
+    node_mask_t frontier = bit(from);
+    for (uint8_t hops = 0; frontier; ++hops)
+    {
+      if (frontier & bit(to))
+        return hops;
+      node_mask_t next = 0;
+      for (uint8_t u = 0; u < NODES; ++u)
+      {
+        if (frontier & bit(u))
+          next |= links[u];
+      }
+      frontier = next & ~visited;
+      visited |= next;
+    }
+    return NODES;
+  }
+
+  /**
+   * Every node hears its neighbours and gets everyone's rows
+   */
+  void settle(Table* tables, const node_mask_t* links)
+  {
+    for (radio_id i = 0; i < NODES; ++i)
+    {
+      tables[i].init(i);
+      for (radio_id j = 0; j < NODES; ++j)
+      {
+        if (links[i] & bit(j))
+          tables[i].heard(j, 0);
+      }
+    }
+    version_t versions[NODES];
+    node_mask_t rows[NODES];
+    for (radio_id i = 0; i < NODES; ++i)
+    {
+      tables[i].copy(0, NODES, versions, rows);
+      for (radio_id j = 0; j < NODES; ++j)
+        tables[j].merge(0, NODES, versions, rows);
+    }
+  }
+
+  /**
+   * Sends a message from a node the way broadcast() did
+   * @return deliveries
+   */
+  uint32_t broadcast(Table* tables, const node_mask_t* links, const radio_id origin)
+  {
+    uint32_t deliveries = bits(tables[origin].neighbours());
+    for (radio_id i = 0; i < NODES; ++i)
+    {
+      if (i != origin && !tables[origin].neighbour(i) && tables[origin].nextHop(i) != NO_ROUTE)
+        deliveries += distance(links, origin, i);
+    }
+    return deliveries;
+  }
+
+  /**
+   * Floods a message from a node the way flood() does, over the links that are actually up
+   * @return mask of nodes it reached
+   */
+  node_mask_t flood(Table* tables, const node_mask_t* links, const radio_id origin, uint32_t& deliveries)
+  {
+    radio_id queue[NODES];
+    radio_id sources[NODES];
+    uint8_t head = 0;
+    uint8_t tail = 0;
+    node_mask_t reached = bit(origin);
+    queue[tail] = origin;
+    sources[tail++] = NO_ROUTE;
+    while (head < tail)
+    {
+      const radio_id node = queue[head];
+      const radio_id source = sources[head++];
+      node_mask_t edges = tables[node].tree();
+      if (source != NO_ROUTE)
+        edges &= ~bit(source);
+      for (radio_id j = 0; j < NODES; ++j)
+      {
+        if ((edges & bit(j)) == 0)
+          continue;
+        ++deliveries;
+        // a duplicate goes no further
+        if ((links[node] & bit(j)) == 0 || (reached & bit(j)))
+          continue;
+        reached |= bit(j);
+        queue[tail] = j;
+        sources[tail++] = node;
+      }
+    }
+    return reached;
+  }
+
+  void settled(const char* topology, Count& count)
+  {
+    node_mask_t links[NODES];
+    Table tables[NODES];
+    layout(topology, links);
+    settle(tables, links);
+    for (radio_id origin = 0; origin < NODES; ++origin)
+    {
+      ++count.messages;
+      count.broadcast += broadcast(tables, links, origin);
+      const node_mask_t reached = flood(tables, links, origin, count.flood);
+      count.missed += NODES - bits(reached);
+    }
+  }
+
+  /**
+   * Settles a random topology, then takes down a tree link that leaves it connected
+   */
+  void broken(Count& count)
+  {
+    node_mask_t links[NODES];
+    Table tables[NODES];
+    layout("random", links);
+    settle(tables, links);
+
+    // any link on node 0's tree, it's everyone's tree
+    const node_mask_t edges = tables[0].tree();
+    for (radio_id b = 0; b < NODES; ++b)
+    {
+      if ((edges & bit(b)) == 0)
+        continue;
+      links[0] &= ~bit(b);
+      links[b] &= ~bit(0);
+      if (distance(links, 0, b) == NODES)
+        return;
+      tables[0].lost(b);
+      tables[b].lost(0);
+      break;
+    }
+
+    for (radio_id origin = 0; origin < NODES; ++origin)
+    {
+      ++count.messages;
+      count.broadcast += broadcast(tables, links, origin);
+      const node_mask_t reached = flood(tables, links, origin, count.flood);
+      for (radio_id i = 0; i < NODES; ++i)
+      {
+        if (reached & bit(i))
+          continue;
+        ++count.missed;
+        count.retries += distance(links, origin, i);
+      }
+    }
+  }
+
+  void report(const char* name, const Count& count)
+  {
+    const double messages = count.messages;
+    printf("%-14s %7u %9.2f %6.2f %7.2f %7.2f\n", name, NODES - 1, count.broadcast / messages,
+      (count.flood + count.retries) / messages, count.missed / messages, count.retries / messages);
+  }
+};
+
+int main()
+{
+  printf("deliveries per message at %u nodes, from every node in turn\n", NODES);
+  printf("                             flood\n");
+  printf("topology       minimum broadcast  total  missed retries\n");
+  const char* topologies[] = {"full", "line", "ring", "star"};
+  for (const char* topology : topologies)
+  {
+    Count count;
+    settled(topology, count);
+    report(topology, count);
+  }
+
+  srand(1);
+  Count random;
+  for (uint16_t i = 0; i < DRAWS; ++i)
+    settled("random", random);
+  report("random", random);
+
+  srand(1);
+  Count link;
+  for (uint16_t i = 0; i < DRAWS; ++i)
+    broken(link);
+  report("random, a link", link);
+  printf("down, the rest haven't heard\n");
+  return 0;
+}
@@ -0,0 +1,171 @@
+/**
+ * One simulated node, the sketch built as it is plus the hooks the host drives it with
+ */
+
+#include "../main.cpp"
+#include "../config.cpp"
+
+#include "board.h"
+#include "sim.h"
+
+#define SIM_EXPORT extern "C" __attribute__((visibility("default")))
+
+// the tag the host has put on the reader, if any
+bool tagPresent = false;
+team_id tagTeam = NO_TEAM;
+player_id tagPlayer = 0;
+// a game the host has started from the menu, it goes on the next loop like a button press
+bool playPressed = false;
+
+SIM_EXPORT void sim_attach(const SimHost* host, const SimNodeConfig* config)
+{
+  board::attach(host, config);
+  config::setRadioID(config->radioID);
+  config::setChannel(config->channel);
+}
+
+SIM_EXPORT uint64_t sim_boot(const uint64_t now)
+{
+  board::wake(now);
+  setup();
+  cb_make_node();
+  return board::clock();
+}
+
+SIM_EXPORT uint64_t sim_start(const uint64_t now)
+{
+  board::wake(now);
+  playPressed = true;
+  return board::clock();
+}
+
+SIM_EXPORT uint64_t sim_step(const uint64_t now)
+{
+  board::wake(now);
+  loop();
+  if (playPressed)
+  {
+    // part of that loop, so a capture has it there too
+    playPressed = false;
+    screenIndex = 0;
+    cb_play_classic();
+  }
+  return board::clock();
+}
+
+SIM_EXPORT uint64_t sim_deliver(const uint64_t now, const uint8_t* data, const uint8_t length)
+{
+  board::wake(now);
+  board::receive(data, length);
+  return board::clock();
+}
+
+SIM_EXPORT uint64_t sim_sent(const uint64_t now, const bool ok)
+{
+  board::wake(now);
+  board::sent(ok);
+  return board::clock();
+}
+
+// sets the radio up again at a captured SYNC, with random() where the captured node's was, see replay.cpp
+SIM_EXPORT uint64_t sim_restart(const uint64_t now, const uint32_t seed)
+{
+  board::wake(now);
+  radio_init();
+  randomSeed(seed);
+  return board::clock();
+}
+
+SIM_EXPORT uint8_t sim_room()
+{
+  return board::room();
+}
+
+SIM_EXPORT void sim_tag(const int8_t team, const int8_t player)
+{
+  tagPresent = true;
+  tagTeam = team;
+  tagPlayer = player;
+}
+
+SIM_EXPORT int8_t sim_view(const uint8_t node)
+{
+  return node < MAX_NODES ? nodes.team(node) : NO_TEAM;
+}
+
+SIM_EXPORT uint32_t sim_clock(const uint64_t now)
+{
+  return netclock.time(board::millisAt(now));
+}
+
+SIM_EXPORT void sim_game(SimGame* g)
+{
+  g->start = game.start;
+  g->end = game.end;
+  g->endedBy = game.endedBy;
+  g->winner = game.winner;
+}
+
+// the reader, a player tag carrying whatever sim_tag() put there
+
+MFRC522::MFRC522(byte chipSelectPin, byte resetPowerDownPin) :
+  _chipSelectPin(chipSelectPin), _resetPowerDownPin(resetPowerDownPin)
+{
+}
+
+void MFRC522::PCD_Init()
+{
+}
+
+bool MFRC522::PICC_IsNewCardPresent()
+{
+  return tagPresent;
+}
+
+bool MFRC522::PICC_ReadCardSerial()
+{
+  uid.size = 4;
+  memset(uid.uidByte, 0, sizeof(uid.uidByte));
+  uid.sak = 0x08;
+  return tagPresent;
+}
+
+MFRC522::StatusCode MFRC522::PICC_Select(Uid* uid, byte validBits)
+{
+  return STATUS_OK;
+}
+
+MFRC522::PICC_Type MFRC522::PICC_GetType(byte sak)
+{
+  return PICC_TYPE_MIFARE_1K;
+}
+
+MFRC522::StatusCode MFRC522::PCD_Authenticate(byte command, byte blockAddr, MIFARE_Key* key, Uid* uid)
+{
+  return STATUS_OK;
+}
+
+MFRC522::StatusCode MFRC522::MIFARE_Read(byte blockAddr, byte* buffer, byte* bufferSize)
+{
+  memset(buffer, 0, *bufferSize);
+  memcpy(buffer, PSK, sizeof(PSK));
+  buffer[8] = TokenType::PLAYER;
+  buffer[9] = tagTeam;
+  buffer[10] = tagPlayer;
+  return STATUS_OK;
+}
+
+MFRC522::StatusCode MFRC522::MIFARE_Write(byte blockAddr, byte* buffer, byte bufferSize)
+{
+  return STATUS_OK;
+}
+
+MFRC522::StatusCode MFRC522::PICC_HaltA()
+{
+  tagPresent = false;
+  return STATUS_OK;
+}
+
+void MFRC522::PCD_StopCrypto1()
+{
+}
@@ -0,0 +1,181 @@
+/**
+ * Whole sketch RAM budget, measured off the sketch itself
+ * make budget builds main.cpp for a 32 and a 64 bit host, byte packed like avr-gcc and without RTTI, and hands
+ * both objects over. Everything that takes RAM on an AVR is added up: globals, statics, vtables, and constants
+ * and string literals, which avr-gcc keeps in RAM unless they're PROGMEM. Each object is sized the AVR way by
+ * taking the difference between the two builds as its pointers, 2 bytes each on the AVR.
+ * The Arduino core's own globals aren't in the sketch, so they're added from the core's sources: timer0's
+ * millis() state, and Serial's buffers if the sketch uses Serial. The stack is what's left
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace
+{
+  // timer0_overflow_count, timer0_millis and timer0_fract in wiring.c
+  const unsigned CORE_TIMER = 9;
+  // HardwareSerial on an ATmega328, 64 byte receive and transmit rings and the register pointers
+  const unsigned CORE_SERIAL = 157;
+  // anything smaller is only counted in the total
+  const unsigned SHOWN = 16;
+
+  struct Board
+  {
+    const char* name;
+    unsigned sram;
+  };
+
+  const Board BOARDS[] = {{"ATmega328", 2048}, {"ATmega2560", 8192}, {"ATmega1284P", 16384}};
+
+  struct Symbol
+  {
+    std::string name;
+    unsigned size;
+  };
+
+  /**
+   * Runs a command and hands each line of its output on
+   */
+  template <typename TLine>
+  bool each_line(const std::string& command, TLine line)
+  {
+    FILE* out = popen(command.c_str(), "r");
+    if (out == nullptr)
+      return false;
+    char buffer[1024];
+    while (fgets(buffer, sizeof(buffer), out) != nullptr)
+    {
+      buffer[strcspn(buffer, "\n")] = '\0';
+      line(std::string(buffer));
+    }
+    return pclose(out) == 0;
+  }
+
+  std::string trim(const std::string& s)
+  {
+    const size_t first = s.find_first_not_of(' ');
+    if (first == std::string::npos)
+      return "";
+    return s.substr(first, s.find_last_not_of(' ') - first + 1);
+  }
+
+  /**
+   * Reads the data objects out of an object file
+   * @param path object file
+   * @param objects filled in by name
+   * @param serial set if the sketch uses Serial
+   * @return false if nm failed
+   */
+  bool read_objects(const char* path, std::map<std::string, unsigned>& objects, bool& serial)
+  {
+    return each_line(std::string("nm -S -C -f sysv ") + path, [&](const std::string& line)
+    {
+      // name|value|class|type|size|line|section
+      std::vector<std::string> fields;
+      size_t start = 0;
+      for (size_t bar; (bar = line.find('|', start)) != std::string::npos; start = bar + 1)
+        fields.push_back(trim(line.substr(start, bar - start)));
+      fields.push_back(trim(line.substr(start)));
+      if (fields.size() < 7)
+        return;
+
+      if (fields[0] == "Serial" && fields[2] == "U")
+        serial = true;
+      const std::string& section = fields[6];
+      if (fields[3] != "OBJECT" || section.compare(0, 9, ".progmem.") == 0)
+        return;
+      if (section.compare(0, 4, ".bss") == 0 || section.compare(0, 5, ".data") == 0 ||
+        section.compare(0, 7, ".rodata") == 0)
+        objects[fields[0]] = strtoul(fields[4].c_str(), nullptr, 16);
+    });
+  }
+
+  /**
+   * Adds up the string literals and constants the compiler pooled, they have no symbols of their own
+   */
+  unsigned pooled(const char* path)
+  {
+    unsigned total = 0;
+    each_line(std::string("size -A ") + path, [&](const std::string& line)
+    {
+      char section[512];
+      unsigned size;
+      if (sscanf(line.c_str(), "%511s %u", section, &size) != 2 || strncmp(section, ".rodata", 7) != 0)
+        return;
+      if (strstr(section, ".str1.") != nullptr || strstr(section, ".cst") != nullptr)
+        total += size;
+    });
+    return total;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  const bool brief = argc > 1 && strcmp(argv[1], "-b") == 0;
+  if (argc != (brief ? 5 : 4))
+  {
+    fprintf(stderr, "usage: %s [-b] label sketch32.o sketch64.o\n", argv[0]);
+    return 1;
+  }
+  const char* label = argv[brief ? 2 : 1];
+  const char* path32 = argv[brief ? 3 : 2];
+  const char* path64 = argv[brief ? 4 : 3];
+
+  std::map<std::string, unsigned> objects32, objects64;
+  bool serial = false, unused = false;
+  if (!read_objects(path32, objects32, serial) || !read_objects(path64, objects64, unused))
+  {
+    fprintf(stderr, "can't read %s or %s\n", path32, path64);
+    return 1;
+  }
+
+  std::vector<Symbol> symbols;
+  unsigned total = 0;
+  for (const auto& object : objects32)
+  {
+    const auto wide = objects64.find(object.first);
+    const unsigned pointers = wide == objects64.end() ? 0 : (wide->second - object.second) / 4;
+    const unsigned size = object.second - 2 * pointers;
+    symbols.push_back({object.first, size});
+    total += size;
+  }
+  std::sort(symbols.begin(), symbols.end(), [](const Symbol& a, const Symbol& b) { return a.size > b.size; });
+
+  const unsigned strings = pooled(path32);
+  const unsigned core = CORE_TIMER + (serial ? CORE_SERIAL : 0);
+  total += strings + core;
+
+  if (brief)
+  {
+    printf("%-28s %5u", label, total);
+    for (const Board& board : BOARDS)
+      printf(" %6d", static_cast<int>(board.sram) - static_cast<int>(total));
+    printf("\n");
+    return 0;
+  }
+
+  printf("%s\n", label);
+  unsigned small = 0;
+  for (const Symbol& s : symbols)
+  {
+    if (s.size >= SHOWN)
+      printf("  %-26s %5u\n", s.name.c_str(), s.size);
+    else
+      small += s.size;
+  }
+  printf("  %-26s %5u\n", "everything smaller", small);
+  printf("  %-26s %5u\n", "strings and constants", strings);
+  printf("  %-26s %5u%s\n", "Arduino core", core, serial ? ", Serial included" : "");
+  printf("  %-26s %5u\n", "total", total);
+  for (const Board& board : BOARDS)
+    printf("  %-26s %5d left for the stack\n", board.name, static_cast<int>(board.sram) - static_cast<int>(total));
+  return 0;
+}
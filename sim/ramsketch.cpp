@@ -0,0 +1,14 @@
+/**
+ * The sketch by itself, with none of the simulator, for make budget to measure
+ * What avr-gcc keeps in flash goes in sections of its own here, so rambench can leave it out. Each F() string gets
+ * one to itself, or those in inline functions would clash with the rest
+ */
+
+#define PROGMEM __attribute__((section(".progmem.data")))
+#define FLASH_SECTION_NAMED(n) __attribute__((section(".progmem.string" #n)))
+#define FLASH_SECTION(n) FLASH_SECTION_NAMED(n)
+#define F(s) (reinterpret_cast<const __FlashStringHelper*>(__extension__({ \
+  static const char text[] FLASH_SECTION(__COUNTER__) = (s); &text[0]; })))
+
+#include "../main.cpp"
+#include "../config.cpp"
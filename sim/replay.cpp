@@ -0,0 +1,1064 @@
+/**
+ * Decodes radio captures and replays them into a node
+ * A capture is what a box built with CAPTURE or CAPTURE_STREAM writes over Serial, see capture.h, saved as it
+ * came off the port. Anything that isn't capture, the diagnostics text, is skipped over.
+ *
+ * With --decode it lists every record and the packets in every frame. Otherwise it boots one copy of node.so
+ * with the captured radio ID and channel and hands it every received frame, tag read and game start at the
+ * time it happened, on the same virtual clock the simulator uses with the node's millis() the captured one's, so
+ * the echoes in PONGs still mean something. A replay only depends on the capture and the node library. The radio
+ * comes up again at the first SYNC with a radio ID, with random() seeded as the SYNC says, so the node makes the same
+ * random choices the captured one did, ping jitter and gossip partners. Each send the node makes is answered the
+ * way the captured one was, the nth acknowledged send to a radio ID gets the nth DONE to it, at the same moment if
+ * the send lined up with the captured one. It then reports:
+ * - what was sent, captured against replayed, a packet count per opcode and a digest of every replayed send,
+ *   which only changes if the node's behaviour does
+ * - whether the sends match, every packet of a kind going to the same radio in the same order as the captured ones
+ *   and within SEND_SLACK of them, and if not the first one that doesn't, and exits with 2
+ * - the bursts, runs of received frames close together, with how long this machine spent in the node's code
+ *   handling each one, so the worst of them can be found and profiled, under perf or gprof if need be
+ * A capture that starts part way through a game, a CAPTURE dump, has no seed and replays into a node that wasn't
+ * there for the start of it, so expect it to send things the captured one didn't until it's caught up. Its sends
+ * aren't checked and it exits with 3.
+ * Every record carries the micros() its loop started at, so the replay runs the node's loops that recorded anything
+ * exactly then, with everything the loop heard already in the radio, and the frames go in the same loops they did.
+ * The loops in between recorded nothing and are filled in LOOP_US apart as sim runs them, spread to the captured
+ * node's drift when a gap is whole loops. Their phase is only as good as that, a microsecond or so, and a timer
+ * that falls due right on a millisecond can still go a loop either side and shift the random choices after it.
+ * That shows up as a divergence in a PING or GRAPH_REQUEST. A real box's loops aren't evenly spaced at all, so expect
+ * more of it from one
+ */
+
+#include <dlfcn.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <queue>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "../types.h"
+#include "../packets.h"
+#include "../auth.h"
+#include "../capture.h"
+#include "sim.h"
+
+EEPROMClass EEPROM;
+
+namespace
+{
+  typedef FrameAuth<MAX_NODES + 1> Auth;
+
+  // received frames closer together than this are one burst
+  const millis_t BURST_GAP = 20;
+  // and the node's still busy with one this long after the last frame in it
+  const millis_t BURST_TAIL = 50;
+  const uint32_t SENT_US = 500; // shortest a send takes to report back
+  const uint32_t LOOP_US = 2000; // how long a loop() takes at least, as in sim
+  // what reading the clock costs the node in board.cpp, so a captured micros() is this long after it woke
+  const uint32_t CLOCK_READ_US = 2;
+  // most a node's crystal can be out, in parts per million, any more and a gap between captured loops wasn't idle
+  const uint32_t MAX_DRIFT = 1000;
+  const uint32_t RUNOUT_US = 1000000; // kept going after the last record
+  // the node boots this long before the first record, setup() takes about half of it
+  const uint32_t LEAD_US = 1000000;
+  const uint8_t WORST_BURSTS = 5;
+  // most a replayed packet can go out either side of the captured one, the loops don't run at the same moments
+  const millis_t SEND_SLACK = 20;
+  const radio_id NOBODY = UINT8_MAX; // for a frame that wasn't sent to anyone, a received one
+
+  const char* const OPCODES[] = {
+    "PING", "PONG", "GRAPH_REQUEST", "GRAPH", "GAME_SETUP", "CLAIM", "WIN", "DIGEST", "STATE", "ACK", "JOIN",
+    "OFFER", "INTERFERENCE", "RETUNE", "LINK", "LEASE"
+  };
+  static_assert(sizeof(OPCODES) / sizeof(OPCODES[0]) == OPCODE_COUNT, "every opcode needs a name");
+
+  struct Options
+  {
+    bool decode = false;
+    bool trace = false;
+    bool verbose = false;
+    std::string library = "./node.so";
+    std::string path;
+  };
+
+  struct Record
+  {
+    bool sync; // a SYNC rather than one of kind
+    capture::Kind kind;
+    uint64_t at; // micros() when the loop it was made in started, without its wrapping
+    millis_t time; // the same in milliseconds, for lining things up
+    radio_id peer; // TX and DONE
+    bool ok; // DONE
+    uint8_t length; // RX, TX and LOCAL
+    uint8_t data[MAX_FRAME_SIZE];
+    capture::Sync about; // SYNC
+    uint16_t following; // SYNC
+  };
+
+  struct CaptureFile
+  {
+    std::vector<Record> records;
+    uint32_t skipped = 0; // bytes that weren't capture
+  };
+
+  /**
+   * Checks a byte could start a frame, so text read as a record gets caught before it goes far
+   */
+  inline bool plausible_source(const uint8_t header)
+  {
+    return (header & ~Auth::LONG_FORM) <= JOIN_ID;
+  }
+
+  inline bool at_magic(const std::vector<uint8_t>& bytes, const size_t pos)
+  {
+    return pos + sizeof(capture::MAGIC) <= bytes.size() &&
+      memcmp(bytes.data() + pos, capture::MAGIC, sizeof(capture::MAGIC)) == 0;
+  }
+
+  /**
+   * Reads one record
+   * @return bytes it took, 0 if there isn't a believable record at pos
+   */
+  size_t read_record(const std::vector<uint8_t>& bytes, size_t pos, const uint64_t at, Record& record)
+  {
+    const size_t start = pos;
+    if (at_magic(bytes, pos))
+    {
+      if (pos + capture::SYNC_SIZE > bytes.size() || bytes[pos + sizeof(capture::MAGIC)] != capture::VERSION)
+        return 0;
+      const uint8_t* p = bytes.data() + pos + sizeof(capture::MAGIC) + 1;
+      record.sync = true;
+      record.about.id = p[0];
+      record.about.channel = p[1];
+      record.about.profile = p[2];
+      record.about.flags = p[3];
+      memcpy(&record.about.seed, bytes.data() + pos + capture::SYNC_SEED, sizeof(record.about.seed));
+      uint32_t base;
+      memcpy(&base, bytes.data() + pos + capture::SYNC_TIME, sizeof(base));
+      memcpy(&record.following, bytes.data() + pos + capture::SYNC_TIME + sizeof(base), sizeof(record.following));
+      // micros() wraps every 71 minutes, and starts again if the box does
+      const int64_t moved = static_cast<int32_t>(base - static_cast<uint32_t>(at));
+      record.at = static_cast<int64_t>(at) + moved < 0 ? base : at + moved;
+      record.time = record.at / 1000;
+      return capture::SYNC_SIZE;
+    }
+
+    const uint8_t header = bytes[pos++];
+    record.kind = static_cast<capture::Kind>(header >> capture::COUNT_BITS);
+    const uint8_t count = header & capture::COUNT_MASK;
+    if (header == capture::SYNC_HEADER)
+      return 0;
+
+    uint32_t elapsed = 0;
+    for (uint8_t shift = 0; ; shift += 7)
+    {
+      if (pos >= bytes.size() || shift > 28)
+        return 0;
+      const uint8_t b = bytes[pos++];
+      elapsed |= static_cast<uint32_t>(b & 0x7F) << shift;
+      if (!(b & 0x80))
+        break;
+    }
+    record.at = at + elapsed;
+    record.time = record.at / 1000;
+
+    if (record.kind == capture::Kind::TX || record.kind == capture::Kind::DONE)
+    {
+      if (pos >= bytes.size() || bytes[pos] > JOIN_ID)
+        return 0;
+      record.peer = bytes[pos++];
+    }
+    if (record.kind == capture::Kind::DONE)
+    {
+      if (count > 1)
+        return 0;
+      record.ok = count;
+      return pos - start;
+    }
+    if (record.kind == capture::Kind::LOCAL)
+    {
+      if (count != 3 || pos + count > bytes.size() || bytes[pos] > static_cast<uint8_t>(capture::Input::PLAY))
+        return 0;
+      record.length = count;
+      memcpy(record.data, bytes.data() + pos, count);
+      return pos + count - start;
+    }
+
+    if (count < FRAME_HEADER_SIZE || count > MAX_FRAME_SIZE || pos + count > bytes.size() ||
+      !plausible_source(bytes[pos]))
+      return 0;
+    record.length = count;
+    memcpy(record.data, bytes.data() + pos, count);
+    return pos + count - start;
+  }
+
+  /**
+   * Pulls every record out of what came off the port, skipping to the next MAGIC over anything that isn't one
+   */
+  CaptureFile parse(const std::vector<uint8_t>& bytes)
+  {
+    CaptureFile result;
+    size_t pos = 0;
+    bool synced = false;
+    uint64_t at = 0;
+    uint32_t remaining = capture::OPEN_ENDED; // of a dump, which ends where its SYNC says
+    while (pos < bytes.size())
+    {
+      if (!synced)
+      {
+        const size_t from = pos;
+        while (pos < bytes.size() && !at_magic(bytes, pos))
+          ++pos;
+        result.skipped += pos - from;
+        if (pos == bytes.size())
+          break;
+      }
+
+      Record record = {};
+      const size_t size = read_record(bytes, pos, at, record);
+      if (size == 0)
+      {
+        synced = false;
+        ++result.skipped;
+        ++pos;
+        continue;
+      }
+      pos += size;
+      at = record.at;
+
+      if (record.sync)
+      {
+        // one inside a dump is just a restart, the dump still ends where it said
+        if (!synced || remaining == capture::OPEN_ENDED)
+          remaining = record.following;
+        else
+          remaining -= std::min<uint32_t>(remaining, size);
+      }
+      else if (remaining != capture::OPEN_ENDED)
+        remaining -= std::min<uint32_t>(remaining, size);
+      synced = remaining != 0;
+      result.records.push_back(record);
+    }
+    return result;
+  }
+
+  /**
+   * Gets how much of a frame is packets
+   * @param frame the frame, with the long form flag if it's authenticated
+   * @param length bytes in the frame
+   * @param authenticated true if the frame has a trailer
+   */
+  uint8_t packet_bytes(const uint8_t* frame, const uint8_t length, const bool authenticated)
+  {
+    if (!authenticated)
+      return length;
+    const uint8_t trailer = (frame[0] & Auth::LONG_FORM) ? Auth::LONG_TRAILER : Auth::SHORT_TRAILER;
+    return length > trailer ? length - trailer : FRAME_HEADER_SIZE;
+  }
+
+  void print_mask(const node_mask_t mask)
+  {
+    putchar(' ');
+    for (uint8_t i = 0; i < MAX_NODES; ++i)
+      putchar(mask & (static_cast<node_mask_t>(1) << i) ? '0' + i % 10 : '.');
+  }
+
+  void describe(const Packet& p)
+  {
+    const uint8_t op = static_cast<uint8_t>(p.opcode);
+    printf("    %-13s %u>", OPCODES[op], p.origin);
+    if (p.target == TARGET_NEIGHBOURS)
+      printf("*");
+    else
+      printf("%u", p.target);
+    printf(" ttl %u seq %u time %u", p.ttl, p.seq, p.timestamp);
+    switch (p.opcode)
+    {
+      case OpCode::PING:
+        printf(" echo %u", p.echo);
+        break;
+      case OpCode::PONG:
+        printf(" echo %u stratum %u local %u drift %d", p.echo, p.stratum, p.local, p.drift);
+        break;
+      case OpCode::GRAPH_REQUEST:
+        printf(" window %u versions", p.window);
+        for (uint8_t i = 0; i < GRAPH_SPAN; ++i)
+          printf(" %u", p.known[i]);
+        break;
+      case OpCode::GRAPH:
+        printf(" first %u rows", p.first);
+        for (uint8_t i = 0; i < GRAPH_ROWS; ++i)
+          print_mask(p.rows[i]);
+        break;
+      case OpCode::GAME_SETUP:
+        printf(" nodes %u teams %u", p.nodes, p.teams);
+        break;
+      case OpCode::CLAIM:
+      case OpCode::WIN:
+        printf(" team %d player %d version %u", p.team, p.player, p.version);
+        break;
+      case OpCode::DIGEST:
+        printf(" from %u versions", p.from);
+        for (uint8_t i = 0; i < DIGEST_SPAN; ++i)
+          printf(" %u", p.digest[i]);
+        printf(" started %u ended %u by %u winner %d", p.started, p.ended, p.endedBy, p.winner);
+        break;
+      case OpCode::STATE:
+        printf(" node %u team %d player %d version %u claimed %u", p.node, p.team, p.player, p.version, p.claimed);
+        break;
+      case OpCode::JOIN:
+        printf(" nonce %u", p.nonce);
+        break;
+      case OpCode::OFFER:
+        printf(" nonce %u offer %u members", p.nonce, p.offer);
+        print_mask(p.members);
+        printf(" epoch %u", p.epoch);
+        break;
+      case OpCode::RETUNE:
+        printf(" channel %u profile %u at %u", p.channel, p.profile, p.at);
+        break;
+      case OpCode::LINK:
+        printf(" quality %u", p.quality);
+        break;
+      default:
+        break;
+    }
+    printf("\n");
+  }
+
+  /**
+   * Goes through the packets in a frame
+   * @param visit called with each one
+   * @return false if it didn't all make sense
+   */
+  template <typename TVisit>
+  bool each_packet(const uint8_t* frame, const uint8_t length, const bool authenticated, TVisit visit)
+  {
+    uint8_t buffer[MAX_FRAME_SIZE + sizeof(Packet)] = {};
+    memcpy(buffer, frame, length);
+    const uint8_t end = packet_bytes(frame, length, authenticated);
+    uint8_t offset = FRAME_HEADER_SIZE;
+    while (offset < end)
+    {
+      uint8_t size;
+      const Packet* packet = packet_decode(buffer + offset, end - offset, size);
+      if (packet == nullptr)
+        return false;
+      visit(*packet);
+      offset += size;
+    }
+    return true;
+  }
+
+  void print_frame(const char* what, const millis_t time, const radio_id peer, const uint8_t* frame,
+    const uint8_t length, const bool authenticated)
+  {
+    printf("%10u %s %u", time, what, frame[0] & ~Auth::LONG_FORM);
+    if (peer != NOBODY)
+      printf(" to %u", peer);
+    printf(", %u bytes", length);
+    if (authenticated)
+      printf(", %s trailer", (frame[0] & Auth::LONG_FORM) ? "long" : "short");
+    printf("\n");
+    if (!each_packet(frame, length, authenticated, describe))
+      printf("    and %u bytes that aren't a packet\n", length);
+  }
+
+  bool load(const std::string& path, std::vector<uint8_t>& bytes)
+  {
+    FILE* in = fopen(path.c_str(), "rb");
+    if (in == nullptr)
+    {
+      perror(path.c_str());
+      return false;
+    }
+    uint8_t buffer[65536];
+    size_t got;
+    while ((got = fread(buffer, 1, sizeof(buffer), in)) > 0)
+      bytes.insert(bytes.end(), buffer, buffer + got);
+    fclose(in);
+    return true;
+  }
+
+  void decode(const CaptureFile& c)
+  {
+    bool authenticated = false;
+    for (const Record& r : c.records)
+    {
+      if (r.sync)
+      {
+        authenticated = r.about.flags & capture::FLAG_AUTH;
+        printf("%10u SYNC radio %u channel %u profile %u%s%s%s", r.time, r.about.id, r.about.channel,
+          r.about.profile, authenticated ? " FRAME_AUTH" : "", (r.about.flags & capture::FLAG_TDMA) ? " TDMA" : "",
+          (r.about.flags & capture::FLAG_DUTY_CYCLE) ? " DUTY_CYCLE" : "");
+        if (r.about.seed != 0)
+          printf(", seed %u", r.about.seed);
+        if (r.following != capture::OPEN_ENDED)
+          printf(", a dump of %u bytes", r.following);
+        printf("\n");
+        continue;
+      }
+      switch (r.kind)
+      {
+        case capture::Kind::RX:
+          print_frame("RX from", r.time, NOBODY, r.data, r.length, authenticated);
+          break;
+        case capture::Kind::TX:
+          print_frame("TX from", r.time, r.peer, r.data, r.length, authenticated);
+          break;
+        case capture::Kind::DONE:
+          printf("%10u DONE to %u %s\n", r.time, r.peer, r.ok ? "acknowledged" : "failed");
+          break;
+        case capture::Kind::LOCAL:
+          if (static_cast<capture::Input>(r.data[0]) == capture::Input::TAG)
+            printf("%10u TAG team %d player %d\n", r.time, static_cast<int8_t>(r.data[1]), static_cast<int8_t>(r.data[2]));
+          else
+            printf("%10u PLAY nodes %u teams %u\n", r.time, r.data[1], r.data[2]);
+          break;
+      }
+    }
+    printf("%zu records, %u bytes skipped\n", c.records.size(), c.skipped);
+  }
+
+  // the replay
+
+  enum class EventType : uint8_t
+  {
+    RESTART,
+    LOOP,
+    CAPTURED_LOOP, // one the captured node recorded something in
+    DELIVER,
+    SENT,
+    LOCAL
+  };
+
+  struct Event
+  {
+    uint64_t at;
+    uint64_t order;
+    EventType type;
+    const Record* record; // deliver and input
+    bool ok; // sent
+
+    bool operator>(const Event& other) const
+    {
+      return at != other.at ? at > other.at : order > other.order;
+    }
+  };
+
+  struct Outcome
+  {
+    bool ok;
+    uint64_t sent; // loop the captured send went in
+    uint64_t done; // and the one that heard how it went
+  };
+
+  // a packet sent, for lining the replay up against the capture, leaving out the fields that only say when
+  struct Send
+  {
+    millis_t time;
+    radio_id peer;
+    OpCode opcode;
+    radio_id origin;
+    radio_id target;
+  };
+
+  struct Burst
+  {
+    millis_t first;
+    millis_t last;
+    uint32_t frames;
+    uint32_t packets;
+    uint64_t hostNs; // in the node's code
+    uint32_t sends; // by the replayed node
+  };
+
+  /**
+   * Free loops shared out evenly over a gap between two loops
+   */
+  struct Spacing
+  {
+    uint64_t from; // when the first loop started
+    uint64_t to; // and the captured one it runs up to
+    uint64_t loops; // between them, 0 if it isn't whole loops
+    uint64_t done; // of them so far
+
+    inline uint64_t at(const uint64_t loop) const { return from + ((to - from) * loop + loops / 2) / loops; }
+  };
+
+  struct Replay
+  {
+    Options options;
+    sim_attach_t attach;
+    sim_boot_t boot;
+    sim_start_t start;
+    sim_step_t step;
+    sim_deliver_t deliver;
+    sim_sent_t sent;
+    sim_restart_t restart;
+    sim_room_t room;
+    sim_tag_t tag;
+
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events;
+    uint64_t order = 0;
+    std::set<uint64_t> capturedLoops; // when the loops the captured node recorded something in started
+    Spacing spacing = {};
+    bool authenticated = false;
+    bool lineStart = true;
+
+    std::deque<Outcome> outcomes[MAX_NODES + 1]; // per radio ID, in the order they happened
+    uint32_t sends = 0;
+    uint32_t unmatched = 0; // sends there was no captured outcome for
+    uint32_t packets[OPCODE_COUNT] = {};
+    uint64_t digest = 14695981039346656037ull; // FNV-1a over every send
+    std::vector<Send> replayed;
+    std::vector<Burst> bursts;
+    Burst* burst = nullptr; // the one the event being run is part of
+  };
+
+  Replay replay;
+
+  /**
+   * Checks whether the captured node can't have started a loop at a time, because it started one that recorded
+   * something too soon after. Its loops are LOOP_US apart by its own clock, which is a little out from ours
+   */
+  bool too_close(const uint64_t at)
+  {
+    const auto next = replay.capturedLoops.lower_bound(at);
+    return next != replay.capturedLoops.end() && *next - at < LOOP_US / 2;
+  }
+
+  /**
+   * Works out when the loop after one at a time starts, if it doesn't run over
+   * The captured node's loops are LOOP_US apart by the real clock, which is a little more or less by its own, and
+   * over a long quiet spell that adds up to a loop's worth of millis() ticking over a loop early or late. So a
+   * gap up to the next captured loop that's a whole number of loops, give or take the drift, is shared out evenly,
+   * each loop placed from the start of it so the rounding doesn't add up either
+   * @param at when the loop starts
+   * @return when the next one's due
+   */
+  uint64_t next_loop(const uint64_t at)
+  {
+    const auto next = replay.capturedLoops.upper_bound(at);
+    if (next == replay.capturedLoops.end())
+      return at + LOOP_US;
+    Spacing& s = replay.spacing;
+    if (s.to != *next || s.loops == 0 || s.at(s.done) != at)
+    {
+      // a new gap, or one a loop ran over in
+      const uint64_t gap = *next - at;
+      const uint64_t loops = (gap + LOOP_US / 2) / LOOP_US;
+      const uint64_t exact = loops * LOOP_US;
+      const uint64_t slack = exact * MAX_DRIFT / 1000000;
+      s = {at, *next, loops == 0 || gap + slack < exact || gap > exact + slack ? 0 : loops, 0};
+      if (s.loops == 0)
+        return at + LOOP_US;
+    }
+    return s.at(++s.done);
+  }
+
+  void schedule(Event e)
+  {
+    e.order = replay.order++;
+    replay.events.push(e);
+  }
+
+  void hash(const void* data, const size_t size)
+  {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; ++i)
+    {
+      replay.digest ^= p[i];
+      replay.digest *= 1099511628211ull;
+    }
+  }
+
+  bool transmit(void* /* context */, uint8_t /* node */, uint8_t to, const uint8_t* data, uint8_t length,
+    bool ack, uint64_t at, bool async)
+  {
+    ++replay.sends;
+    const millis_t time = at / 1000;
+    hash(&time, sizeof(time));
+    hash(&to, sizeof(to));
+    hash(data, length);
+    each_packet(data, length, replay.authenticated, [time, to](const Packet& p)
+    {
+      ++replay.packets[static_cast<uint8_t>(p.opcode)];
+      replay.replayed.push_back({time, to, p.opcode, p.origin, p.target});
+    });
+    if (replay.options.trace)
+      print_frame("TX replayed from", time, to, data, length, replay.authenticated);
+    if (replay.burst != nullptr)
+      ++replay.burst->sends;
+
+    Outcome outcome = {true, at, at};
+    if (ack)
+    {
+      std::deque<Outcome>& captured = replay.outcomes[to <= MAX_NODES ? to : MAX_NODES];
+      if (captured.empty())
+        ++replay.unmatched;
+      else
+      {
+        outcome = captured.front();
+        captured.pop_front();
+      }
+    }
+    if (async)
+    {
+      Event e = {};
+      // one that went when the captured one did finishes just ahead of the loop that heard about it, so it's the
+      // same one, otherwise it takes as long
+      const uint64_t apart = at > outcome.sent ? at - outcome.sent : outcome.sent - at;
+      const uint64_t done = apart <= SEND_SLACK * 1000 ? outcome.done - CLOCK_READ_US - 1 :
+        at + (outcome.done - outcome.sent);
+      e.at = std::max<uint64_t>(at + SENT_US, done);
+      e.type = EventType::SENT;
+      e.ok = outcome.ok;
+      schedule(e);
+    }
+    return outcome.ok;
+  }
+
+  void tune(void* /* context */, uint8_t /* node */, uint8_t /* id */, uint8_t /* channel */, uint8_t /* bitrate */)
+  {
+  }
+
+  // the captured node heard every frame in the capture, so the replayed one does whether it's listening or not
+  void listen(void* /* context */, uint8_t /* node */, bool /* on */)
+  {
+  }
+
+  void serial(void* /* context */, uint8_t /* node */, uint8_t c)
+  {
+    if (!replay.options.verbose || c == '\r')
+      return;
+    if (replay.lineStart)
+      printf("[node] ");
+    putchar(c);
+    replay.lineStart = c == '\n';
+  }
+
+  SimHost host = {nullptr, transmit, tune, listen, serial};
+
+  bool load_node(const std::string& path)
+  {
+    void* handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (handle == nullptr)
+    {
+      fprintf(stderr, "can't load %s: %s\n", path.c_str(), dlerror());
+      return false;
+    }
+    replay.attach = reinterpret_cast<sim_attach_t>(dlsym(handle, "sim_attach"));
+    replay.boot = reinterpret_cast<sim_boot_t>(dlsym(handle, "sim_boot"));
+    replay.start = reinterpret_cast<sim_start_t>(dlsym(handle, "sim_start"));
+    replay.step = reinterpret_cast<sim_step_t>(dlsym(handle, "sim_step"));
+    replay.deliver = reinterpret_cast<sim_deliver_t>(dlsym(handle, "sim_deliver"));
+    replay.sent = reinterpret_cast<sim_sent_t>(dlsym(handle, "sim_sent"));
+    replay.restart = reinterpret_cast<sim_restart_t>(dlsym(handle, "sim_restart"));
+    replay.room = reinterpret_cast<sim_room_t>(dlsym(handle, "sim_room"));
+    replay.tag = reinterpret_cast<sim_tag_t>(dlsym(handle, "sim_tag"));
+    if (!replay.attach || !replay.boot || !replay.start || !replay.step || !replay.deliver || !replay.sent ||
+      !replay.restart || !replay.room || !replay.tag)
+    {
+      fprintf(stderr, "%s is missing the sim_* functions\n", path.c_str());
+      return false;
+    }
+    return true;
+  }
+
+  /**
+   * Splits the received frames up into bursts
+   */
+  std::vector<Burst> find_bursts(const CaptureFile& c)
+  {
+    std::vector<Burst> bursts;
+    bool authenticated = false;
+    for (const Record& r : c.records)
+    {
+      if (r.sync)
+        authenticated = r.about.flags & capture::FLAG_AUTH;
+      if (r.sync || r.kind != capture::Kind::RX)
+        continue;
+      if (bursts.empty() || r.time - bursts.back().last > BURST_GAP)
+        bursts.push_back({r.time, r.time, 0, 0, 0, 0});
+      Burst& b = bursts.back();
+      b.last = r.time;
+      ++b.frames;
+      each_packet(r.data, r.length, authenticated, [&b](const Packet&) { ++b.packets; });
+    }
+    return bursts;
+  }
+
+  void print_send(const char* what, const Send& send)
+  {
+    printf("  %s %10u %s to %u, origin %u target %u\n", what, send.time, OPCODES[static_cast<uint8_t>(send.opcode)],
+      send.peer, send.origin, send.target);
+  }
+
+  inline uint32_t key(const Send& send)
+  {
+    return static_cast<uint32_t>(send.peer) << 24 | static_cast<uint32_t>(send.opcode) << 16 |
+      static_cast<uint32_t>(send.origin) << 8 | send.target;
+  }
+
+  /**
+   * Lines the replayed packets up against the captured ones. The nth packet of a kind, to the same radio about the
+   * same nodes, has to match the nth captured one to within SEND_SLACK. Kinds can interleave differently, the first
+   * loop doesn't come round at quite the same moment, so each kind is lined up on its own
+   * @param captured every packet the captured node sent after the radio came up
+   * @param last time of the last record, anything replayed much after it has nothing to match
+   * @return 0 if they match, 2 if they diverge
+   */
+  int check_sends(const std::vector<Send>& captured, const millis_t last)
+  {
+    std::map<uint32_t, std::vector<const Send*>> expected;
+    std::map<uint32_t, std::vector<const Send*>> got;
+    size_t replayed = 0;
+    for (const Send& send : captured)
+      expected[key(send)].push_back(&send);
+    for (const Send& send : replay.replayed)
+    {
+      if (send.time > last + SEND_SLACK)
+        break;
+      got[key(send)].push_back(&send);
+      ++replayed;
+    }
+    for (const auto& kind : got)
+      expected[kind.first];
+
+    // the earliest packet that doesn't line up
+    const Send* wanted = nullptr;
+    const Send* sent = nullptr;
+    millis_t at = UINT32_MAX;
+    millis_t worst = 0;
+    for (const auto& kind : expected)
+    {
+      const std::vector<const Send*>& a = kind.second;
+      const std::vector<const Send*>& b = got[kind.first];
+      for (size_t i = 0; i < a.size() || i < b.size(); ++i)
+      {
+        const Send* x = i < a.size() ? a[i] : nullptr;
+        const Send* y = i < b.size() ? b[i] : nullptr;
+        const millis_t apart = x && y ? (x->time > y->time ? x->time - y->time : y->time - x->time) : 0;
+        if (x && y && apart <= SEND_SLACK)
+        {
+          worst = std::max<millis_t>(worst, apart);
+          continue;
+        }
+        // one replayed at the very end could be for something the capture stops short of
+        if (!x && y->time + SEND_SLACK > last)
+          break;
+        const millis_t when = x && y ? std::min<millis_t>(x->time, y->time) : (x ? x->time : y->time);
+        if (when < at)
+        {
+          at = when;
+          wanted = x;
+          sent = y;
+        }
+        break;
+      }
+    }
+    if (at == UINT32_MAX)
+    {
+      printf("sends match        %zu packets, at most %ums apart\n", replayed, worst);
+      return 0;
+    }
+    printf("sends diverge at %u\n", at);
+    if (wanted)
+      print_send("captured", *wanted);
+    else
+      printf("  captured nothing like it\n");
+    if (sent)
+      print_send("replayed", *sent);
+    else
+      printf("  replayed nothing like it\n");
+    return 2;
+  }
+
+  int run(const CaptureFile& c)
+  {
+    // who the node was, from the first SYNC that isn't a join
+    const Record* self = nullptr;
+    for (const Record& r : c.records)
+    {
+      if (r.sync && r.about.id < MAX_NODES)
+      {
+        self = &r;
+        break;
+      }
+    }
+    if (self == nullptr)
+    {
+      fprintf(stderr, "no SYNC with a radio ID in the capture\n");
+      return 1;
+    }
+    replay.authenticated = self->about.flags & capture::FLAG_AUTH;
+    printf("replaying radio %u channel %u%s into %s\n", self->about.id, self->about.channel,
+      replay.authenticated ? " with FRAME_AUTH, the node library needs building with DEFINES=-DFRAME_AUTH" : "",
+      replay.options.library.c_str());
+    // the sends can only be lined up if the capture has the radio coming up, where the node's random() was seeded
+    const bool checked = self->about.seed != 0;
+    if (!checked)
+      printf("the capture doesn't start at a seeded SYNC, the sends can't be checked\n");
+    for (const Record& r : c.records)
+    {
+      if (&r != self && r.sync && r.about.seed != 0)
+      {
+        printf("the node reseeds part way through, the node library needs building with DEFINES=-DCAPTURE\n");
+        break;
+      }
+    }
+
+    // every acknowledged send's outcome, and how long after the send it came
+    uint32_t captured[OPCODE_COUNT] = {};
+    uint32_t capturedSends = 0;
+    std::vector<Send> capturedPackets;
+    uint64_t lastSend[MAX_NODES + 1] = {};
+    bool authenticated = false;
+    for (const Record& r : c.records)
+    {
+      if (r.sync)
+        authenticated = r.about.flags & capture::FLAG_AUTH;
+      else if (r.kind == capture::Kind::TX)
+      {
+        ++capturedSends;
+        lastSend[r.peer] = r.at;
+        const bool after = &r > self;
+        each_packet(r.data, r.length, authenticated, [&captured, &capturedPackets, &r, after](const Packet& p)
+        {
+          ++captured[static_cast<uint8_t>(p.opcode)];
+          if (after)
+            capturedPackets.push_back({r.time, r.peer, p.opcode, p.origin, p.target});
+        });
+      }
+      else if (r.kind == capture::Kind::DONE)
+        replay.outcomes[r.peer].push_back({r.ok, lastSend[r.peer], r.at});
+    }
+
+    const SimNodeConfig config = {
+      .index = 0,
+      .radioID = self->about.id,
+      .channel = self->about.channel,
+      .offset = 0,
+      .drift = 0,
+      .seed = 1
+    };
+    replay.attach(&host, &config);
+
+    std::vector<Burst>& bursts = replay.bursts;
+    bursts = find_bursts(c);
+    size_t burst = 0;
+    uint64_t hostNs = 0;
+    uint64_t loopNs = 0;
+    uint32_t loops = 0;
+    uint32_t delivered = 0;
+
+    // global time is the captured node's micros(), and the node's up by the time the capture starts
+    const uint64_t start = c.records.front().at;
+    const auto boot = std::chrono::steady_clock::now();
+    const uint64_t up = replay.boot(start > LEAD_US ? start - LEAD_US : 0);
+    hostNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - boot).count();
+    // the radio comes up and random() is seeded where the captured node's were, and it loops from there
+    Event restart = {};
+    restart.at = std::max<uint64_t>(up, self->at - CLOCK_READ_US);
+    restart.type = EventType::RESTART;
+    restart.record = self;
+    schedule(restart);
+    // what each loop got is there when it starts, events at the same time go in the order they're scheduled, and
+    // each one wakes the node just early enough for the first thing it reads off the clock to be the captured time
+    for (const Record& r : c.records)
+    {
+      // anything before the radio came up was join()'s, which the replay doesn't run
+      if (&r < self || r.sync)
+        continue;
+      replay.capturedLoops.insert(r.at - CLOCK_READ_US);
+      if (r.kind != capture::Kind::RX && r.kind != capture::Kind::LOCAL)
+        continue;
+      Event e = {};
+      e.at = r.at - CLOCK_READ_US;
+      e.type = r.kind == capture::Kind::RX ? EventType::DELIVER : EventType::LOCAL;
+      e.record = &r;
+      schedule(e);
+    }
+    for (const uint64_t at : replay.capturedLoops)
+    {
+      Event e = {};
+      e.at = at;
+      e.type = EventType::CAPTURED_LOOP;
+      schedule(e);
+    }
+    const uint64_t end = c.records.back().at + RUNOUT_US;
+    Event loop = {};
+    loop.type = EventType::LOOP;
+
+    while (!replay.events.empty() && replay.events.top().at <= end)
+    {
+      const Event e = replay.events.top();
+      replay.events.pop();
+
+      // anything the node does now goes down to the burst it's part of, if any
+      const millis_t time = e.at / 1000;
+      while (burst < bursts.size() && time > bursts[burst].last + BURST_TAIL)
+        ++burst;
+      replay.burst = burst < bursts.size() && time >= bursts[burst].first ? &bursts[burst] : nullptr;
+
+      const auto start = std::chrono::steady_clock::now();
+      switch (e.type)
+      {
+        case EventType::RESTART:
+          // the rest of setup(), then the first loop, as in sim
+          loop.at = replay.restart(e.at, e.record->about.seed) + LOOP_US;
+          schedule(loop);
+          break;
+        case EventType::LOOP:
+          // one that's been overtaken by a captured loop, or that the captured node can't have had
+          if (e.at != loop.at || too_close(e.at))
+            break;
+          // fall through
+        case EventType::CAPTURED_LOOP:
+        {
+          const uint64_t busy = replay.step(e.at);
+          loop.at = std::max<uint64_t>(busy, next_loop(e.at));
+          schedule(loop);
+          ++loops;
+          break;
+        }
+        case EventType::DELIVER:
+          // the captured node read every frame, so one the replayed node hasn't made room for waits for its loop
+          if (replay.room() == 0)
+          {
+            Event later = e;
+            later.at = std::max<uint64_t>(loop.at, e.at + LOOP_US);
+            schedule(later);
+            break;
+          }
+          replay.deliver(e.at, e.record->data, e.record->length);
+          ++delivered;
+          break;
+        case EventType::SENT:
+          replay.sent(e.at, e.ok);
+          break;
+        case EventType::LOCAL:
+          // both happen on the node's next loop, the one they were captured in, like the real reader and menu
+          if (static_cast<capture::Input>(e.record->data[0]) == capture::Input::TAG)
+            replay.tag(e.record->data[1], e.record->data[2]);
+          else
+            replay.start(e.at);
+          break;
+      }
+      const double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+      hostNs += ns;
+      if (e.type == EventType::LOOP || e.type == EventType::CAPTURED_LOOP)
+        loopNs += ns;
+      if (replay.burst != nullptr)
+        replay.burst->hostNs += ns;
+    }
+    replay.burst = nullptr;
+
+    printf("%zu records over %.1fs, %u frames delivered, %u bytes skipped\n", c.records.size(),
+      (c.records.back().at - start) / 1e6, delivered, c.skipped);
+    printf("sent               %u frames captured, %u replayed, %u with no captured outcome\n", capturedSends,
+      replay.sends, replay.unmatched);
+    printf("packets sent       captured / replayed\n");
+    for (uint8_t i = 0; i < OPCODE_COUNT; ++i)
+    {
+      if (captured[i] || replay.packets[i])
+        printf("  %-16s %8u / %u\n", OPCODES[i], captured[i], replay.packets[i]);
+    }
+    printf("replay digest      %016llx\n", static_cast<unsigned long long>(replay.digest));
+    printf("host time          %.2fms in the node, %u loops at %.1fus, %.1fus a frame delivered\n", hostNs / 1e6,
+      loops, loops ? loopNs / 1e3 / loops : 0.0, delivered ? hostNs / 1e3 / delivered : 0.0);
+
+    const int divergence = checked ? check_sends(capturedPackets, c.records.back().time) : 3;
+
+    std::sort(bursts.begin(), bursts.end(), [](const Burst& a, const Burst& b) { return a.frames > b.frames; });
+    printf("%zu bursts, the biggest\n", bursts.size());
+    printf("        at  frames  packets  span ms  sent  host us\n");
+    for (size_t i = 0; i < bursts.size() && i < WORST_BURSTS; ++i)
+    {
+      const Burst& b = bursts[i];
+      printf("%10u %7u %8u %8u %5u %8.1f\n", b.first, b.frames, b.packets, b.last - b.first, b.sends,
+        b.hostNs / 1e3);
+    }
+    return divergence;
+  }
+
+  void usage(const char* name)
+  {
+    fprintf(stderr,
+      "usage: %s [options] CAPTURE\n"
+      "  -d, --decode         list the records and exit\n"
+      "  -t, --trace          list every frame the replayed node sends\n"
+      "  -v, --verbose        the node's Serial output\n"
+      "      --library PATH   node library (%s)\n",
+      name, replay.options.library.c_str());
+  }
+
+  bool parse_options(int argc, char** argv)
+  {
+    enum { LIBRARY = 256 };
+    const option longOptions[] = {
+      {"decode", no_argument, nullptr, 'd'},
+      {"trace", no_argument, nullptr, 't'},
+      {"verbose", no_argument, nullptr, 'v'},
+      {"library", required_argument, nullptr, LIBRARY},
+      {"help", no_argument, nullptr, 'h'},
+      {nullptr, 0, nullptr, 0}
+    };
+
+    Options& options = replay.options;
+    int c;
+    while ((c = getopt_long(argc, argv, "dtvh", longOptions, nullptr)) != -1)
+    {
+      switch (c)
+      {
+        case 'd': options.decode = true; break;
+        case 't': options.trace = true; break;
+        case 'v': options.verbose = true; break;
+        case LIBRARY: options.library = optarg; break;
+        default: return false;
+      }
+    }
+    if (optind != argc - 1)
+      return false;
+    options.path = argv[optind];
+    return true;
+  }
+};
+
+int main(int argc, char** argv)
+{
+  if (!parse_options(argc, argv))
+  {
+    usage(argv[0]);
+    return 1;
+  }
+
+  std::vector<uint8_t> bytes;
+  if (!load(replay.options.path, bytes))
+    return 1;
+  const CaptureFile c = parse(bytes);
+  if (c.records.empty())
+  {
+    fprintf(stderr, "no capture in %s\n", replay.options.path.c_str());
+    return 1;
+  }
+
+  if (replay.options.decode)
+  {
+    decode(c);
+    return 0;
+  }
+  if (!load_node(replay.options.library))
+    return 1;
+  return run(c);
+}
@@ -0,0 +1,906 @@
+/**
+ * Discrete event network simulator
+ * Runs the sketch for a handful of boxes in one process on a virtual clock. Each node is its own copy of
+ * node.so, so they all get their own globals, and the radio between them is simulated with per link loss and
+ * latency over a chosen topology. Every scenario runs in a forked child of a process that has already loaded
+ * the nodes, so thousands of them cost no more than the simulating itself.
+ *
+ * A scenario boots every node at a random time with its own clock offset and crystal drift, lets the network
+ * settle, starts a game on node 0 and then tags random nodes for random teams. It reports:
+ * - claim to display, how long after a claim each other node's table shows it
+ * - convergence, how long after the last claim every node agrees on every node's owner and on the game
+ * - frames put on the air, and how many attempts were lost to collisions
+ * - clock spread, the most any two nodes' network times were apart once the game was due to start, sampled
+ *   every SAMPLE_INTERVAL
+ *
+ * The radio: every attempt is lost independently with the link's loss, for the data and the ACK, and the sender
+ * retries like the nRF24 does. An attempt is also lost at a receiver that's transmitting itself, or hears
+ * another frame on the same channel on the air at the same time. A frame and its retries are worked out when the
+ * send starts, so the first frame on the air wins and only the one that starts later is lost. ACKs are short
+ * and left out of it
+ */
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "sim.h"
+
+namespace
+{
+  const uint8_t MAX_SIM_NODES = 64; // node.so has to be built with RADIO_IDS at least as many, see types.h
+  const int8_t NO_TEAM = -1;
+  const uint8_t TEAMS = 2;
+  const uint64_t SAMPLE_INTERVAL = 1000000; // us between clock spread samples
+  const uint32_t RACE = 200000; // us after a restart the other nodes tag within
+  const uint64_t AIR_KEPT = 100000; // us a frame is remembered after it's gone, for frames sent from behind it
+
+  inline uint64_t bit(const uint8_t node) { return static_cast<uint64_t>(1) << node; }
+
+  struct Options
+  {
+    uint8_t nodes = 8;
+    uint32_t scenarios = 1;
+    uint32_t jobs = 1;
+    uint32_t seed = 1;
+    double loss = 0.0;
+    uint32_t latency = 300; // us, on top of the airtime
+    uint32_t jitter = 200; // us
+    std::string topology = "full";
+    double density = 0.5; // for the random topology
+    uint32_t skew = 500; // clocks start up to twice this apart, ms
+    uint32_t drift = 100; // most a node's crystal is off, ppm
+    uint32_t duration = 90; // s
+    uint32_t warmup = 15; // s before the game starts
+    uint32_t restart = 0; // s a second game starts at, 0 for just the one
+    uint32_t claims = 10;
+    uint32_t retries = 15; // the nRF24's auto retransmit count
+    uint32_t loop = 2000; // how long a loop() takes at least, us
+    bool each = false;
+    bool verbose = false;
+    std::string library = "./node.so";
+    std::string serial; // directory to keep the nodes' Serial output in
+  };
+
+  struct Node
+  {
+    void* handle;
+    sim_attach_t attach;
+    sim_boot_t boot;
+    sim_start_t start;
+    sim_step_t step;
+    sim_deliver_t deliver;
+    sim_sent_t sent;
+    sim_tag_t tag;
+    sim_view_t view;
+    sim_game_t game;
+    sim_clock_t clock;
+
+    // what the radio's listening as
+    uint8_t id;
+    uint8_t channel;
+    uint8_t bitrate;
+    bool listening;
+    bool booted;
+  };
+
+  enum class EventType : uint8_t
+  {
+    BOOT,
+    START,
+    LOOP,
+    DELIVER,
+    SENT,
+    TAG,
+    SAMPLE
+  };
+
+  struct Event
+  {
+    uint64_t at;
+    uint64_t order; // keeps events at the same time in the order they were made
+    EventType type;
+    uint8_t node;
+    uint8_t length; // deliver
+    bool ok; // sent
+    int8_t team; // tag
+    uint8_t data[32];
+
+    bool operator>(const Event& other) const
+    {
+      return at != other.at ? at > other.at : order > other.order;
+    }
+  };
+
+  struct Claim
+  {
+    uint8_t node;
+    int8_t team;
+    uint64_t at;
+    uint64_t shown; // mask of nodes whose table has it
+    bool superseded;
+  };
+
+  // a frame on the air
+  struct Air
+  {
+    uint8_t from;
+    uint8_t channel;
+    uint64_t start;
+    uint64_t end;
+  };
+
+  // what a scenario sends back to the parent, followed by `samples` claim to display latencies in us
+  struct Result
+  {
+    uint32_t frames;
+    uint32_t collisions;
+    uint32_t claims;
+    int64_t convergence; // us after the last claim, -1 if it never happened
+    uint32_t missed; // claim and node pairs that never showed, and weren't replaced by a later claim first
+    bool winnersAgree;
+    uint32_t clockSpread; // us
+    uint32_t samples;
+  };
+
+  Options options;
+  Node nodes[MAX_SIM_NODES];
+  bool links[MAX_SIM_NODES][MAX_SIM_NODES];
+
+  // per scenario
+  uint32_t rng;
+  uint64_t order;
+  std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events;
+  uint32_t frames;
+  uint32_t collisions;
+  std::vector<Air> air;
+  FILE* serialFiles[MAX_SIM_NODES];
+  bool lineStart[MAX_SIM_NODES];
+
+  uint32_t next_random()
+  {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+  }
+
+  inline double uniform()
+  {
+    return next_random() / 4294967296.0;
+  }
+
+  inline uint32_t between(const uint32_t low, const uint32_t high)
+  {
+    return high <= low ? low : low + next_random() % (high - low);
+  }
+
+  void schedule(Event e)
+  {
+    e.order = order++;
+    events.push(e);
+  }
+
+  void schedule(const uint64_t at, const EventType type, const uint8_t node)
+  {
+    Event e = {};
+    e.at = at;
+    e.type = type;
+    e.node = node;
+    schedule(e);
+  }
+
+  /**
+   * Gets how long a frame is on the air, preamble, address, payload and CRC
+   */
+  uint32_t onAir(const uint8_t bitrate, const uint8_t length)
+  {
+    const uint32_t kbps = bitrate == 0 ? 2000 : bitrate == 1 ? 1000 : 250;
+    const uint32_t bits = (1 + 5 + 2 + length + 2) * 8;
+    return bits * 1000 / kbps;
+  }
+
+  /**
+   * Gets how long one attempt takes, the frame plus the radio settling
+   */
+  uint32_t airtime(const uint8_t bitrate, const uint8_t length, const bool ack)
+  {
+    // the auto-retransmit delay covers waiting for the ACK
+    return 130 + onAir(bitrate, length) + (ack ? 250 : 0);
+  }
+
+  /**
+   * Checks whether a receiver hears anything but the sender on its channel, or is sending itself
+   * @param from sending node
+   * @param receiver receiving node
+   * @param channel radio channel the frame's on
+   * @param start when the frame starts, global us
+   * @param end when it's done
+   */
+  bool collides(const uint8_t from, const uint8_t receiver, const uint8_t channel, const uint64_t start,
+    const uint64_t end)
+  {
+    for (const Air& a : air)
+    {
+      if (a.from == from || a.channel != channel || a.end <= start || a.start >= end)
+        continue;
+      if (a.from == receiver || links[a.from][receiver])
+        return true;
+    }
+    return false;
+  }
+
+  bool transmit(void* /* context */, uint8_t from, uint8_t to, const uint8_t* data, uint8_t length, bool ack,
+    uint64_t at, bool async)
+  {
+    ++frames;
+    const Node& sender = nodes[from];
+    const uint32_t attempt = airtime(sender.bitrate, length, ack);
+    const uint32_t attempts = ack ? 1 + options.retries : 1;
+    const uint32_t frame = onAir(sender.bitrate, length);
+
+    // forget frames long gone
+    air.erase(std::remove_if(air.begin(), air.end(), [at](const Air& a) { return a.end + AIR_KEPT < at; }), air.end());
+
+    uint64_t received = 0;
+    bool acked = false;
+    uint32_t used = 0;
+    while (used < attempts && !acked)
+    {
+      const uint64_t start = at + (used++) * attempt;
+      for (uint8_t r = 0; r < options.nodes; ++r)
+      {
+        const Node& receiver = nodes[r];
+        if (r == from || !links[from][r] || !receiver.booted || !receiver.listening || receiver.id != to ||
+          receiver.channel != sender.channel || receiver.bitrate != sender.bitrate)
+          continue;
+        if (collides(from, r, sender.channel, start, start + frame))
+        {
+          ++collisions;
+          continue;
+        }
+        if (uniform() < options.loss)
+          continue;
+
+        // the radio throws away retransmits of a frame it already has
+        if (!(received & bit(r)))
+        {
+          received |= bit(r);
+          Event e = {};
+          e.at = at + used * attempt + options.latency + between(0, options.jitter + 1);
+          e.type = EventType::DELIVER;
+          e.node = r;
+          e.length = length;
+          memcpy(e.data, data, length);
+          schedule(e);
+        }
+        if (ack && uniform() >= options.loss)
+          acked = true;
+      }
+      air.push_back({from, sender.channel, start, start + frame});
+    }
+
+    const bool ok = ack ? acked : true;
+    if (async)
+    {
+      Event e = {};
+      e.at = at + used * attempt + options.latency;
+      e.type = EventType::SENT;
+      e.node = from;
+      e.ok = ok;
+      schedule(e);
+    }
+    return ok;
+  }
+
+  void tune(void* /* context */, uint8_t node, uint8_t id, uint8_t channel, uint8_t bitrate)
+  {
+    nodes[node].id = id;
+    nodes[node].channel = channel;
+    nodes[node].bitrate = bitrate;
+    nodes[node].listening = true;
+  }
+
+  void listen(void* /* context */, uint8_t node, bool on)
+  {
+    nodes[node].listening = on;
+  }
+
+  void serial(void* /* context */, uint8_t node, uint8_t c)
+  {
+    if (serialFiles[node] != nullptr)
+      fputc(c, serialFiles[node]);
+    if (!options.verbose || c == '\r')
+      return;
+    if (lineStart[node])
+      printf("[%u] ", node);
+    putchar(c);
+    lineStart[node] = c == '\n';
+  }
+
+  SimHost host = {nullptr, transmit, tune, listen, serial};
+
+  void build_topology()
+  {
+    const uint8_t n = options.nodes;
+    for (uint8_t a = 0; a < n; ++a)
+    {
+      for (uint8_t b = 0; b < n; ++b)
+        links[a][b] = false;
+    }
+
+    for (uint8_t a = 0; a < n; ++a)
+    {
+      for (uint8_t b = a + 1; b < n; ++b)
+      {
+        bool link = false;
+        if (options.topology == "full")
+          link = true;
+        else if (options.topology == "line")
+          link = b == a + 1;
+        else if (options.topology == "ring")
+          link = b == a + 1 || (a == 0 && b == n - 1);
+        else if (options.topology == "star")
+          link = a == 0;
+        else if (options.topology == "random")
+          link = b == a + 1 || uniform() < options.density; // a line underneath keeps it connected
+        links[a][b] = link;
+        links[b][a] = link;
+      }
+    }
+  }
+
+  /**
+   * Runs one scenario, in a child process
+   * @param index scenario number, picks the seed
+   * @param out pipe back to the parent
+   */
+  void run_scenario(const uint32_t index, const int out)
+  {
+    rng = options.seed * 2654435761u + index * 40503u + 1;
+    if (rng == 0)
+      rng = 1;
+    order = 0;
+    frames = 0;
+    collisions = 0;
+    air.clear();
+    build_topology();
+
+    const uint8_t n = options.nodes;
+    for (uint8_t i = 0; i < n; ++i)
+    {
+      lineStart[i] = true;
+      serialFiles[i] = nullptr;
+      if (!options.serial.empty())
+      {
+        const std::string path = options.serial + "/s" + std::to_string(index) + "-n" + std::to_string(i) + ".serial";
+        serialFiles[i] = fopen(path.c_str(), "wb");
+        if (serialFiles[i] == nullptr)
+          fprintf(stderr, "can't write %s: %s\n", path.c_str(), strerror(errno));
+      }
+
+      const SimNodeConfig config = {
+        .index = i,
+        .radioID = i,
+        .channel = 0,
+        // millis() counts up from power on, so a clock can start ahead of global time but never behind it, going
+        // back past zero would look like a jump of weeks and leave everything it times stuck
+        .offset = static_cast<int32_t>(between(0, 2 * options.skew * 1000 + 1)),
+        .drift = static_cast<int32_t>(between(0, 2 * options.drift + 1)) - static_cast<int32_t>(options.drift),
+        .seed = next_random()
+      };
+      nodes[i].attach(&host, &config);
+      schedule(between(0, 1000000), EventType::BOOT, i);
+    }
+
+    const uint64_t warmup = static_cast<uint64_t>(options.warmup) * 1000000;
+    const uint64_t end = static_cast<uint64_t>(options.duration) * 1000000;
+    schedule(warmup, EventType::START, 0);
+    schedule(warmup, EventType::SAMPLE, 0);
+    // a second game, with everyone tagging while its setup is still going round so their claims race it
+    const uint64_t restart = static_cast<uint64_t>(options.restart) * 1000000;
+    if (restart != 0)
+    {
+      schedule(restart, EventType::START, 0);
+      for (uint8_t i = 1; i < n; ++i)
+      {
+        Event e = {};
+        e.at = restart + between(0, RACE);
+        e.type = EventType::TAG;
+        e.node = i;
+        e.team = next_random() % TEAMS;
+        schedule(e);
+      }
+    }
+    // claims spread over the middle of the game, leaving the last quarter to settle
+    const uint64_t first = warmup + 1000000;
+    const uint64_t last = first + (end - first) * 3 / 4;
+    for (uint32_t c = 0; c < options.claims; ++c)
+    {
+      Event e = {};
+      e.at = first + (last - first) * uniform();
+      e.type = EventType::TAG;
+      e.node = next_random() % n;
+      e.team = next_random() % TEAMS;
+      schedule(e);
+    }
+
+    // what each node shows for each node, and what each node says about itself
+    int8_t view[MAX_SIM_NODES][MAX_SIM_NODES];
+    for (uint8_t a = 0; a < n; ++a)
+    {
+      for (uint8_t b = 0; b < n; ++b)
+        view[a][b] = NO_TEAM;
+    }
+    std::vector<Claim> claims;
+    std::vector<uint32_t> samples;
+    uint64_t lastClaim = 0;
+    uint64_t agreedSince = 0;
+    bool agreed = true;
+    uint32_t clockSpread = 0;
+
+    while (!events.empty() && events.top().at <= end)
+    {
+      const Event e = events.top();
+      events.pop();
+      Node& node = nodes[e.node];
+      uint64_t busy = 0;
+
+      // how far apart everyone's network time is, against node 0's so it doesn't matter where it wraps
+      if (e.type == EventType::SAMPLE)
+      {
+        const uint32_t reference = nodes[0].clock(e.at);
+        int32_t low = 0;
+        int32_t high = 0;
+        for (uint8_t i = 1; i < n; ++i)
+        {
+          const int32_t d = static_cast<int32_t>(nodes[i].clock(e.at) - reference);
+          low = std::min(low, d);
+          high = std::max(high, d);
+        }
+        clockSpread = std::max(clockSpread, static_cast<uint32_t>(high - low) * 1000);
+        schedule(e.at + SAMPLE_INTERVAL, EventType::SAMPLE, 0);
+        continue;
+      }
+
+      switch (e.type)
+      {
+        case EventType::BOOT:
+          node.booted = true;
+          busy = node.boot(e.at);
+          schedule(busy + options.loop, EventType::LOOP, e.node);
+          break;
+        case EventType::START:
+          // the new game clears everything, nothing from the old one is still owed
+          for (Claim& c : claims)
+            c.superseded = true;
+          busy = node.start(e.at);
+          break;
+        case EventType::LOOP:
+          busy = node.step(e.at);
+          schedule(std::max(busy, e.at + options.loop), EventType::LOOP, e.node);
+          break;
+        case EventType::DELIVER:
+          if (node.booted)
+            node.deliver(e.at, e.data, e.length);
+          break;
+        case EventType::SENT:
+          node.sent(e.at, e.ok);
+          break;
+        case EventType::TAG:
+          node.tag(e.team, next_random() % 8);
+          break;
+        case EventType::SAMPLE:
+          break;
+      }
+
+      // see what changed on the node that just ran
+      bool changed = false;
+      for (uint8_t b = 0; b < n; ++b)
+      {
+        const int8_t team = node.view(b);
+        if (team == view[e.node][b])
+          continue;
+        view[e.node][b] = team;
+        changed = true;
+
+        // a node changing its own entry is a claim
+        if (b == e.node)
+        {
+          for (Claim& c : claims)
+          {
+            if (c.node == b)
+              c.superseded = true;
+          }
+          const Claim claim = {b, team, e.at, bit(b), false};
+          claims.push_back(claim);
+          lastClaim = e.at;
+          continue;
+        }
+
+        for (Claim& c : claims)
+        {
+          if (c.superseded || c.node != b || c.team != team || (c.shown & bit(e.node)))
+            continue;
+          c.shown |= bit(e.node);
+          samples.push_back(e.at - c.at);
+        }
+      }
+
+      if (!changed && e.type != EventType::TAG)
+        continue;
+      bool all = true;
+      for (uint8_t a = 0; a < n && all; ++a)
+      {
+        for (uint8_t b = 0; b < n && all; ++b)
+          all = view[a][b] == view[b][b];
+      }
+      if (all && !agreed)
+        agreedSince = e.at;
+      agreed = all;
+    }
+
+    for (uint8_t i = 0; i < n; ++i)
+    {
+      if (serialFiles[i] != nullptr)
+        fclose(serialFiles[i]);
+    }
+
+    Result result = {};
+    result.frames = frames;
+    result.collisions = collisions;
+    result.clockSpread = clockSpread;
+    result.claims = claims.size();
+    result.convergence = agreed ? static_cast<int64_t>(agreedSince > lastClaim ? agreedSince - lastClaim : 0) : -1;
+    const uint64_t everyone = n == 64 ? UINT64_MAX : bit(n) - 1;
+    for (const Claim& c : claims)
+    {
+      if (!c.superseded && c.shown != everyone)
+        result.missed += n - __builtin_popcountll(c.shown);
+    }
+
+    SimGame reference;
+    nodes[0].game(&reference);
+    result.winnersAgree = true;
+    for (uint8_t i = 1; i < n; ++i)
+    {
+      SimGame g;
+      nodes[i].game(&g);
+      if (g.start != reference.start || g.end != reference.end || g.winner != reference.winner)
+        result.winnersAgree = false;
+    }
+
+    result.samples = samples.size();
+    if (write(out, &result, sizeof(result)) != sizeof(result) ||
+      (result.samples && write(out, samples.data(), samples.size() * sizeof(uint32_t)) < 0))
+      exit(1);
+  }
+
+  /**
+   * Loads a copy of the node library per node, dlopen hands back the same one for the same path
+   */
+  bool load_nodes()
+  {
+    char dir[] = "/tmp/domination-sim-XXXXXX";
+    if (mkdtemp(dir) == nullptr)
+    {
+      perror("mkdtemp");
+      return false;
+    }
+
+    FILE* in = fopen(options.library.c_str(), "rb");
+    if (in == nullptr)
+    {
+      fprintf(stderr, "can't open %s: %s\n", options.library.c_str(), strerror(errno));
+      return false;
+    }
+    std::vector<char> image;
+    char buffer[65536];
+    size_t got;
+    while ((got = fread(buffer, 1, sizeof(buffer), in)) > 0)
+      image.insert(image.end(), buffer, buffer + got);
+    fclose(in);
+
+    bool ok = true;
+    for (uint8_t i = 0; i < options.nodes && ok; ++i)
+    {
+      const std::string path = std::string(dir) + "/node" + std::to_string(i) + ".so";
+      FILE* copy = fopen(path.c_str(), "wb");
+      ok = copy != nullptr && fwrite(image.data(), 1, image.size(), copy) == image.size();
+      if (copy != nullptr)
+        fclose(copy);
+
+      Node& node = nodes[i];
+      node.handle = ok ? dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL) : nullptr;
+      unlink(path.c_str());
+      if (node.handle == nullptr)
+      {
+        fprintf(stderr, "can't load %s: %s\n", path.c_str(), ok ? dlerror() : strerror(errno));
+        ok = false;
+        break;
+      }
+
+      node.attach = reinterpret_cast<sim_attach_t>(dlsym(node.handle, "sim_attach"));
+      node.boot = reinterpret_cast<sim_boot_t>(dlsym(node.handle, "sim_boot"));
+      node.start = reinterpret_cast<sim_start_t>(dlsym(node.handle, "sim_start"));
+      node.step = reinterpret_cast<sim_step_t>(dlsym(node.handle, "sim_step"));
+      node.deliver = reinterpret_cast<sim_deliver_t>(dlsym(node.handle, "sim_deliver"));
+      node.sent = reinterpret_cast<sim_sent_t>(dlsym(node.handle, "sim_sent"));
+      node.tag = reinterpret_cast<sim_tag_t>(dlsym(node.handle, "sim_tag"));
+      node.view = reinterpret_cast<sim_view_t>(dlsym(node.handle, "sim_view"));
+      node.game = reinterpret_cast<sim_game_t>(dlsym(node.handle, "sim_game"));
+      node.clock = reinterpret_cast<sim_clock_t>(dlsym(node.handle, "sim_clock"));
+      if (!node.attach || !node.boot || !node.start || !node.step || !node.deliver || !node.sent || !node.tag ||
+        !node.view || !node.game || !node.clock)
+      {
+        fprintf(stderr, "%s is missing the sim_* functions\n", options.library.c_str());
+        ok = false;
+      }
+    }
+    rmdir(dir);
+    return ok;
+  }
+
+  struct Totals
+  {
+    uint32_t scenarios = 0;
+    uint32_t converged = 0;
+    uint32_t agreed = 0;
+    uint64_t frames = 0;
+    uint64_t collisions = 0;
+    uint64_t claims = 0;
+    uint64_t missed = 0;
+    std::vector<uint32_t> convergence; // us
+    std::vector<uint32_t> display; // us
+    std::vector<uint32_t> clockSpread; // us
+  };
+
+  bool collect(const int in, const uint32_t index, Totals& totals)
+  {
+    Result result;
+    if (read(in, &result, sizeof(result)) != sizeof(result))
+      return false;
+    std::vector<uint32_t> samples(result.samples);
+    size_t want = samples.size() * sizeof(uint32_t);
+    uint8_t* p = reinterpret_cast<uint8_t*>(samples.data());
+    while (want > 0)
+    {
+      const ssize_t got = read(in, p, want);
+      if (got <= 0)
+        return false;
+      p += got;
+      want -= got;
+    }
+
+    ++totals.scenarios;
+    totals.frames += result.frames;
+    totals.collisions += result.collisions;
+    totals.clockSpread.push_back(result.clockSpread);
+    totals.claims += result.claims;
+    totals.missed += result.missed;
+    if (result.convergence >= 0)
+    {
+      ++totals.converged;
+      totals.convergence.push_back(result.convergence);
+    }
+    if (result.winnersAgree)
+      ++totals.agreed;
+    totals.display.insert(totals.display.end(), samples.begin(), samples.end());
+
+    if (options.each)
+    {
+      printf("scenario %u frames %u collisions %u claims %u converged %s%.1fms missed %u winners %s clocks %ums\n",
+        index, result.frames, result.collisions, result.claims, result.convergence >= 0 ? "" : "never ",
+        result.convergence / 1000.0, result.missed, result.winnersAgree ? "agree" : "differ",
+        result.clockSpread / 1000);
+    }
+    return true;
+  }
+
+  void print_spread(const char* name, std::vector<uint32_t>& values)
+  {
+    if (values.empty())
+    {
+      printf("%-18s none\n", name);
+      return;
+    }
+    std::sort(values.begin(), values.end());
+    uint64_t total = 0;
+    for (const uint32_t v : values)
+      total += v;
+    printf("%-18s mean %.1fms p50 %.1fms p95 %.1fms max %.1fms (%zu)\n", name, total / 1000.0 / values.size(),
+      values[values.size() / 2] / 1000.0, values[values.size() * 95 / 100] / 1000.0, values.back() / 1000.0,
+      values.size());
+  }
+
+  void usage(const char* name)
+  {
+    fprintf(stderr,
+      "usage: %s [options]\n"
+      "  -n, --nodes N        nodes, up to %u (%u)\n"
+      "  -s, --scenarios N    scenarios to run (%u)\n"
+      "  -j, --jobs N         scenarios at once (%u)\n"
+      "      --seed N         (%u)\n"
+      "  -l, --loss P         chance of losing each frame or ACK on a link (%.2f)\n"
+      "      --latency US     on top of airtime (%u)\n"
+      "      --jitter US      (%u)\n"
+      "  -t, --topology T     full, line, ring, star or random (%s)\n"
+      "      --density P      chance of each extra link with random (%.2f)\n"
+      "      --skew MS        clocks start up to twice this apart (%u)\n"
+      "      --drift PPM      most a crystal is off (%u)\n"
+      "  -d, --duration S     (%u)\n"
+      "      --warmup S       before the game starts (%u)\n"
+      "      --restart S      start a second game, with a tag on every other node as it goes round (%u)\n"
+      "  -c, --claims N       tags per scenario (%u)\n"
+      "      --retries N      auto retransmits (%u)\n"
+      "      --loop US        shortest loop() (%u)\n"
+      "      --library PATH   node library (%s)\n"
+      "      --serial DIR     keep each node's Serial output, captures included, in DIR/s<scenario>-n<node>.serial\n"
+      "  -e, --each           a line per scenario\n"
+      "  -v, --verbose        the nodes' Serial output\n",
+      name, MAX_SIM_NODES, options.nodes, options.scenarios, options.jobs, options.seed, options.loss,
+      options.latency, options.jitter, options.topology.c_str(), options.density, options.skew, options.drift,
+      options.duration, options.warmup, options.restart, options.claims, options.retries, options.loop, options.library.c_str());
+  }
+
+  bool parse(int argc, char** argv)
+  {
+    enum { SEED = 256, LATENCY, JITTER, DENSITY, SKEW, DRIFT, WARMUP, RESTART, RETRIES, LOOP, LIBRARY, SERIAL };
+    const option longOptions[] = {
+      {"nodes", required_argument, nullptr, 'n'},
+      {"scenarios", required_argument, nullptr, 's'},
+      {"jobs", required_argument, nullptr, 'j'},
+      {"seed", required_argument, nullptr, SEED},
+      {"loss", required_argument, nullptr, 'l'},
+      {"latency", required_argument, nullptr, LATENCY},
+      {"jitter", required_argument, nullptr, JITTER},
+      {"topology", required_argument, nullptr, 't'},
+      {"density", required_argument, nullptr, DENSITY},
+      {"skew", required_argument, nullptr, SKEW},
+      {"drift", required_argument, nullptr, DRIFT},
+      {"duration", required_argument, nullptr, 'd'},
+      {"warmup", required_argument, nullptr, WARMUP},
+      {"restart", required_argument, nullptr, RESTART},
+      {"claims", required_argument, nullptr, 'c'},
+      {"retries", required_argument, nullptr, RETRIES},
+      {"loop", required_argument, nullptr, LOOP},
+      {"library", required_argument, nullptr, LIBRARY},
+      {"serial", required_argument, nullptr, SERIAL},
+      {"each", no_argument, nullptr, 'e'},
+      {"verbose", no_argument, nullptr, 'v'},
+      {"help", no_argument, nullptr, 'h'},
+      {nullptr, 0, nullptr, 0}
+    };
+
+    int c;
+    while ((c = getopt_long(argc, argv, "n:s:j:l:t:d:c:evh", longOptions, nullptr)) != -1)
+    {
+      switch (c)
+      {
+        case 'n': options.nodes = atoi(optarg); break;
+        case 's': options.scenarios = atoi(optarg); break;
+        case 'j': options.jobs = atoi(optarg); break;
+        case SEED: options.seed = strtoul(optarg, nullptr, 0); break;
+        case 'l': options.loss = atof(optarg); break;
+        case LATENCY: options.latency = atoi(optarg); break;
+        case JITTER: options.jitter = atoi(optarg); break;
+        case 't': options.topology = optarg; break;
+        case DENSITY: options.density = atof(optarg); break;
+        case SKEW: options.skew = atoi(optarg); break;
+        case DRIFT: options.drift = atoi(optarg); break;
+        case 'd': options.duration = atoi(optarg); break;
+        case WARMUP: options.warmup = atoi(optarg); break;
+        case RESTART: options.restart = atoi(optarg); break;
+        case 'c': options.claims = atoi(optarg); break;
+        case RETRIES: options.retries = atoi(optarg); break;
+        case LOOP: options.loop = atoi(optarg); break;
+        case LIBRARY: options.library = optarg; break;
+        case SERIAL: options.serial = optarg; break;
+        case 'e': options.each = true; break;
+        case 'v': options.verbose = true; break;
+        default: return false;
+      }
+    }
+
+    const char* topologies[] = {"full", "line", "ring", "star", "random"};
+    if (std::find(std::begin(topologies), std::end(topologies), options.topology) == std::end(topologies))
+    {
+      fprintf(stderr, "unknown topology %s\n", options.topology.c_str());
+      return false;
+    }
+    if (options.nodes < 2 || options.nodes > MAX_SIM_NODES || options.jobs == 0 || options.warmup >= options.duration ||
+      (options.restart != 0 && (options.restart <= options.warmup || options.restart >= options.duration)))
+      return false;
+    return true;
+  }
+};
+
+int main(int argc, char** argv)
+{
+  if (!parse(argc, argv))
+  {
+    usage(argv[0]);
+    return 1;
+  }
+  if (!load_nodes())
+    return 1;
+
+  printf("%u nodes, %s topology, %.0f%% loss, %uus latency, %u claims in %us, %u scenarios\n", options.nodes,
+    options.topology.c_str(), options.loss * 100, options.latency, options.claims, options.duration,
+    options.scenarios);
+  fflush(stdout);
+
+  // fork a child per scenario, with up to `jobs` of them running, and collect them in order
+  Totals totals;
+  struct Child
+  {
+    pid_t pid;
+    int pipe;
+    uint32_t index;
+  };
+  std::vector<Child> running;
+  uint32_t next = 0;
+  while (next < options.scenarios || !running.empty())
+  {
+    while (next < options.scenarios && running.size() < options.jobs)
+    {
+      int fds[2];
+      if (pipe(fds) != 0)
+      {
+        perror("pipe");
+        return 1;
+      }
+      // or the child flushes whatever collect() has buffered a second time
+      fflush(stdout);
+      const pid_t pid = fork();
+      if (pid < 0)
+      {
+        perror("fork");
+        return 1;
+      }
+      if (pid == 0)
+      {
+        close(fds[0]);
+        run_scenario(next, fds[1]);
+        fflush(stdout);
+        _exit(0);
+      }
+      close(fds[1]);
+      running.push_back({pid, fds[0], next});
+      ++next;
+    }
+
+    const Child child = running.front();
+    running.erase(running.begin());
+    const bool ok = collect(child.pipe, child.index, totals);
+    close(child.pipe);
+    int status;
+    waitpid(child.pid, &status, 0);
+    if (!ok)
+      fprintf(stderr, "scenario %u failed\n", child.index);
+  }
+
+  if (totals.scenarios == 0)
+    return 1;
+  printf("converged          %u/%u\n", totals.converged, totals.scenarios);
+  print_spread("convergence", totals.convergence);
+  print_spread("claim to display", totals.display);
+  printf("missed displays    %lu\n", static_cast<unsigned long>(totals.missed));
+  printf("games agree        %u/%u\n", totals.agreed, totals.scenarios);
+  printf("frames             %.1f a scenario, %.1f a node a second\n", static_cast<double>(totals.frames) / totals.scenarios,
+    static_cast<double>(totals.frames) / totals.scenarios / options.nodes / options.duration);
+  printf("collisions         %.1f a scenario\n", static_cast<double>(totals.collisions) / totals.scenarios);
+  print_spread("clock spread", totals.clockSpread);
+  return totals.converged == totals.scenarios ? 0 : 2;
+}
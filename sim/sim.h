@@ -0,0 +1,89 @@
+#ifndef SIM_H_INCLUDE
+#define SIM_H_INCLUDE
+
+#include <stdint.h>
+
+/**
+ * Interface between the simulator and the nodes it runs
+ * Each node is its own copy of node.so, so every node gets its own set of the sketch's globals without the
+ * sketch knowing. The host drives a node through the sim_* functions and the node calls back through SimHost
+ */
+extern "C"
+{
+  struct SimHost
+  {
+    void* context;
+
+    /**
+     * Puts a frame on the air
+     * @param node index of the sending node
+     * @param to radio ID it's addressed to
+     * @param ack true if the sender wants an auto-ACK
+     * @param at global time the send starts, us
+     * @param async true if the node wants told how it went, false if it's blocked waiting
+     * @return true if it was acknowledged, or went out at all without an ACK
+     */
+    bool (*transmit)(void* context, uint8_t node, uint8_t to, const uint8_t* data, uint8_t length, bool ack,
+      uint64_t at, bool async);
+
+    /**
+     * Tells the host what the node's radio is listening as
+     * @param node index of the node
+     * @param id radio ID
+     * @param channel radio channel
+     * @param bitrate NRFLite bitrate
+     */
+    void (*tune)(void* context, uint8_t node, uint8_t id, uint8_t channel, uint8_t bitrate);
+
+    /**
+     * Tells the host the node's radio has powered down or come back up, it hears nothing while it's down
+     * @param node index of the node
+     * @param on true if it's listening
+     */
+    void (*listen)(void* context, uint8_t node, bool on);
+
+    /**
+     * Takes a byte of the node's Serial output
+     * @param node index of the node
+     * @param c the byte, text or capture records, see capture.h
+     */
+    void (*serial)(void* context, uint8_t node, uint8_t c);
+  };
+
+  struct SimNodeConfig
+  {
+    uint8_t index;
+    uint8_t radioID;
+    uint8_t channel;
+    int32_t offset; // where the node's millis() starts relative to global time, us
+    int32_t drift; // how fast its crystal runs, ppm
+    uint32_t seed; // for random()
+  };
+
+  struct SimGame
+  {
+    uint32_t start;
+    uint32_t end;
+    uint8_t endedBy;
+    int8_t winner;
+  };
+
+  // each of these returns where the node's CPU has got to in global time, us
+  typedef void (*sim_attach_t)(const SimHost* host, const SimNodeConfig* config);
+  typedef uint64_t (*sim_boot_t)(uint64_t now);
+  typedef uint64_t (*sim_start_t)(uint64_t now);
+  typedef uint64_t (*sim_step_t)(uint64_t now);
+  typedef uint64_t (*sim_deliver_t)(uint64_t now, const uint8_t* data, uint8_t length);
+  typedef uint64_t (*sim_sent_t)(uint64_t now, bool ok);
+  typedef uint64_t (*sim_restart_t)(uint64_t now, uint32_t seed);
+  // how many more frames the node's radio can take
+  typedef uint8_t (*sim_room_t)();
+
+  typedef void (*sim_tag_t)(int8_t team, int8_t player);
+  typedef int8_t (*sim_view_t)(uint8_t node);
+  typedef void (*sim_game_t)(SimGame* game);
+  // the node's network time at a global time, ms, see clocksync.h
+  typedef uint32_t (*sim_clock_t)(uint64_t now);
+}
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef ARDUINO_H_INCLUDE
+#define ARDUINO_H_INCLUDE
+
+/**
+ * Just enough of the Arduino core for the sketch to build on a PC, implemented in board.cpp
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+static const uint8_t A0 = 14;
+static const uint8_t A1 = 15;
+static const uint8_t A2 = 16;
+static const uint8_t A3 = 17;
+static const uint8_t A4 = 18;
+static const uint8_t A5 = 19;
+
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define LOW 0
+#define HIGH 1
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+#define DEC 10
+#define HEX 16
+#define LED_BUILTIN 13
+
+// the RAM budget build puts them in a section of their own, to leave out
+#ifndef PROGMEM
+#define PROGMEM
+#endif
+class __FlashStringHelper;
+#ifndef F
+#define F(x) (reinterpret_cast<const __FlashStringHelper*>(x))
+#endif
+typedef const char* PGM_P;
+#define pgm_read_byte(x) (*(const uint8_t*)(x))
+#define pgm_read_word(x) (*(const uint16_t*)(x))
+#define pgm_read_ptr(x) (*(void* const*)(x))
+#define strlen_P strlen
+#define strcpy_P strcpy
+#define strncpy_P strncpy
+#define digitalPinToInterrupt(p) ((p) == 2 ? 0 : (p) == 3 ? 1 : -1)
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+
+uint32_t millis();
+uint32_t micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+void tone(uint8_t pin, unsigned int frequency, unsigned long duration = 0);
+void noTone(uint8_t pin);
+
+long random(long max);
+long random(long min, long max);
+void randomSeed(unsigned long seed);
+
+void attachInterrupt(uint8_t interrupt, void (*isr)(), int mode);
+void detachInterrupt(uint8_t interrupt);
+void noInterrupts();
+void interrupts();
+
+class Print
+{
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size);
+
+  size_t print(const char* s);
+  size_t print(char c);
+  size_t print(int n, int base = DEC);
+  size_t print(unsigned n, int base = DEC);
+  size_t print(long n, int base = DEC);
+  size_t print(unsigned long n, int base = DEC);
+  size_t print(double n, int digits = 2);
+
+  size_t println();
+  size_t println(const char* s);
+  size_t println(char c);
+  size_t println(int n, int base = DEC);
+  size_t println(unsigned n, int base = DEC);
+  size_t println(long n, int base = DEC);
+  size_t println(unsigned long n, int base = DEC);
+  size_t println(double n, int digits = 2);
+};
+
+class HardwareSerial : public Print
+{
+public:
+  void begin(unsigned long /* baud */) {}
+  operator bool() { return true; }
+  int available() { return 0; }
+  int read() { return -1; }
+  // writes go straight out, so the buffer's always as empty as the AVR core's 64 bytes get
+  int availableForWrite() { return 63; }
+  virtual size_t write(uint8_t c);
+  using Print::write;
+};
+extern HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef EEPROM_H_INCLUDE
+#define EEPROM_H_INCLUDE
+
+#include <stdint.h>
+
+/**
+ * 1KB of EEPROM like the ATmega328, starting out erased
+ */
+struct EEPROMClass
+{
+  static const uint16_t SIZE = 1024;
+
+  EEPROMClass()
+  {
+    for (uint16_t i = 0; i < SIZE; ++i)
+      data[i] = 0xFF;
+  }
+
+  uint8_t read(int index) { return data[index]; }
+  void write(int index, uint8_t value) { data[index] = value; }
+  void update(int index, uint8_t value) { data[index] = value; }
+  uint16_t length() { return SIZE; }
+
+  uint8_t data[SIZE];
+};
+extern EEPROMClass EEPROM;
+
+#endif
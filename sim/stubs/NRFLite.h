@@ -0,0 +1,34 @@
+#ifndef NRFLITE_H_INCLUDE
+#define NRFLITE_H_INCLUDE
+
+#include <Arduino.h>
+
+/**
+ * The NRFLite API over the simulated air, implemented in board.cpp
+ * One radio per node, like the boxes
+ */
+class NRFLite
+{
+public:
+  enum Bitrates { BITRATE2MBPS, BITRATE1MBPS, BITRATE250KBPS };
+  enum SendType { REQUIRE_ACK, NO_ACK };
+
+  static const uint8_t MAX_NRF_CHANNEL = 125;
+
+  uint8_t init(uint8_t radioId, uint8_t cePin, uint8_t csnPin, Bitrates bitrate = BITRATE2MBPS, uint8_t channel = 100,
+    uint8_t callSpiBegin = 1);
+  uint8_t hasData(uint8_t usingInterrupts = 0);
+  void readData(void* data);
+  void discardData(uint8_t unexpectedDataLength);
+  uint8_t send(uint8_t toRadioId, void* data, uint8_t length, SendType sendType = REQUIRE_ACK);
+  void startSend(uint8_t toRadioId, void* data, uint8_t length, SendType sendType = REQUIRE_ACK);
+  void whenInterrupts(uint8_t& txOk, uint8_t& txFail, uint8_t& rxReady);
+  void startRx();
+  void powerDown();
+  void printDetails() {}
+  void addAckData(void* data, uint8_t length, uint8_t removeExistingAcks = 0) {}
+  uint8_t hasAckData() { return 0; }
+  uint8_t scanChannel(uint8_t channel, uint8_t measurementCount = 255) { return 0; }
+};
+
+#endif
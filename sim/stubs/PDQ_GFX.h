@@ -0,0 +1,6 @@
+#ifndef PDQ_GFX_H_INCLUDE
+#define PDQ_GFX_H_INCLUDE
+
+#include <Arduino.h>
+
+#endif
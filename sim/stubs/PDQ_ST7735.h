@@ -0,0 +1,46 @@
+#ifndef PDQ_ST7735_H_INCLUDE
+#define PDQ_ST7735_H_INCLUDE
+
+#include <Arduino.h>
+
+/**
+ * A screen nobody looks at, drawing costs nothing
+ */
+class PDQ_ST7735 : public Print
+{
+public:
+  void initR(uint8_t options) {}
+  void setRotation(uint8_t rotation) {}
+  int16_t width() { return 160; }
+  int16_t height() { return 128; }
+
+  void fillScreen(uint16_t colour) {}
+  void drawPixel(int16_t x, int16_t y, uint16_t colour) {}
+  void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t colour) {}
+  void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t colour) {}
+  void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t colour) {}
+  void drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t colour) {}
+  void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t colour) {}
+  void drawCircle(int16_t x, int16_t y, int16_t r, uint16_t colour) {}
+  void fillCircle(int16_t x, int16_t y, int16_t r, uint16_t colour) {}
+
+  void setCursor(int16_t x, int16_t y) {}
+  void setTextColor(uint16_t colour) {}
+  void setTextColor(uint16_t colour, uint16_t background) {}
+  void setTextSize(uint8_t size) {}
+  void setTextWrap(bool wrap) {}
+
+  // 6x8 characters, like the built in font
+  void getTextBounds(char* s, int16_t x, int16_t y, int16_t* x1, int16_t* y1, uint16_t* w, uint16_t* h)
+  {
+    *x1 = x;
+    *y1 = y;
+    *w = 6 * strlen(s);
+    *h = 8;
+  }
+
+  virtual size_t write(uint8_t c) { return 1; }
+  using Print::write;
+};
+
+#endif
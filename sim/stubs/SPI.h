@@ -0,0 +1,31 @@
+#ifndef SPI_H_INCLUDE
+#define SPI_H_INCLUDE
+
+#include <Arduino.h>
+
+#define MSBFIRST 1
+#define SPI_MODE0 0
+#define SPI_CLOCK_DIV4 0
+
+struct SPISettings
+{
+  SPISettings() {}
+  SPISettings(uint32_t clock, uint8_t order, uint8_t mode) {}
+};
+
+/**
+ * Nothing's on the bus, the radio and RFID reader are simulated above it
+ */
+class SPIClass
+{
+public:
+  void begin() {}
+  void end() {}
+  void beginTransaction(SPISettings settings) {}
+  void endTransaction() {}
+  void usingInterrupt(uint8_t interrupt) {}
+  uint8_t transfer(uint8_t data) { return 0; }
+};
+extern SPIClass SPI;
+
+#endif
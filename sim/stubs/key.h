@@ -0,0 +1,2 @@
+// simulated boxes don't need a real key, ../key.h gets picked up first if there is one
+#include "../../key.example.h"
@@ -0,0 +1,10 @@
+#ifndef NEW_H_INCLUDE
+#define NEW_H_INCLUDE
+
+/**
+ * The Arduino core's new.h, for placement new
+ */
+
+#include <new>
+
+#endif
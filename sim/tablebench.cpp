@@ -0,0 +1,140 @@
+/**
+ * RAM budget and speed of the node table
+ * Compares the packed NodeTable with the table of structs it replaced, at 8, 32 and 64 nodes. The old layout is
+ * sized as avr-gcc packs it, byte aligned. The new one is measured, which on a PC rounds its bit sets up to
+ * 32 bit words where the AVR uses bytes, so it overstates the AVR size by a few bytes at most.
+ * The benchmark runs nodes_online() and win() both ways on random tables at 64 nodes. It's timed on this
+ * machine, so the ratio means more than the nanoseconds
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+
+#include "../types.h"
+#include "../nodetable.h"
+
+namespace
+{
+  const uint8_t TEAMS = 2;
+  const uint16_t SRAM = 2048;
+
+  // the old NodeState, laid out the way avr-gcc does it
+#pragma pack(push, 1)
+  struct LegacyNode
+  {
+    millis_t lastUpdate;
+    millis_t latency;
+    uint32_t lat;
+    uint32_t lng;
+    team_id team;
+    version_t version;
+    millis_t claimed;
+  };
+#pragma pack(pop)
+
+  template <uint8_t TNodes>
+  void budget()
+  {
+    const unsigned before = sizeof(LegacyNode) * TNodes;
+    const unsigned after = sizeof(NodeTable<TNodes, TEAMS>);
+    printf("%5u %7u %5.1f%% %7u %5.1f%%\n", TNodes, before, 100.0 * before / SRAM, after, 100.0 * after / SRAM);
+  }
+
+  const uint8_t BENCH_NODES = 64;
+  const uint32_t ROUNDS = 1000000;
+
+  LegacyNode legacy[BENCH_NODES];
+  bool legacyOnline[BENCH_NODES];
+  NodeTable<BENCH_NODES, TEAMS> table;
+  NodeTable<BENCH_NODES, TEAMS>::Set online;
+
+  /**
+   * The loops nodes_online() and win() used to be
+   */
+  uint8_t legacy_count()
+  {
+    uint8_t c = 0;
+    for (uint8_t i = 0; i < BENCH_NODES; ++i)
+    {
+      if (legacyOnline[i])
+        ++c;
+    }
+    return c;
+  }
+
+  team_id legacy_win()
+  {
+    team_id team = NO_TEAM;
+    for (uint8_t i = 0; i < BENCH_NODES; ++i)
+    {
+      if (!legacyOnline[i])
+        continue;
+      if (team == NO_TEAM)
+        team = legacy[i].team;
+      else if (team != legacy[i].team)
+        return NO_TEAM;
+    }
+    return team;
+  }
+
+  /**
+   * Fills both tables the same way, mostly one team so win() has to look at most of the nodes
+   */
+  void fill(const bool won)
+  {
+    table.init();
+    online.clear();
+    for (uint8_t i = 0; i < BENCH_NODES; ++i)
+    {
+      const team_id team = won || i < BENCH_NODES - 1 ? 0 : 1;
+      const bool up = rand() % 8 != 0;
+      legacy[i].team = team;
+      legacyOnline[i] = up;
+      table.setTeam(i, team);
+      online.assign(i, up);
+    }
+  }
+
+  template <typename TFunction>
+  double time(TFunction function)
+  {
+    volatile int sink = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t r = 0; r < ROUNDS; ++r)
+      sink += function();
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / ROUNDS;
+  }
+};
+
+int main()
+{
+  printf("node table RAM, bytes and share of the ATmega328's %u bytes\n", SRAM);
+  printf("nodes  before        after\n");
+  budget<8>();
+  budget<32>();
+  budget<64>();
+  budget<128>();
+  printf("\n");
+
+  printf("%u nodes, ns a call        before   after\n", BENCH_NODES);
+  for (int won = 1; won >= 0; --won)
+  {
+    fill(won);
+    if (legacy_count() != online.count() || (legacy_win() == NO_TEAM) != (table.winner(online) == NO_TEAM))
+    {
+      printf("the two tables disagree\n");
+      return 1;
+    }
+    const double countBefore = time([]() { return legacy_count(); });
+    const double countAfter = time([]() { return online.count(); });
+    const double winBefore = time([]() { return legacy_win(); });
+    const double winAfter = time([]() { return table.winner(online); });
+    printf("nodes_online()               %7.1f %7.1f\n", countBefore, countAfter);
+    printf("win(), %-20s %7.1f %7.1f\n", won ? "one team owns all" : "one node holds out", winBefore, winAfter);
+  }
+  return 0;
+}
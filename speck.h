@@ -0,0 +1,45 @@
+#ifndef SPECK_H_INCLUDE
+#define SPECK_H_INCLUDE
+
+#include <stdint.h>
+
+/**
+ * Speck64/128 block cipher, encryption only
+ * Nothing but 32 bit adds, rotates and XORs, which an 8 bit AVR does a byte at a time without any tables.
+ * The round keys are worked out alongside the rounds rather than stored, which costs about as much again as the
+ * rounds themselves but keeps 108 bytes of round keys out of RAM
+ */
+namespace speck
+{
+  const uint8_t ROUNDS = 27;
+  const uint8_t BLOCK_SIZE = 8;
+
+  inline uint32_t ror(const uint32_t x, const uint8_t r) { return (x >> r) | (x << (32 - r)); }
+  inline uint32_t rol(const uint32_t x, const uint8_t r) { return (x << r) | (x >> (32 - r)); }
+
+  /**
+   * Encrypts one block in place
+   * @param key the four key words, k0 then l0 to l2, as the Speck paper numbers them
+   * @param x high word of the block
+   * @param y low word of the block
+   */
+  inline void encrypt(const uint32_t key[4], uint32_t& x, uint32_t& y)
+  {
+    uint32_t k = key[0];
+    uint32_t l[3] = {key[1], key[2], key[3]};
+    uint8_t j = 0; // i % 3, without a division the AVR doesn't have
+    for (uint8_t i = 0; i < ROUNDS; ++i)
+    {
+      x = (ror(x, 8) + y) ^ k;
+      y = rol(y, 3) ^ x;
+
+      // the key schedule is the round function again, with the round number as the key
+      l[j] = (k + ror(l[j], 8)) ^ i;
+      k = rol(k, 3) ^ l[j];
+      if (++j == 3)
+        j = 0;
+    }
+  }
+};
+
+#endif
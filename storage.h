@@ -6,30 +6,30 @@
 
 namespace storage
 {
-  static uint8_t read(const size_t index)
+  static inline uint8_t read(const size_t index)
   {
     return EEPROM.read(index);
   }
 
-  static void read(const size_t index, uint8_t* const buf, const size_t len)
+  static inline void read(const size_t index, uint8_t* const buf, const size_t len)
   {
     for (size_t i = 0; i < len; ++i)
       buf[i] = storage::read(index + i);
   }
 
-  static void write(const size_t index, uint8_t data)
+  static inline void write(const size_t index, uint8_t data)
   {
     // use update instead of write to prevent unnecessary writes
     EEPROM.update(index, data);
   }
 
-  static void write(const size_t index, uint8_t* const buf, const size_t len)
+  static inline void write(const size_t index, uint8_t* const buf, const size_t len)
   {
     for (size_t i = 0; i < len; ++i)
       storage::write(index + i, buf[i]);
   }
 
-  static uint32_t crc32(const size_t start = 0, const size_t end = EEPROM.length())
+  static inline uint32_t crc32(const size_t start = 0, const size_t end = EEPROM.length())
   {
     const uint32_t crc_table[16] = {
       0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac,
@@ -0,0 +1,45 @@
+#ifndef TDMA_H_INCLUDE
+#define TDMA_H_INCLUDE
+
+#include <stdint.h>
+
+#include "types.h"
+#include "txqueue.h"
+
+/**
+ * Time slotted transmit schedule
+ * Network time is cut into superframes of one slot per radio ID plus a contention slot at the end. A node only
+ * starts sending in its own slot, except for urgent packets which anyone can send in the contention slot
+ */
+namespace tdma
+{
+  // long enough for a full frame and a good few retries at 2MBPS
+  const millis_t SLOT_LENGTH = 10;
+  // no new sends this close to the end of a slot, so the retries don't spill into the next one
+  const millis_t GUARD = 4;
+
+  const uint8_t CONTENTION_SLOT = MAX_NODES;
+  const millis_t SUPERFRAME = SLOT_LENGTH * (MAX_NODES + 1);
+
+  /**
+   * Gets what we're allowed to send at a point in time
+   * @param time network time
+   * @param me our radio ID
+   * @return the transmit window
+   */
+  inline TxWindow window(const millis_t time, const radio_id me)
+  {
+    const millis_t into = time % SUPERFRAME;
+    if (into % SLOT_LENGTH >= SLOT_LENGTH - GUARD)
+      return TxWindow::CLOSED;
+
+    const uint8_t slot = into / SLOT_LENGTH;
+    if (slot == me)
+      return TxWindow::OPEN;
+    if (slot == CONTENTION_SLOT)
+      return TxWindow::URGENT;
+    return TxWindow::CLOSED;
+  }
+};
+
+#endif
@@ -0,0 +1,318 @@
+#ifndef TXQUEUE_H_INCLUDE
+#define TXQUEUE_H_INCLUDE
+
+#include <stdint.h>
+#include <string.h>
+
+#include <Arduino.h>
+#include <NRFLite.h>
+
+#include "types.h"
+#include "packets.h"
+
+/**
+ * outcome of the most recent packet queued for a destination
+ */
+enum class TxStatus : uint8_t
+{
+  NONE,    // nothing has been queued for this destination
+  PENDING, // queued, waiting on the radio
+  SENT,    // acknowledged by the destination
+  FAILED,  // the radio ran out of retries
+  DROPPED  // the queue was full
+};
+
+/**
+ * what the queue is allowed to start sending right now
+ */
+enum class TxWindow : uint8_t
+{
+  CLOSED, // nothing
+  URGENT, // only frames with an urgent packet in them
+  OPEN    // anything
+};
+
+/**
+ * Outbound frame queue
+ * Each entry is a frame being built up for a set of destinations. Packets for the same destinations are
+ * appended to a frame that hasn't gone yet, and a frame goes once it's full or the most impatient packet in
+ * it is due. update() drives the radio one destination at a time with startSend() and polls for the result,
+ * so nothing ever waits on the auto-ACK
+ * @param TCapacity number of frames that can be waiting
+ * @param TDestinations number of radio IDs a frame can be sent to
+ */
+template <uint8_t TCapacity, uint8_t TDestinations>
+class TxQueue
+{
+public:
+  static_assert(TDestinations <= sizeof(node_mask_t) * 8, "node_mask_t is too small for TDestinations");
+
+  typedef void(*callback_t)(const radio_id target, const TxStatus status);
+  // brings the time stamps in a frame up to date as it goes to the radio, in place
+  typedef void(*stamp_t)(uint8_t* frame, const uint8_t length);
+  // adds a trailer to a frame about to go, in a buffer of MAX_FRAME_SIZE, returning the new length
+  typedef uint8_t(*seal_t)(uint8_t* frame, const uint8_t length);
+  // shown each frame as it goes to the radio
+  typedef void(*tap_t)(const radio_id target, const uint8_t* frame, const uint8_t length);
+
+  /**
+   * @param r the radio
+   * @param cb told how each send went
+   * @param st stamps each frame as it goes, for each destination, before it's sealed
+   * @param s seals each frame as it goes, frames are built FRAME_TRAILER_SIZE short to leave it room
+   * @param t shown each frame as it goes, sealed
+   */
+  TxQueue(NRFLite& r, callback_t cb = nullptr, stamp_t st = nullptr, seal_t s = nullptr, tap_t t = nullptr) :
+    radio(r), callback(cb), stamp(st), seal(s), tap(t), room(s ? MAX_FRAME_SIZE - FRAME_TRAILER_SIZE : MAX_FRAME_SIZE)
+  {
+    init(0);
+    for (uint8_t i = 0; i < TDestinations; ++i)
+      statuses[i] = TxStatus::NONE;
+  }
+
+  /**
+   * Forgets everything queued, for when the radio has been (re)initialised
+   * @param id our radio ID, for the frame header
+   * @param interrupts true if a radio interrupt reads the results, see interrupted()
+   */
+  void init(const radio_id id, const bool interrupts = false)
+  {
+    me = id;
+    for (uint8_t i = 0; i < TCapacity; ++i)
+      entries[i].length = 0;
+    state = State::IDLE;
+    usingInterrupts = interrupts;
+    result = TxStatus::NONE;
+  }
+
+  /**
+   * Hands over the result of a send from the radio interrupt, which has already cleared it on the radio
+   * @param txOk the send was acknowledged
+   * @param txFail the radio ran out of retries
+   */
+  void interrupted(const bool txOk, const bool txFail)
+  {
+    if (txOk)
+      result = TxStatus::SENT;
+    else if (txFail)
+      result = TxStatus::FAILED;
+  }
+
+  /**
+   * Queues a packet for a single destination
+   * @param packet packet to send
+   * @param target radio ID to send it to
+   * @param delay how long the packet can wait for others to share its frame
+   * @return true if the packet was queued
+   */
+  bool send(const Packet& packet, const radio_id target, const millis_t delay = 0)
+  {
+    return multicast(packet, static_cast<node_mask_t>(1) << target, delay);
+  }
+
+  /**
+   * Queues a packet for a set of destinations
+   * @param packet packet to send
+   * @param targets mask of radio IDs to send it to
+   * @param delay how long the packet can wait for others to share its frame
+   * @return true if the packet was queued
+   */
+  bool multicast(const Packet& packet, const node_mask_t targets, const millis_t delay = 0)
+  {
+    if (targets == 0)
+      return true;
+
+    const uint8_t size = packet_size(packet.opcode);
+    if (size == 0)
+      return false;
+    const millis_t now = millis();
+
+    Entry* entry = nullptr;
+    Entry* unused = nullptr;
+    for (uint8_t i = 0; i < TCapacity; ++i)
+    {
+      Entry& e = entries[i];
+      if (e.length == 0)
+      {
+        if (unused == nullptr)
+          unused = &e;
+        continue;
+      }
+      if (e.sending || e.targets != targets)
+        continue;
+      if (e.length + size <= room)
+      {
+        entry = &e;
+        break;
+      }
+      // no room for this one, so that frame is as full as it's getting
+      e.deadline = now;
+    }
+
+    if (entry == nullptr && unused != nullptr)
+    {
+      entry = unused;
+      entry->data[0] = me;
+      entry->length = FRAME_HEADER_SIZE;
+      entry->targets = targets;
+      entry->deadline = now + delay;
+      entry->sending = false;
+      entry->urgent = false;
+    }
+
+    const TxStatus status = entry ? TxStatus::PENDING : TxStatus::DROPPED;
+    for (uint8_t i = 0; i < TDestinations; ++i)
+    {
+      if (targets & (static_cast<node_mask_t>(1) << i))
+        statuses[i] = status;
+    }
+    if (entry == nullptr)
+      return false;
+
+    entry->length += packet_encode(packet, entry->data + entry->length);
+    entry->urgent |= packet_urgent(packet.opcode);
+    if (before(now + delay, entry->deadline))
+      entry->deadline = now + delay;
+    if (entry->length + PACKET_HEADER_SIZE > room)
+      entry->deadline = now;
+    return true;
+  }
+
+  /**
+   * Advances the send state machine, call this every loop
+   * The radio can't receive while a send is in flight, so only poll it for data when this isn't busy()
+   * @param window which frames can be started now, a send already in flight always finishes
+   */
+  void update(const TxWindow window = TxWindow::OPEN)
+  {
+    const millis_t now = millis();
+
+    if (state == State::SENDING)
+    {
+      uint8_t txOk, txFail, rxReady;
+      if (usingInterrupts)
+      {
+        txOk = result == TxStatus::SENT;
+        txFail = result == TxStatus::FAILED;
+      }
+      else
+        radio.whenInterrupts(txOk, txFail, rxReady);
+
+      if (txOk)
+        statuses[target] = TxStatus::SENT;
+      else if (txFail || now - started > TIMEOUT)
+        statuses[target] = TxStatus::FAILED;
+      else
+        return;
+
+      state = State::IDLE;
+      if (callback)
+        callback(target, statuses[target]);
+    }
+
+    if (window == TxWindow::CLOSED)
+      return;
+
+    // finish off a frame that's part way through its destinations, otherwise the one that's most overdue
+    Entry* next = nullptr;
+    for (uint8_t i = 0; i < TCapacity; ++i)
+    {
+      Entry& e = entries[i];
+      if (e.length == 0)
+        continue;
+      if (window == TxWindow::URGENT && !e.urgent)
+        continue;
+      if (e.sending)
+      {
+        next = &e;
+        break;
+      }
+      if (before(now, e.deadline))
+        continue;
+      if (next == nullptr || before(e.deadline, next->deadline))
+        next = &e;
+    }
+    if (next == nullptr)
+      return;
+
+    target = 0;
+    while ((next->targets & (static_cast<node_mask_t>(1) << target)) == 0)
+      ++target;
+    next->targets &= ~(static_cast<node_mask_t>(1) << target);
+    next->sending = true;
+
+    result = TxStatus::NONE;
+    if (stamp)
+      stamp(next->data, next->length);
+    if (seal)
+    {
+      // sealed afresh for each destination, so each copy has its own counter
+      uint8_t sealed[MAX_FRAME_SIZE];
+      memcpy(sealed, next->data, next->length);
+      const uint8_t length = seal(sealed, next->length);
+      if (tap)
+        tap(target, sealed, length);
+      radio.startSend(target, sealed, length);
+    }
+    else
+    {
+      if (tap)
+        tap(target, next->data, next->length);
+      radio.startSend(target, next->data, next->length);
+    }
+    started = now;
+    state = State::SENDING;
+
+    // the radio has its own copy of the payload now
+    if (next->targets == 0)
+      next->length = 0;
+  }
+
+  inline bool busy() const { return state == State::SENDING; }
+  inline TxStatus status(const radio_id target) const { return statuses[target]; }
+
+private:
+  // give up on a send the radio never reported back on
+  static const millis_t TIMEOUT = 50;
+
+  /**
+   * Deadlines wrap with millis(), so compare them as a window
+   */
+  static inline bool before(const millis_t a, const millis_t b) { return static_cast<int32_t>(a - b) < 0; }
+
+  enum class State : uint8_t
+  {
+    IDLE,
+    SENDING
+  };
+
+  struct Entry
+  {
+    uint8_t data[MAX_FRAME_SIZE];
+    uint8_t length; // 0 for an unused entry
+    node_mask_t targets;
+    millis_t deadline;
+    bool sending; // some of the targets already have it
+    bool urgent;  // has at least one packet_urgent() packet in it
+  };
+
+  NRFLite& radio;
+  callback_t callback;
+  stamp_t stamp;
+  seal_t seal;
+  tap_t tap;
+  uint8_t room; // how much of a frame the packets can have
+  radio_id me;
+
+  Entry entries[TCapacity];
+
+  State state;
+  radio_id target;
+  millis_t started;
+  bool usingInterrupts;
+  volatile TxStatus result; // written by interrupted()
+
+  TxStatus statuses[TDestinations];
+};
+
+#endif
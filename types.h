@@ -8,7 +8,37 @@ using radio_id = uint8_t;
 using millis_t = uint32_t;
 using team_id = int8_t;
 using player_id = int8_t;
+using version_t = uint8_t;
 
 static const team_id NO_TEAM = -1;
 
+// radio IDs in the network, up to 64, every node needs the same setting. More than 8 doesn't fit in an ATmega328's
+// RAM, see README.md
+#ifndef RADIO_IDS
+#define RADIO_IDS 8
+#endif
+const uint8_t MAX_NODES = RADIO_IDS;
+
+// one bit per radio_id
+#if RADIO_IDS <= 8
+using node_mask_t = uint8_t;
+#elif RADIO_IDS <= 16
+using node_mask_t = uint16_t;
+#elif RADIO_IDS <= 32
+using node_mask_t = uint32_t;
+#elif RADIO_IDS <= 64
+using node_mask_t = uint64_t;
+#else
+#error "RADIO_IDS can be at most 64"
+#endif
+
+/**
+ * Versions wrap, so compare them as a window
+ * @return true if a is newer than b
+ */
+inline bool newer(const version_t a, const version_t b)
+{
+  return static_cast<int8_t>(a - b) > 0;
+}
+
 #endif